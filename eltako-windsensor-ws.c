@@ -10,12 +10,18 @@
 // 
 // Setup:
 // - Connect one wire of the wind sensor to "DIGITAL PWM" pin 2
-//   of an Arduino Uno.
+//   of an Arduino Uno. Or to pin 8 if you configured PULSE_INPUT to
+//   be PULSE_INPUT_TIMER1_CAPTURE, see below.
 // - Connect the other wire to GND.
+// - Optionally connect further sensors, e.g. a second wind sensor or
+//   a rain gauge, the same way to the pins configured by
+//   CHANNEL_VARIANT, see below.
 //
-// It will print the number of pulses per second and minute every
-// 60 seconds. To view that use "Tools / Serial monitor" in the
-// Arduino PC software.
+// It will print the number of pulses per second and minute, and the
+// wind speed according to the windCalibration, every 60 seconds. To
+// view that use "Tools / Serial monitor" in the Arduino PC software.
+// Pulses are counted all the time, also while the results are being
+// printed, so there is no gap between two measurements.
 //
 // Notice that the Internet says that this particular wind sensor
 // might do more than one pulse per rotation.
@@ -26,70 +32,2281 @@
 // 
 // Also the LED will provide you with nice visual feedback of whether
 // the Arduino is still measuring :)
+// If you don't need the LED, e.g. because nobody will look at it on a
+// weather mast, you can disable it with PULSE_LED, see below.
 
-// For constant UINT_MAX / ULONG_MAX
+// For constant UINT_MAX / ULONG_MAX / ULLONG_MAX
 #include <limits.h>
-// For log()
-#include <math.h>  
+// test/host-harness.cpp runs this code on a PC instead of the Arduino,
+// so it provides its own version of these.
+#ifndef HOST_HARNESS
+// For ATOMIC_BLOCK
+#include <util/atomic.h>
+// For _crc16_update() and _crc8_ccitt_update()
+#include <util/crc16.h>
+// For sleep_mode(), see LOW_POWER
+#include <avr/sleep.h>
+// For power_adc_disable() etc., see LOW_POWER
+#include <avr/power.h>
+// For PROGMEM, see windCalibration
+#include <avr/pgmspace.h>
+// For eeprom_read_block() etc., see EEPROM_LOG
+#include <avr/eeprom.h>
+// For wdt_enable() etc., see WATCHDOG
+#include <avr/wdt.h>
+#endif
 
-// Pin which will connect the wind sensor and be used as source for
-// the counter interrupt.
-// Arduino Uno supports pin 2 and 3 with interrupts.
-// See: https://www.arduino.cc/reference/en/language/functions/external-interrupts/attachinterrupt/
-const byte pin = 2;
+// Possible values of BUILD_PROFILE, which selects a combination of the
+// features below for a typical use, so they don't have to be chosen
+// one by one. The 2048 bytes of RAM and 32 KB of flash of the Arduino
+// Uno don't fit all of them at once, see ramBuffersBytes. The buffers
+// of the default build need ~ 1100 bytes.
+// A feature which is configured explicitly, e.g. with
+// -DMOVING_STATISTICS=1 or by a #define above this, overrides the
+// profile.
+//
+// No profile: Each feature is at its default as documented below. This
+// is the default.
+#define BUILD_PROFILE_NONE 0
+// Only counting, the leanest build: The binary output, and neither the
+// moving statistics nor the times of the pulses, see
+// PULSE_TIMESTAMP_BUFFER_SIZE. Its buffers need ~ 150 bytes of RAM.
+#define BUILD_PROFILE_MINIMAL 1
+// For a mast which sends to a program on a PC for years: The binary
+// output with TIME_SYNC, SERIAL_COMMANDS, EEPROM_LOG, GUST_ALERT,
+// HEALTH_REPORT and the WATCHDOG, and the moving statistics. Its
+// buffers need ~ 800 bytes of RAM.
+#define BUILD_PROFILE_TELEMETRY 2
+// For examining a wind sensor on the desk: The text output with
+// INSTRUMENTATION, PULSE_HISTOGRAM, HEALTH_REPORT and SERIAL_COMMANDS,
+// so the debounce delay can be tried out. Its buffers need ~ 1350
+// bytes of RAM, close to what is available.
+#define BUILD_PROFILE_DIAGNOSTICS 3
 
-// The pulse count will be measured for this many seconds before it
-// is printed. This defaults to the value of 60 which is uncomfortably
-// high for debugging because wind sensors can rotate very slowly so
-// we need to measure for a long time to get an accurate measurement.
-const unsigned int measurementDelaySeconds = 60;
+#ifndef BUILD_PROFILE
+#define BUILD_PROFILE BUILD_PROFILE_NONE
+#endif
 
-// Number of pulses as counted by the interrupt in the current
-// measurement cycle.
-// Must be volatile to prevent the compiler from making the code cache
-// it because it is modified off the main thread, i.e. in the
-// interrupt function countPulse().
-// Unsigned int is large enough as a datatype:
-// Its maximum value of 65535 being reached in 60 seconds would mean
-// 1000 rotations per second - which a wind sensor cannot do.
-volatile unsigned int pulseCount = 0;
+#if BUILD_PROFILE == BUILD_PROFILE_MINIMAL
+#ifndef OUTPUT_FORMAT
+#define OUTPUT_FORMAT OUTPUT_FORMAT_BINARY
+#endif
+#ifndef MOVING_STATISTICS
+#define MOVING_STATISTICS 0
+#endif
+#ifndef PULSE_TIMESTAMP_BUFFER_SIZE
+#define PULSE_TIMESTAMP_BUFFER_SIZE 0
+#endif
+#elif BUILD_PROFILE == BUILD_PROFILE_TELEMETRY
+#ifndef OUTPUT_FORMAT
+#define OUTPUT_FORMAT OUTPUT_FORMAT_BINARY
+#endif
+#ifndef TIME_SYNC
+#define TIME_SYNC 1
+#endif
+#ifndef SERIAL_COMMANDS
+#define SERIAL_COMMANDS 1
+#endif
+#ifndef EEPROM_LOG
+#define EEPROM_LOG 1
+#endif
+#ifndef GUST_ALERT
+#define GUST_ALERT 1
+#endif
+#ifndef HEALTH_REPORT
+#define HEALTH_REPORT 1
+#endif
+#ifndef WATCHDOG
+#define WATCHDOG 1
+#endif
+#elif BUILD_PROFILE == BUILD_PROFILE_DIAGNOSTICS
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION 1
+#endif
+#ifndef PULSE_HISTOGRAM
+#define PULSE_HISTOGRAM 1
+#endif
+#ifndef HEALTH_REPORT
+#define HEALTH_REPORT 1
+#endif
+#ifndef SERIAL_COMMANDS
+#define SERIAL_COMMANDS 1
+#endif
+#elif BUILD_PROFILE != BUILD_PROFILE_NONE
+#error "Unknown BUILD_PROFILE"
+#endif
+
+// Possible values of PULSE_INPUT, which selects how the pulses of the
+// wind sensor get to our code:
+//
+// The pin causes an "external interrupt" which calls countPulse().
+// That works on pin 2 and 3, and the time of a pulse is measured with
+// micros() so it has a resolution of 4 microseconds.
+// This is the default.
+#define PULSE_INPUT_EXTERNAL_INTERRUPT 1
+// The "input capture" unit of the hardware timer "Timer1" of the
+// Arduino Uno's ATmega328P chip stores the time of each pulse on its
+// own - without having to wait until our code runs - with a
+// resolution of 0.5 microseconds. This only works on pin 8 and makes
+// Timer1 unavailable for anything else, e.g. for the Servo library or
+// analogWrite() on pin 9 and 10.
+// Use this if you need to measure the time between pulses of fast
+// gusts more precisely.
+#define PULSE_INPUT_TIMER1_CAPTURE 2
+
+#ifndef PULSE_INPUT
+#define PULSE_INPUT PULSE_INPUT_EXTERNAL_INTERRUPT
+#endif
+
+// Only used with PULSE_INPUT_TIMER1_CAPTURE: If 1 then the "noise
+// canceler" of the input capture unit is enabled. It ignores changes
+// of the pin which don't stay for at least 4 CPU clock cycles, i.e.
+// 0.25 microseconds, which filters out very short electrical
+// spikes.
+// This is NOT a replacement for debouncing the switch in the wind
+// sensor, which bounces for milliseconds, see debounceMicros below.
+// It delays every pulse by those 4 cycles, which doesn't matter for us.
+#ifndef TIMER1_NOISE_CANCELER
+#define TIMER1_NOISE_CANCELER 1
+#endif
+
+#if PULSE_INPUT != PULSE_INPUT_EXTERNAL_INTERRUPT \
+	&& PULSE_INPUT != PULSE_INPUT_TIMER1_CAPTURE
+#error "Unknown PULSE_INPUT"
+#endif
+
+// Possible values of DEBOUNCE_STRATEGY, which selects how the
+// "bouncing" of the switch in the wind sensor is filtered out: When it
+// closes or opens, its contacts bounce off each other a few times
+// within a few milliseconds, which would cause multiple edges at the
+// pin for a single pulse. All of them use the debounce delay of the
+// Sensor, see debounceMicros below, and of the channels, see
+// CHANNEL_VARIANT:
+//
+// "Lockout": After a pulse was counted, all edges are ignored for the
+// debounce delay. This is the cheapest, but limits the pulses per
+// second to 1 / debounce delay.
+// Like DEBOUNCE_ADAPTIVE it only filters bounces which happen shortly
+// after the edge of a pulse. If the switch also bounces when it opens
+// again after being closed for longer than the lockout, the first of
+// those bounces is counted as another pulse: Use DEBOUNCE_STABLE then.
+// This is the default.
+#define DEBOUNCE_LOCKOUT 1
+// "Stable": A pulse is only counted if the pin stayed at the level of
+// the edge, e.g. LOW for FALLING, for at least the debounce delay. The
+// interrupt then happens on both edges, and reads the pin to find out
+// which one it was.
+// Bounces are shorter than the debounce delay, so they are ignored no
+// matter when they happen. But the pulse is only counted when the pin
+// leaves the level again, with the time at which it began. Notice that
+// a wind sensor which stops while its switch is closed thus has its
+// last pulse counted only when it starts to rotate again.
+// CHANGE is not supported as edgeMode with this.
+#define DEBOUNCE_STABLE 2
+// "Adaptive": Like DEBOUNCE_LOCKOUT, but the lockout time follows the
+// time between the pulses: It is a quarter of their average, but at
+// most the debounce delay and at least DEBOUNCE_ADAPTIVE_MIN_MICROS.
+// That allows counting much faster pulses, as bounces only happen
+// shortly after a real edge, while still using the long debounce delay
+// at low speeds.
+#define DEBOUNCE_ADAPTIVE 3
+
+#ifndef DEBOUNCE_STRATEGY
+#define DEBOUNCE_STRATEGY DEBOUNCE_LOCKOUT
+#endif
+
+#if DEBOUNCE_STRATEGY != DEBOUNCE_LOCKOUT \
+	&& DEBOUNCE_STRATEGY != DEBOUNCE_STABLE \
+	&& DEBOUNCE_STRATEGY != DEBOUNCE_ADAPTIVE
+#error "Unknown DEBOUNCE_STRATEGY"
+#endif
+
+// Only used with DEBOUNCE_ADAPTIVE: The shortest lockout time in
+// microseconds. Should be longer than the switch bounces.
+#ifndef DEBOUNCE_ADAPTIVE_MIN_MICROS
+#define DEBOUNCE_ADAPTIVE_MIN_MICROS 1000
+#endif
+
+// All times of pulses are measured in "ticks" of this many per second.
+// The length of a tick depends on the PULSE_INPUT.
+#if PULSE_INPUT == PULSE_INPUT_EXTERNAL_INTERRUPT
+// 1 tick = 1 microsecond as returned by micros(), which only counts in
+// steps of 4 though.
+const unsigned long pulseTicksPerSecond = 1000000;
+#elif PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE
+// Timer1 counts with the 16 MHz CPU clock divided by 8, see
+// setupPulseInput(), so 1 tick = 0.5 microseconds.
+const unsigned long pulseTicksPerSecond = F_CPU / 8;
+#endif
+
+// The pulse count is taken out of the interrupt this often, and each
+// such "sample" is added to the current measurement and to the moving
+// statistics, see MOVING_STATISTICS.
+// The measurementDelaySeconds must be a multiple of this.
+const unsigned long sampleIntervalMillis = 250;
+
+// Returns the number of decimal places needed to display all numbers
+// >= numerator / denominator.
+// "constexpr" means that the compiler computes this while compiling if
+// the parameters are constant, i.e. it costs no time when running.
+constexpr int numberOfDecimalsNeeded(unsigned long numerator,
+		unsigned long denominator) {
+	// If the number is >= 1 then no decimal places are needed.
+	// Otherwise each decimal place we add allows showing a number 10
+	// times smaller, so we check whether 10 times the number needs
+	// one less. If the number is not a power of 10, e.g. 0.012345,
+	// this rounds up the number of decimals - 2 in that case - which
+	// ensures the number can be shown.
+	return numerator >= denominator ? 0
+		: 1 + numberOfDecimalsNeeded(numerator * 10, denominator);
+}
+
+// Returns the time which has passed from "earlier" until "now", in the
+// unit of both, e.g. ticks or milliseconds.
+// Time counters such as millis() overflow back to 0 when they reach
+// their maximum, e.g. millis() after ~ 50 days. The subtraction of
+// unsigned numbers "wraps around" the same way, so it yields the
+// correct difference even if that happened in between, without any
+// special case - as long as the difference itself is shorter than a
+// full round of the counter. So always use this instead of comparing
+// times directly: "now > earlier" would be wrong after an overflow.
+// See: https://www.arduino.cc/reference/en/language/functions/time/millis/
+inline unsigned long timeSince(unsigned long earlier, unsigned long now) {
+	return now - earlier;
+}
+
+// Configures the given pin as input with the internal pull-up resistor
+// enabled, like pinMode(pin, INPUT_PULLUP), but by accessing the
+// registers of the pin directly. See chapter "I/O-Ports" of the
+// ATmega328P datasheet.
+// Pin 0 to 7 are "port D", pin 8 to 13 are "port B", pin 14 to 19,
+// i.e. A0 to A5, are "port C".
+// If the pin is constant the compiler removes the "if"s and the code
+// of the other ports.
+inline void setupInputPin(byte pin) {
+	if(pin < 8) {
+		DDRD &= ~_BV(pin);
+		PORTD |= _BV(pin);
+	} else if(pin < 14) {
+		DDRB &= ~_BV(pin - 8);
+		PORTB |= _BV(pin - 8);
+	} else {
+		DDRC &= ~_BV(pin - 14);
+		PORTC |= _BV(pin - 14);
+	}
+}
+
+// Returns true if the given pin is HIGH, like digitalRead(pin) ==
+// HIGH but by reading the register of its port directly, see
+// setupInputPin().
+inline bool readPin(byte pin) {
+	if(pin < 8)
+		return PIND & _BV(pin);
+	else if(pin < 14)
+		return PINB & _BV(pin - 8);
+	else
+		return PINC & _BV(pin - 14);
+}
+
+// Configures the given pin as output, like pinMode(pin, OUTPUT), see
+// setupInputPin(). The pin is LOW initially.
+inline void setupOutputPin(byte pin) {
+	if(pin < 8) {
+		PORTD &= ~_BV(pin);
+		DDRD |= _BV(pin);
+	} else if(pin < 14) {
+		PORTB &= ~_BV(pin - 8);
+		DDRB |= _BV(pin - 8);
+	} else {
+		PORTC &= ~_BV(pin - 14);
+		DDRC |= _BV(pin - 14);
+	}
+}
+
+// Sets the given output pin to HIGH or LOW, like digitalWrite(), see
+// setupInputPin().
+inline void writePin(byte pin, bool high) {
+	volatile uint8_t &port = pin < 8 ? PORTD : pin < 14 ? PORTB : PORTC;
+	byte bit = _BV(pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14);
+	if(high)
+		port |= bit;
+	else
+		port &= ~bit;
+}
+
+// Returns true if a pin whose pulses happen on the given edge is at
+// the level of the edge, i.e. LOW for FALLING and HIGH for RISING.
+// With CHANGE both levels count.
+constexpr bool isActiveLevel(byte edge, bool high) {
+	return edge == CHANGE || high == (edge == RISING);
+}
+
+// Returns the edge on which the interrupt of a pin whose pulses happen
+// on the given edge must happen: DEBOUNCE_STABLE needs both edges.
+constexpr byte interruptEdge(byte edge) {
+	return DEBOUNCE_STRATEGY == DEBOUNCE_STABLE ? CHANGE : edge;
+}
+
+// Returns the bits of the EICRA register which make the external
+// interrupt with the given number - 0 for INT0 on pin 2, 1 for INT1 on
+// pin 3 - happen on the given edge, i.e. FALLING, RISING or CHANGE.
+// See chapter "External Interrupts" of the ATmega328P datasheet.
+constexpr byte interruptSenseBits(byte interruptNumber, byte edge) {
+	return (edge == FALLING ? _BV(ISC01)
+			: edge == RISING ? _BV(ISC01) | _BV(ISC00)
+			: _BV(ISC00))
+		<< (2 * interruptNumber);
+}
+
+// Enables the external interrupt with the given number to happen on
+// the given edge, see interruptSenseBits().
+// This does the same as
+//     attachInterrupt(interruptNumber, function, edge);
+// by accessing the registers of the interrupt controller directly. The
+// function which is called is the ISR() of the interrupt.
+inline void enableExternalInterrupt(byte interruptNumber, byte edge) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		const byte senseMask
+			= (_BV(ISC01) | _BV(ISC00)) << (2 * interruptNumber);
+		EICRA = (EICRA & ~senseMask)
+			| interruptSenseBits(interruptNumber, edge);
+		// Clear an old interrupt by writing a 1 to it.
+		EIFR = _BV(INTF0 + interruptNumber);
+		EIMSK |= _BV(INT0 + interruptNumber);
+	}
+}
+
+// Number of bits of the pulse counters: 16 or 32.
+// The counters of the interrupts are taken out and reset every
+// sampleIntervalMillis, so with 16 bits they can count 65535 pulses
+// per sample, which is checked while compiling, see
+// maxPulsesPerSample(). But the pulses of a whole measurement are added
+// up in counters of the same size. With 16 bits that allows e.g. 1092
+// pulses per second in 60 seconds. So for faster sensors, e.g. flow
+// meters, or longer measurements use 32, which makes the interrupts
+// and the RAM usage of the counters a bit larger.
+// If the counter of a measurement overflows anyway, the report shows a
+// warning.
+#ifndef PULSE_COUNTER_BITS
+#define PULSE_COUNTER_BITS 16
+#endif
+
+#if PULSE_COUNTER_BITS == 16
+typedef uint16_t PulseCount;
+#elif PULSE_COUNTER_BITS == 32
+typedef uint32_t PulseCount;
+#else
+#error "PULSE_COUNTER_BITS must be 16 or 32"
+#endif
+
+// Returns the highest number of pulses which a channel with the given
+// debounce delay in microseconds can count in a sample: The debounce
+// code never accepts two pulses which are closer to each other than
+// the debounce delay - or DEBOUNCE_ADAPTIVE_MIN_MICROS if that is
+// shorter with DEBOUNCE_ADAPTIVE.
+// The counters of the interrupts thus cannot overflow if this fits
+// into a PulseCount, which is checked while compiling. That way the
+// interrupts don't need to check for it.
+constexpr unsigned long maxPulsesPerSample(unsigned long debounceMicros) {
+	return sampleIntervalMillis * 1000
+		/ (DEBOUNCE_STRATEGY == DEBOUNCE_ADAPTIVE
+			&& DEBOUNCE_ADAPTIVE_MIN_MICROS < debounceMicros
+			? DEBOUNCE_ADAPTIVE_MIN_MICROS : debounceMicros)
+		+ 1;
+}
+
+// The values of the SensorConfiguration below which depend on the
+// debounce delay, as functions so they can also be computed when
+// running for a debounce delay which was set by a command, see
+// SERIAL_COMMANDS. They are documented in the SensorConfiguration.
+constexpr unsigned long minimalPulseMicrosFor(unsigned long debounceMicros) {
+	return DEBOUNCE_STRATEGY == DEBOUNCE_STABLE ? 2 * debounceMicros
+		: DEBOUNCE_STRATEGY == DEBOUNCE_ADAPTIVE
+			&& DEBOUNCE_ADAPTIVE_MIN_MICROS < debounceMicros
+		? DEBOUNCE_ADAPTIVE_MIN_MICROS : debounceMicros;
+}
+
+constexpr unsigned long maxMilliPulsesPerSecondFor(
+		unsigned long debounceMicros) {
+	return 1000UL * 1000 * 1000 / minimalPulseMicrosFor(debounceMicros) / 2;
+}
+
+constexpr int displayedDecimalsFor(unsigned long debounceMicros) {
+	return numberOfDecimalsNeeded(1000,
+			maxMilliPulsesPerSecondFor(debounceMicros)) < 3
+		? numberOfDecimalsNeeded(1000,
+			maxMilliPulsesPerSecondFor(debounceMicros)) : 3;
+}
 
+// The configuration of the wind sensor.
+// It is a "template": Instead of storing the values in variables, the
+// compiler inserts them directly into the code, and computes all values
+// which are derived from them while compiling. So they cost neither
+// RAM nor time when running, and it is checked while compiling whether
+// they are valid.
+// Don't use this directly: Use "Sensor", which is one of the
+// SENSOR_VARIANT configurations below, and write e.g.
+// Sensor::debounceDelayMicros to get a value.
+//
+// The parameters are:
+//
+// pinNumber:
+// Pin which will connect the wind sensor and be used as source for
+// the counter interrupt.
+// With PULSE_INPUT_EXTERNAL_INTERRUPT the Arduino Uno supports pin 2
+// and 3.
+// See: https://www.arduino.cc/reference/en/language/functions/external-interrupts/attachinterrupt/
+// With PULSE_INPUT_TIMER1_CAPTURE it must be pin 8 because the input
+// capture unit is hardwired to it. The datasheet of the ATmega328P
+// calls it "ICP1".
+//
+// edgeMode:
+// FALLING, RISING or CHANGE, as for attachInterrupt(): Which change of
+// the voltage of the pin is counted as a pulse. Usually FALLING, see
+// setupPulseInput().
+// CHANGE is not supported by PULSE_INPUT_TIMER1_CAPTURE.
+//
+// debounceMicros:
 // Don't count pulses if the last pulse happened up to this amount of
-// milliseconds ago. In other words this is the minimal length of a
+// microseconds ago. In other words this is the minimal length of a
 // pulse which we can measure (that way of describing it is important
 // when trying to understand the documentation of the below
-// maxImpulsesPerSecond).
-// This is for debouncing the switch in the wind sensor.
+// maxMilliPulsesPerSecond).
+// This is for debouncing the switch in the wind sensor. How exactly it
+// is used depends on the DEBOUNCE_STRATEGY.
 // NOTICE: This is the most important value to configure as I did NOT
 // have an actual wind sensor at hand when I wrote this code and thus
 // was not able to check whether the debounce delay is high enough for
 // the particular switch in the wind sensor.
-// The default of 10 should at least not be too high: 10ms means that
-// we could register up to 100 impulses per second. If the wind sensor
-// does 2 impulses per rotation that is 50 rotations per second, which
-// seems awfully high for a wind sensor.
-const unsigned int debounceDelayMillis = 10;
-
-// Time in milliseconds at which the last pulse was accepted by the
-// debounce code. No further impulses will be counted until the
-// debounceDelayMillis has passed.
-unsigned long lastPulse = 0;
-
-// If the pulse count goes above this value the debounceDelayMillis
-// is too high compared to the rotation speed and an error will be
-// printed by loop().
-// Arbitrarily chosen to be 50 % of the maximum countable pulses as
-// determined by the debounce delay.
-const float maxImpulsesPerSecond
-	= ((float)1000 / debounceDelayMillis) * 0.5f;
-
-byte ledState = LOW;
+// The default of 10000, i.e. 10 ms, should at least not be too high:
+// 10 ms means that we could register up to 100 impulses per second -
+// with DEBOUNCE_LOCKOUT, the others allow more. If the wind sensor does
+// 2 impulses per rotation that is 50 rotations per second, which seems
+// awfully high for a wind sensor.
+//
+// measurementSeconds:
+// The pulse count will be measured for this many seconds before it
+// is printed. This defaults to the value of 60 which is uncomfortably
+// high for debugging because wind sensors can rotate very slowly so
+// we need to measure for a long time to get an accurate measurement.
+// Must be a multiple of sampleIntervalMillis.
+//
+// pulsesPerRotation:
+// Number of pulses which the wind sensor does per rotation. The pulses
+// per second are divided by it to look up the wind speed in the
+// windCalibration, see windMillimetersPerSecond().
+template<byte pinNumber, byte edgeMode, unsigned long debounceMicros,
+	unsigned int measurementSeconds, byte pulsesPerRotation>
+struct SensorConfiguration {
+	static constexpr byte pin = pinNumber;
+	static constexpr byte edge = edgeMode;
+	static constexpr unsigned long debounceDelayMicros = debounceMicros;
+	static constexpr unsigned int measurementDelaySeconds
+		= measurementSeconds;
+	static constexpr byte pulsesPerRotationCount = pulsesPerRotation;
+	
+#if PULSE_INPUT == PULSE_INPUT_EXTERNAL_INTERRUPT
+	static_assert(pin == 2 || pin == 3,
+		"PULSE_INPUT_EXTERNAL_INTERRUPT only works on pin 2 and 3");
+#elif PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE
+	static_assert(pin == 8,
+		"PULSE_INPUT_TIMER1_CAPTURE only works on pin 8");
+	static_assert(edge == FALLING || edge == RISING,
+		"PULSE_INPUT_TIMER1_CAPTURE only supports FALLING and RISING");
+#endif
+	static_assert(edge == FALLING || edge == RISING || edge == CHANGE,
+		"edgeMode must be FALLING, RISING or CHANGE");
+	static_assert(DEBOUNCE_STRATEGY != DEBOUNCE_STABLE || edge != CHANGE,
+		"DEBOUNCE_STABLE does not support CHANGE");
+	static_assert(debounceDelayMicros > 0, "debounceMicros must not be 0");
+	static_assert(pulsesPerRotationCount > 0,
+		"pulsesPerRotation must not be 0");
+	static_assert(maxPulsesPerSample(debounceDelayMicros)
+			<= (PulseCount)~0UL,
+		"debounceMicros is too short for PULSE_COUNTER_BITS 16, use 32");
+	static_assert((unsigned long)measurementDelaySeconds * 1000
+			% sampleIntervalMillis == 0,
+		"measurementSeconds must be a multiple of sampleIntervalMillis");
+	// The tick count overflows back to 0 after 2^32 ticks, so the time
+	// between two pulses can only be measured if it is shorter. That
+	// is ~ 71 minutes with PULSE_INPUT_EXTERNAL_INTERRUPT, ~ 36 minutes
+	// with PULSE_INPUT_TIMER1_CAPTURE.
+	static_assert((unsigned long long)measurementDelaySeconds
+			* pulseTicksPerSecond <= ULONG_MAX,
+		"measurementSeconds is too long for the tick count");
+	
+	// Number of the external interrupt of the pin: Pin 2 is INT0, pin
+	// 3 is INT1.
+	static constexpr byte interruptNumber = pin - 2;
+	
+	// debounceDelayMicros converted to ticks, see pulseTicksPerSecond.
+	static constexpr unsigned long debounceDelayTicks
+		= debounceDelayMicros * (pulseTicksPerSecond / 1000000);
+	
+	// The shortest time between two pulses which the DEBOUNCE_STRATEGY
+	// allows, in microseconds. With DEBOUNCE_STABLE the pin must stay
+	// at both levels for the debounce delay if the switch is closed for
+	// half of the time.
+	static constexpr unsigned long minimalPulseMicros
+		= minimalPulseMicrosFor(debounceDelayMicros);
+	
+	// Number of samples per measurement.
+	static constexpr unsigned int samplesPerMeasurement
+		= (unsigned long)measurementDelaySeconds * 1000
+			/ sampleIntervalMillis;
+	
+	// If the pulse count goes above this value the debounceDelayMicros
+	// is too high compared to the rotation speed and an error will be
+	// printed by printReport().
+	// Arbitrarily chosen to be 50 % of the maximum countable pulses as
+	// determined by the debounce delay.
+	// The Arduino Uno has no hardware for computing with numbers with
+	// decimals ("floating point numbers") so the code for that would
+	// make the program larger and slower. We thus compute all rates in
+	// "milli pulses", i.e. a value of 1234 means 1.234 pulses.
+	static constexpr unsigned long maxMilliPulsesPerSecond
+		= maxMilliPulsesPerSecondFor(debounceDelayMicros);
+	
+	// Print the pulses per second with the number of decimals chosen
+	// as needed to represent the maximal impulse frequency we can
+	// reliably measure as determined by the debounce delay, i.e.
+	// 1 / maxMilliPulsesPerSecond.
+	// In other words: Don't show more decimals than we're capable of
+	// measuring accurately.
+	// We cannot show more than 3 decimals because we compute with milli
+	// pulses.
+	static constexpr int displayedDecimals
+		= displayedDecimalsFor(debounceDelayMicros);
+	
+	// Configures the pin as input with the internal pull-up resistor
+	// enabled, see setupInputPin().
+	static void setupPin() {
+		setupInputPin(pin);
+	}
+};
+
+// Possible values of SENSOR_VARIANT, which selects one of the
+// following SensorConfigurations. Add your own if these don't fit.
+//
+// Pin for the variants below: Depends on the PULSE_INPUT.
+const byte defaultPin
+	= PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE ? 8 : 2;
+// Debounce delay for the variants below: Depends on the
+// DEBOUNCE_STRATEGY. With DEBOUNCE_STABLE it must be shorter than the
+// pulses, so it is only the longest time which the switch may bounce.
+const unsigned long defaultDebounceMicros
+	= DEBOUNCE_STRATEGY == DEBOUNCE_STABLE ? 2000 : 10000;
+//
+// Eltako Windsensor WS, measuring for 60 seconds.
+// This is the default.
+#define SENSOR_ELTAKO_WS 1
+// Eltako Windsensor WS, measuring for 2 seconds.
+// Use this if you need frequent measurements, e.g. for controlling
+// something depending on the wind. Thanks to reciprocal frequency
+// measurement, see reciprocalModeMaxPulses, they are still accurate
+// at low speeds.
+#define SENSOR_ELTAKO_WS_FAST 2
+
+#ifndef SENSOR_VARIANT
+#define SENSOR_VARIANT SENSOR_ELTAKO_WS
+#endif
+
+#if SENSOR_VARIANT == SENSOR_ELTAKO_WS
+typedef SensorConfiguration<defaultPin, FALLING, defaultDebounceMicros, 60,
+	1> Sensor;
+#elif SENSOR_VARIANT == SENSOR_ELTAKO_WS_FAST
+typedef SensorConfiguration<defaultPin, FALLING, defaultDebounceMicros, 2,
+	1> Sensor;
+#else
+#error "Unknown SENSOR_VARIANT"
+#endif
+
+// A point of the calibration of the wind sensor: At this speed of
+// rotation the wind has this speed. Millimeters per second are the same
+// as milli meters per second, just like the milli pulses.
+// unsigned int so the table only needs half the space, which limits
+// both to 65.535. Wind speeds above the last point are extrapolated,
+// see windMillimetersPerSecond().
+struct WindCalibrationPoint {
+	unsigned int milliRotationsPerSecond;
+	unsigned int millimetersPerSecond;
+};
+
+// The calibration of the wind sensor of the SENSOR_VARIANT: Its
+// rotations per second measured at the wind speeds of the table, e.g.
+// in a wind tunnel. Between the points the wind speed is interpolated
+// linearly, see windMillimetersPerSecond(). That is needed because
+// wind sensors aren't linear: At low speeds friction slows them down,
+// and they don't rotate at all below some wind speed.
+// The table must start with 0 rotations per second, both columns must
+// be increasing, which is checked while compiling.
+// PROGMEM tells the compiler to keep the table in the flash memory
+// instead of copying it into the scarce RAM at startup. It has to be
+// read with pgm_read_word() then.
+// Add the table of your own SENSOR_VARIANT here.
+#if SENSOR_VARIANT == SENSOR_ELTAKO_WS \
+	|| SENSOR_VARIANT == SENSOR_ELTAKO_WS_FAST
+// The Internet says the Eltako Windsensor WS follows
+//     v = 1.761 / (1 + f) + 3.013 * f
+// with v in m/s and f being its pulses per second. Not measured by me,
+// so check it against another wind meter if you need exact values.
+// The formula is in pulses per second, which is why the Sensor is
+// configured with 1 pulse per rotation. Linear interpolation between
+// these points differs from it by less than 0.03 m/s above 0.1 pulses
+// per second. Below that it goes down to 0 m/s when the sensor stands
+// still, for which the formula would say 1.761 m/s.
+constexpr WindCalibrationPoint windCalibration[] PROGMEM = {
+	{ 0, 0 },
+	{ 100, 1902 },
+	{ 250, 2162 },
+	{ 500, 2680 },
+	{ 1000, 3894 },
+	{ 1500, 5224 },
+	{ 2000, 6613 },
+	{ 3000, 9479 },
+	{ 5000, 15358 },
+	{ 8000, 24300 },
+	{ 12000, 36291 },
+	{ 16000, 48312 },
+};
+#else
+#error "Add the windCalibration of your SENSOR_VARIANT"
+#endif
+
+const byte windCalibrationPoints
+	= sizeof(windCalibration) / sizeof(windCalibration[0]);
+
+// Whether the windCalibration is increasing from the given point on.
+constexpr bool windCalibrationIncreasing(byte point) {
+	return point >= windCalibrationPoints
+		|| (windCalibration[point].milliRotationsPerSecond
+				> windCalibration[point - 1].milliRotationsPerSecond
+			&& windCalibration[point].millimetersPerSecond
+				>= windCalibration[point - 1].millimetersPerSecond
+			&& windCalibrationIncreasing(point + 1));
+}
+
+static_assert(windCalibrationPoints >= 2,
+	"windCalibration needs at least 2 points");
+static_assert(windCalibration[0].milliRotationsPerSecond == 0,
+	"windCalibration must start with 0 rotations per second");
+static_assert(windCalibrationIncreasing(1),
+	"windCalibration must be increasing");
+
+// Additionally to the Sensor, further pulse inputs - "channels" - can
+// be counted at the same time, e.g. a second wind sensor or the
+// tipping bucket of a rain gauge on the same mast. Each has its own
+// pin, edge and debounce delay as in the SensorConfiguration and its
+// own counter. They are printed with each measurement, as pulses and
+// pulses per second by counting.
+// The moving statistics, reciprocal frequency measurement and the
+// analysis of the times of the pulses are only done for the Sensor.
+//
+// A channel on pin 2 or 3 uses the external interrupt of the pin,
+// which Sensor doesn't use, just like PULSE_INPUT_EXTERNAL_INTERRUPT.
+// All other pins use "pin change interrupts", which work on every pin
+// but are slower: The interrupt happens for any change of any pin of a
+// port and has to find out which pin has changed by reading them. A
+// change which ends before that is not seen, so use them for slow
+// sensors such as rain gauges.
+// Pin 0 and 1 are used by Serial, pin 13 by the LED. A0 to A5 are pin
+// 14 to 19.
+//
+// Possible values of CHANNEL_VARIANT, which selects one of the
+// following lists of channels. Add your own if these don't fit.
+//
+// Only the Sensor. This is the default.
+#define CHANNELS_SENSOR_ONLY 1
+// The Sensor, a second Eltako Windsensor WS on pin 3 and a rain gauge
+// on pin 4.
+#define CHANNELS_MAST 2
+
+#ifndef CHANNEL_VARIANT
+#define CHANNEL_VARIANT CHANNELS_SENSOR_ONLY
+#endif
+
+// See the parameters of SensorConfiguration.
+struct ChannelConfiguration {
+	byte pin;
+	byte edge;
+	unsigned long debounceMicros;
+};
+
+// The channels. The first one must be the Sensor.
+constexpr ChannelConfiguration channelConfigurations[] = {
+	{ Sensor::pin, Sensor::edge, Sensor::debounceDelayMicros },
+#if CHANNEL_VARIANT == CHANNELS_SENSOR_ONLY
+#elif CHANNEL_VARIANT == CHANNELS_MAST
+	{ 3, FALLING, defaultDebounceMicros },
+	// The reed contact of a tipping bucket bounces for much longer than
+	// the one of a wind sensor. And as it tips at most a few times per
+	// second even in heavy rain we can well afford a long debounce
+	// delay.
+	{ 4, FALLING, 100000 },
+#else
+#error "Unknown CHANNEL_VARIANT"
+#endif
+};
+
+const byte channelCount
+	= sizeof(channelConfigurations) / sizeof(channelConfigurations[0]);
+
+// True if channels besides the Sensor are configured. Used for
+// leaving out the code for them if not.
+#define ADDITIONAL_CHANNELS (CHANNEL_VARIANT != CHANNELS_SENSOR_ONLY)
+
+// Returns the number of the channel which uses the given pin, or
+// channelCount if there is none.
+constexpr byte channelOfPin(byte pin, byte channel = 0) {
+	return channel >= channelCount ? channelCount
+		: channelConfigurations[channel].pin == pin ? channel
+		: channelOfPin(pin, channel + 1);
+}
+
+// Returns true if the channels starting at the given one are valid.
+constexpr bool channelsValid(byte channel = 1) {
+	return channel >= channelCount
+		|| (channelConfigurations[channel].pin >= 2
+			&& channelConfigurations[channel].pin <= 19
+			&& channelConfigurations[channel].pin != 13
+			&& channelOfPin(channelConfigurations[channel].pin) == channel
+			&& (channelConfigurations[channel].edge == FALLING
+				|| channelConfigurations[channel].edge == RISING
+				|| channelConfigurations[channel].edge == CHANGE)
+			&& (DEBOUNCE_STRATEGY != DEBOUNCE_STABLE
+				|| channelConfigurations[channel].edge != CHANGE)
+			&& channelConfigurations[channel].debounceMicros > 0
+			&& maxPulsesPerSample(channelConfigurations[channel].debounceMicros)
+				<= (PulseCount)~0UL
+			&& channelsValid(channel + 1));
+}
+
+static_assert(channelConfigurations[0].pin == Sensor::pin,
+	"The first channel must be the Sensor");
+static_assert(channelsValid(),
+	"Invalid channel: Pins must be 2 to 19 except 13 and must not be used "
+	"twice, the edge must be FALLING, RISING or CHANGE - not CHANGE with "
+	"DEBOUNCE_STABLE - and the debounce delay must not be 0 or too short "
+	"for PULSE_COUNTER_BITS");
+
+// debounceMicros of the given channel converted to ticks, see
+// pulseTicksPerSecond.
+constexpr unsigned long channelDebounceTicks(byte channel) {
+	return channelConfigurations[channel].debounceMicros
+		* (pulseTicksPerSecond / 1000000);
+}
+
+// The counter of a channel.
+struct PulseCounter {
+	// Number of pulses as counted by the interrupt since the last
+	// PulseSnapshot, see PULSE_COUNTER_BITS.
+	PulseCount count;
+	// Time in ticks at which the last pulse was accepted by the
+	// debounce code. No further impulses will be counted until the
+	// debounce delay has passed.
+	unsigned long lastPulse;
+#if DEBOUNCE_STRATEGY == DEBOUNCE_STABLE
+	// Time in ticks at which the pin went to the level of the edge.
+	unsigned long activeSince;
+	// True if the pin is at the level of the edge, e.g. LOW for
+	// FALLING, as seen by the interrupt.
+	bool active;
+#elif DEBOUNCE_STRATEGY == DEBOUNCE_ADAPTIVE
+	// Average time between the pulses in ticks. Set by setup() to the
+	// highest value it can have.
+	unsigned long averagePeriod;
+#endif
+};
+
+// The counters of all channels, in the order of channelConfigurations,
+// i.e. pulseCounters[0] is the one of the Sensor.
+// Must be volatile to prevent the compiler from making the code cache
+// them because they are modified off the main thread, i.e. in the
+// interrupt functions countPulse() and countChannelPulse().
+// The lastPulse of the Sensor is also read by takePulseSnapshot() for
+// measuring the time between pulses.
+volatile PulseCounter pulseCounters[channelCount];
+
+// Counting the pulses during the measurement and dividing by its
+// length is inaccurate at low wind speeds: If there are e.g. only 5
+// pulses in a measurement then one pulse more or less makes a
+// difference of 20 %.
+// Thus if there were at most this many pulses in a measurement we
+// instead measure the time between the pulses, which is very precise
+// due to the small length of a tick, and compute the pulses per second
+// as 1 / time between pulses. This is called "reciprocal frequency
+// measurement".
+// Above this number of pulses counting is accurate enough: With 100
+// pulses the difference of one pulse is 1 %.
+// This allows for using a much lower measurementDelaySeconds, e.g. 1 to
+// 3 seconds, without losing accuracy.
+// Set to 0 to always count.
+const unsigned int reciprocalModeMaxPulses = 100;
+
+// If no pulse happened for this many seconds the wind sensor is
+// considered as standing still: The time since that pulse is not used
+// for reciprocal frequency measurement anymore.
+const unsigned long reciprocalModeMaxPeriodSeconds = 30;
+
+// If not 0 then a report is sent every this many seconds instead of at
+// the end of each measurement, and the measurements overlap: Each
+// report is of the last measurementDelaySeconds, a "sliding window",
+// which must be a multiple of this. For example with 1 second and the
+// default 60 seconds there is a report every second with the average
+// over the last minute, so a dashboard is updated often while the
+// value stays as smooth as before.
+// Additionally each report tells the pulses per second during the last
+// interval alone, the "current" speed.
+// The window is made of the results of the last intervals, of which
+// the oldest one is replaced by the newest one at every report. So a
+// report takes the same time, no matter how many intervals the window
+// has. During the first measurementDelaySeconds after startup the
+// window is shorter, as with MOVING_STATISTICS.
+// The RAM needed is 6 bytes plus 2 per channel, see CHANNEL_VARIANT,
+// and 2 more per channel with PULSE_COUNTER_BITS 32, for each interval
+// in the window, e.g. 480 bytes with 1 second, 60 seconds and the
+// Sensor only. Together with MOVING_STATISTICS and the text output,
+// which needs 64 more for the larger OUTPUT_QUEUE_SIZE, that is too
+// much and the program doesn't compile, see ramBuffersBytes. 3 seconds
+// need a third of it, which fits.
+// Must be at most 60 seconds.
+#ifndef REPORT_INTERVAL_SECONDS
+#define REPORT_INTERVAL_SECONDS 0
+#endif
+
+#if REPORT_INTERVAL_SECONDS
+static_assert(REPORT_INTERVAL_SECONDS <= 60
+		&& Sensor::measurementDelaySeconds % REPORT_INTERVAL_SECONDS == 0,
+	"REPORT_INTERVAL_SECONDS must be at most 60, and measurementSeconds a "
+	"multiple of it");
+// Number of samples per interval.
+const unsigned int reportIntervalSamples
+	= REPORT_INTERVAL_SECONDS * 1000UL / sampleIntervalMillis;
+// Number of intervals in the window of the measurementDelaySeconds of
+// the Sensor. SERIAL_COMMANDS can make the window shorter, but not
+// longer, see measurementSecondsValid().
+const byte reportIntervalsMax
+	= Sensor::measurementDelaySeconds / REPORT_INTERVAL_SECONDS;
+static_assert(Sensor::measurementDelaySeconds / REPORT_INTERVAL_SECONDS
+		<= 255,
+	"measurementSeconds must be at most 255 REPORT_INTERVAL_SECONDS");
+#endif
+
+// Possible values of OUTPUT_FORMAT, which selects how the results are
+// sent to the PC:
+//
+// Human readable text as shown by "Tools / Serial monitor". This is the
+// default.
+#define OUTPUT_FORMAT_TEXT 1
+// Compact binary "frames" for being processed by a program on the PC.
+// Each measurement is sent as a frame of 65 bytes instead of ~ 300
+// bytes of text, which takes less time to send, and it is much easier
+// for a program to read. See sendFrame() and BinaryReport for the
+// format.
+#define OUTPUT_FORMAT_BINARY 2
+// Modbus RTU, for a PLC or a gateway which polls the results over
+// RS-485, see readModbusInputValues() for the registers. Needs an
+// RS-485 transceiver, e.g. a MAX485, on pin 0 and 1 and MODBUS_DE_PIN.
+// The USB chip of the Arduino Uno is connected to these pins as well,
+// so unplug USB while the transceiver is connected.
+// Modbus uses the serial port of the Arduino directly, with its own
+// interrupts, not Serial. So nothing but the answers to the Modbus
+// requests is sent: EEPROM_LOG, PULSE_HISTOGRAM, PULSE_TRACE and
+// TIME_SYNC don't work with it, and SERIAL_COMMANDS makes the settings
+// writable by Modbus instead of by lines of text.
+#define OUTPUT_FORMAT_MODBUS 3
+
+#ifndef OUTPUT_FORMAT
+#define OUTPUT_FORMAT OUTPUT_FORMAT_TEXT
+#endif
+
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_TEXT \
+	&& OUTPUT_FORMAT != OUTPUT_FORMAT_BINARY \
+	&& OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+#error "Unknown OUTPUT_FORMAT"
+#endif
+
+// Speed of the serial connection to the PC in bits per second. Must
+// be equal to the speed configured on the PC, e.g. in the "Serial
+// monitor".
+// 9600 bits/s means that each byte takes ~ 1 millisecond, so as the
+// text output is long it defaults to that only for compatibility with
+// the default of the Serial monitor. The binary output defaults to
+// 115200 bits/s. Modbus defaults to 19200 bits/s, the usual speed of
+// Modbus devices, and must be 2400 to 115200 bits/s.
+#ifndef SERIAL_BAUD
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+#define SERIAL_BAUD 115200
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+#define SERIAL_BAUD 19200
+#else
+#define SERIAL_BAUD 9600
+#endif
+#endif
+
+// Only used with OUTPUT_FORMAT_MODBUS: The address of the Arduino on the
+// bus, 1 to 247. Each device on the bus needs its own one.
+#ifndef MODBUS_ADDRESS
+#define MODBUS_ADDRESS 1
+#endif
+
+// Only used with OUTPUT_FORMAT_MODBUS: This pin is HIGH while the
+// Arduino sends, and LOW otherwise, for switching the RS-485 transceiver
+// between sending and receiving. Connect it to both the DE and the /RE
+// pin of a MAX485. 0 for a transceiver which switches by itself.
+// The same pins as for GUST_ALERT_PIN can't be used, nor that one.
+#ifndef MODBUS_DE_PIN
+#define MODBUS_DE_PIN 6
+#endif
+
+// If not 0 then the Arduino is also an I2C slave with this address, 8
+// to 119, from which an I2C master reads the last finished
+// measurement, see I2cSnapshot. That is for sites with several masts:
+// One Arduino per mast counts the pulses, and a single master, e.g.
+// another Arduino or a Raspberry Pi, reads all of them one after the
+// other in a few milliseconds over the same two wires, instead of
+// listening to a serial connection to each of them. Each Arduino on the
+// bus needs its own address.
+// Connect SDA to pin A4 and SCL to pin A5, which can't be used for
+// anything else then, and GND. The bus needs pull-up resistors, e.g.
+// 4.7 kOhm to the supply of the master. The Arduino doesn't switch on
+// its own ones, which would pull the bus to 5 V, too much for a
+// Raspberry Pi.
+// The output on Serial stays as it is. Needs ~ 120 bytes of RAM.
+#ifndef I2C_ADDRESS
+#define I2C_ADDRESS 0
+#endif
+
+// If 1 then the PC can tell the Arduino the time by sending the line
+//     time 1760000000.123
+// i.e. the "Unix time": Seconds since 1970 in UTC, with up to 3
+// decimals, as printed by "date +%s.%3N" on Linux. It should be the
+// time at which the PC starts sending the line, the time which sending
+// takes is added, see synchronizeTime().
+// Each report then contains the time of the start and of the end of
+// the measurement, and the measurements end at whole multiples of
+// sensorMeasurementSeconds of that time, e.g. at each full minute
+// with 60 seconds, or the reports at those of REPORT_INTERVAL_SECONDS,
+// see alignSample(). So they match the measurements of other devices,
+// such as a weather station.
+// The clock of the Arduino Uno comes from a ceramic resonator, which
+// can be off by ~ 0.1 percent, i.e. more than a minute per day, and
+// changes with the temperature. So the PC should send the time
+// regularly, e.g. every hour: From two times which are at least
+// timeSyncDriftMinMillis apart the Arduino computes by how much its
+// clock is off, the clockCorrectionPpb, and corrects the times by it
+// until the next one. The pulses per second are still measured by the
+// clock of the Arduino, being off by 0.1 percent doesn't matter for
+// them.
+// The answer to "time" is how far off the Arduino's time was, and the
+// clockCorrectionPpb. With OUTPUT_FORMAT_BINARY the answer is a frame
+// of frameTypeTimeSync, and the times of each report are in a frame
+// of frameTypeTime.
+// The time is lost when the Arduino restarts, so the reports are
+// without times until the PC sends the next "time".
+// Needs ~ 60 bytes of RAM, plus 64 for the larger OUTPUT_QUEUE_SIZE
+// of the text output.
+#ifndef TIME_SYNC
+#define TIME_SYNC 0
+#endif
+
+// If 1 then gusts are detected as they happen, instead of only showing
+// in the next report: When the wind speed over the last
+// gustAlertWindowMillis has been at least gustAlertOnMillimetersPerSecond
+// for gustAlertOnMillis, a short "gust alert" is sent at once, ahead of
+// the report of the measurement. When it has been below
+// gustAlertOffMillimetersPerSecond for gustAlertOffMillis, an alert
+// that the gust is over follows. The lower threshold for the end, the
+// "hysteresis", keeps a wind speed around the threshold from causing
+// one alert after the other.
+// The wind speed is checked at every sample, i.e. every 250
+// milliseconds. It is computed from the time between the pulses, as in
+// the reports measured by "Time between pulses", so it is precise even
+// with only a few pulses in the window.
+// So the alert is put into the output queue at most 250 milliseconds
+// after the wind speed reached the threshold. What is in the queue
+// before it has to be sent first though, which takes up to ~ 11
+// milliseconds with OUTPUT_FORMAT_BINARY at 115200 baud, but up to half
+// a second for a text report at 9600 baud. For switching something
+// quickly, e.g. for retracting an awning, use GUST_ALERT_PIN.
+// Needs ~ 40 bytes of RAM, plus 64 for the larger OUTPUT_QUEUE_SIZE
+// of the text output.
+#ifndef GUST_ALERT
+#define GUST_ALERT 0
+#endif
+
+// Only used with GUST_ALERT: If not 0 then this pin is HIGH while there
+// is a gust alert, and LOW otherwise, e.g. for a relay. It is set
+// directly when the alert starts or ends, so it doesn't wait for
+// Serial. Pin 0 and 1 are used by Serial, pin 13 by the LED, pin 7 by
+// INSTRUMENTATION_SCOPE_PIN, and the pins of the channels can't be
+// used either.
+#ifndef GUST_ALERT_PIN
+#define GUST_ALERT_PIN 0
+#endif
+
+// All output is collected in an "output queue" of this many bytes from
+// which sendOutput() sends only as much to the PC as fits into the
+// buffer of Serial. That way printing never waits for the slow serial
+// connection, which would delay everything else.
+// If a report doesn't fit into the queue anymore, e.g. because the PC
+// has stopped reading and is blocking Serial, the report is dropped
+// instead, and the number of dropped reports is shown by the next
+// one which fits.
+// Must be large enough for a whole report: A text report needs ~ 470
+// bytes, ~ 100 more with INSTRUMENTATION, ~ 45 more with TIME_SYNC,
+// ~ 70 more with REPORT_INTERVAL_SECONDS and ~ 25 more with LOW_POWER,
+// and with GUST_ALERT there may be an alert of ~ 45 bytes before it.
+// A binary report needs 65 bytes, plus a frame of 28 with TIME_SYNC,
+// one of 12 with LOW_POWER and one of 56 with INSTRUMENTATION, and the
+// frame of a gust alert has 15.
+// Channels besides the Sensor, see CHANNEL_VARIANT, add ~ 75 bytes of
+// text each, or a binary frame of 8 bytes plus 8 per channel.
+// The defaults have room for all of these.
+#ifndef OUTPUT_QUEUE_SIZE
+// INSTRUMENTATION is only defined below, but #if takes it as the default
+// 0 until then.
+#if INSTRUMENTATION
+#define OUTPUT_QUEUE_INSTRUMENTATION_BYTES 128
+#else
+#define OUTPUT_QUEUE_INSTRUMENTATION_BYTES 0
+#endif
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+// 64 more for INSTRUMENTATION and 32 more for each channel besides the
+// Sensor.
+#define OUTPUT_QUEUE_SIZE (128 + OUTPUT_QUEUE_INSTRUMENTATION_BYTES / 2 \
+	+ 32 * (channelCount - 1))
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+// Nothing is put into it then.
+#define OUTPUT_QUEUE_SIZE 1
+#else
+// 64 more for each of these, 128 more for INSTRUMENTATION and 80 more
+// for each channel besides the Sensor.
+#define OUTPUT_QUEUE_SIZE (512 + 64 * ((TIME_SYNC != 0) + (GUST_ALERT != 0) \
+		+ (REPORT_INTERVAL_SECONDS != 0)) \
+	+ OUTPUT_QUEUE_INSTRUMENTATION_BYTES + 80 * (channelCount - 1))
+#endif
+#endif
+
+// The output queue, see OUTPUT_QUEUE_SIZE. Can be used like Serial,
+// e.g. with output.print(), because it is a "Print" as well.
+// Everything which is printed between beginReport() and endReport()
+// is either sent completely or not at all.
+class OutputQueue : public Print {
+public:
+	// Called for each byte by output.print() etc.
+	virtual size_t write(byte value) {
+		if(length == OUTPUT_QUEUE_SIZE) {
+			overflowed = true;
+			return 0;
+		}
+		
+		unsigned int end = start + length;
+		if(end >= OUTPUT_QUEUE_SIZE)
+			end -= OUTPUT_QUEUE_SIZE;
+		bytes[end] = value;
+		++length;
+		return 1;
+	}
+	
+	// Make the other write() functions of Print available as well.
+	using Print::write;
+	
+	// Returns how many bytes can be written until the queue is full.
+	unsigned int freeSpace() const {
+		return OUTPUT_QUEUE_SIZE - length;
+	}
+	
+	void beginReport() {
+		reportStartLength = length;
+		overflowed = false;
+	}
+	
+	// Returns false if the report did not fit into the queue. It has
+	// then been removed from it.
+	bool endReport() {
+		if(!overflowed)
+			return true;
+		
+		length = reportStartLength;
+		overflowed = false;
+		++droppedReports;
+		return false;
+	}
+	
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	// Sends as many bytes as Serial can accept without waiting.
+	void send() {
+		unsigned int count = Serial.availableForWrite();
+		if(count > length)
+			count = length;
+		// The bytes at the end and the beginning of the queue have to
+		// be sent separately.
+		if(count > OUTPUT_QUEUE_SIZE - start)
+			count = OUTPUT_QUEUE_SIZE - start;
+		if(count == 0)
+			return;
+		
+		Serial.write(bytes + start, count);
+		start += count;
+		if(start == OUTPUT_QUEUE_SIZE)
+			start = 0;
+		length -= count;
+	}
+#endif
+	
+	// Number of reports which did not fit into the queue. Is reset when
+	// the next report is sent.
+	unsigned int droppedReports = 0;
+	
+private:
+	// A ring buffer: The oldest byte is at "start", the next byte is
+	// stored "length" bytes after it - starting at the beginning again
+	// when reaching the end.
+	byte bytes[OUTPUT_QUEUE_SIZE];
+	unsigned int start = 0;
+	unsigned int length = 0;
+	unsigned int reportStartLength = 0;
+	bool overflowed = false;
+};
+
+OutputQueue output;
+
+// If 1 then the PC can change some of the configuration while the
+// Arduino is running, without uploading the program again, by sending
+// lines of text - e.g. with the "Serial monitor":
+//     get
+// prints the settings.
+//     set measurement 30
+// sets the length of a measurement, i.e. the measurementDelaySeconds of
+// the Sensor, to 30 seconds. It takes effect immediately, i.e. the
+// current measurement ends if it has been at least that long already.
+//     set debounce 8000
+// sets the debounceDelayMicros of the Sensor to 8000 microseconds.
+//     set baud 115200
+// sets the SERIAL_BAUD. It takes effect after the answer has been
+// sent, so the PC has to change its speed then as well.
+//     defaults
+// goes back to the configuration of this file.
+// Each command is answered by the settings as with "get", preceded by
+// an "OK" or an error. With OUTPUT_FORMAT_BINARY the answer is a frame
+// of frameTypeSettings instead, see BinarySettings.
+// The settings are stored in the EEPROM so they stay the same when the
+// Arduino restarts. The OUTPUT_FORMAT cannot be changed, only shown by
+// "get", because only the code of the selected one is in the program,
+// which keeps it small.
+#ifndef SERIAL_COMMANDS
+#define SERIAL_COMMANDS 0
+#endif
+
+// The settings which SERIAL_COMMANDS can change, and the values derived
+// from them, which are computed once when a setting changes, see
+// applySettings(). So the interrupt reads the debounce delay in ticks
+// from a variable instead of computing it for each pulse.
+// Without SERIAL_COMMANDS they are constants instead, so the compiler
+// inserts them into the code as with the SensorConfiguration.
+#if SERIAL_COMMANDS
+unsigned int sensorMeasurementSeconds = Sensor::measurementDelaySeconds;
+unsigned int sensorSamplesPerMeasurement = Sensor::samplesPerMeasurement;
+unsigned long sensorDebounceMicros = Sensor::debounceDelayMicros;
+// Is read by countPulse(), so it is only changed while interrupts are
+// disabled.
+unsigned long sensorDebounceTicks = Sensor::debounceDelayTicks;
+unsigned long sensorMaxMilliPulsesPerSecond = Sensor::maxMilliPulsesPerSecond;
+int displayedDecimals = Sensor::displayedDecimals;
+unsigned long serialBaud = SERIAL_BAUD;
+#else
+const unsigned int sensorMeasurementSeconds = Sensor::measurementDelaySeconds;
+const unsigned int sensorSamplesPerMeasurement = Sensor::samplesPerMeasurement;
+const unsigned long sensorDebounceMicros = Sensor::debounceDelayMicros;
+const unsigned long sensorDebounceTicks = Sensor::debounceDelayTicks;
+const unsigned long sensorMaxMilliPulsesPerSecond
+	= Sensor::maxMilliPulsesPerSecond;
+const int displayedDecimals = Sensor::displayedDecimals;
+const unsigned long serialBaud = SERIAL_BAUD;
+#endif
+
+// If 1 then the onboard LED is inverted at every pulse.
+// If 0 then the LED stays off, which makes the interrupt a bit
+// shorter, so the Arduino can count slightly faster pulses.
+#ifndef PULSE_LED
+#define PULSE_LED 1
+#endif
+
+// The LED_BUILTIN of the Arduino Uno is pin 13, which is bit 5 of
+// "port B", see setupInputPin().
+const byte ledPortBBit = PORTB5;
+
+// If 1 then the Arduino sleeps whenever loop() has nothing to do, until
+// the next interrupt wakes it up: A pulse, the timer of millis() every
+// ~ 1 millisecond, or Serial when it can send the next byte. That saves
+// power for weather masts which run from a solar panel or a battery.
+// The report then shows for how much of the time the Arduino was awake.
+// The sleep mode is "idle", which only stops the CPU: The timers and
+// Serial keep running, so millis() and the times of the pulses are
+// exactly the same as without sleeping, and every pulse is counted as
+// before. The deeper "power-save" mode would also stop the timer of
+// millis(), Timer1 of PULSE_INPUT_TIMER1_CAPTURE and Serial. Only
+// Timer2 keeps running then, and only with a 32.768 kHz watch crystal,
+// which the Arduino Uno doesn't have.
+// Additionally the unused parts of the chip are switched off: The ADC,
+// so analogRead() doesn't work anymore, SPI, I2C unless I2C_ADDRESS
+// uses it, Timer2 unless OUTPUT_FORMAT_MODBUS uses it, so analogWrite()
+// on pin 3 and 11 doesn't work, and Timer1 if neither
+// PULSE_INPUT_TIMER1_CAPTURE nor INSTRUMENTATION use it, so
+// analogWrite() on pin 9 and 10 doesn't work.
+// Notice that the USB chip and the voltage regulator of the Arduino Uno
+// use more power than the ATmega328P, which this cannot change. The
+// savings are largest on a bare ATmega328P or an Arduino Pro Mini with
+// its power LED removed.
+#ifndef LOW_POWER
+#define LOW_POWER 0
+#endif
+
+// If 1 then the "watchdog" of the ATmega328P restarts the Arduino if
+// loop() hasn't finished a pass for watchdogTimeout, e.g. because a
+// bug or electrical noise made the program hang. Without it an
+// Arduino on a remote mast would stay stuck until someone switches it
+// off and on again.
+// loop() tells the watchdog that everything is fine after it has gone
+// through all tasks. So the tasks must return quickly, which they have
+// to anyway, see Task.
+// The Arduino Uno's bootloader switches the watchdog off when it starts
+// the program. Some old bootloaders of other boards, e.g. of clones of
+// the Arduino Nano, don't, and restart over and over after the first
+// reset by the watchdog. Only enable this if your bootloader is
+// "Optiboot", as on the Arduino Uno.
+#ifndef WATCHDOG
+#define WATCHDOG 0
+#endif
+
+// If 1 then a "health record" is sent after startup and then every
+// healthIntervalMillis, which tells about problems which don't show in
+// the measurements yet:
+// - Why the Arduino was reset the last time, e.g. by the WATCHDOG,
+//   see resetFlags.
+// - How many bytes of RAM have never been used, see stackMargin().
+//   If it gets close to 0 the variables and the stack may overwrite
+//   each other, which causes strange bugs.
+// - How often a task couldn't run in time because loop() was busy for
+//   longer than its interval, see loop().
+// - How many reports were dropped because the output queue was full,
+//   and how many times of pulses were lost because the pulseTimestamps
+//   buffer was full, since startup.
+// With OUTPUT_FORMAT_BINARY it is a frame of frameTypeHealth instead,
+// see BinaryHealth. With OUTPUT_FORMAT_MODBUS nothing is sent, the
+// values are in the input registers instead, see
+// readModbusInputValues().
+#ifndef HEALTH_REPORT
+#define HEALTH_REPORT 0
+#endif
+
+#if WATCHDOG
+// Time after which the watchdog restarts the Arduino if loop() hasn't
+// finished a pass. Changing the baud by SERIAL_COMMANDS waits until the
+// buffer of Serial has been sent, which takes up to 2.1 seconds at 300
+// baud, so it is 4 seconds.
+const byte watchdogTimeout = WDTO_4S;
+#endif
+
+#if HEALTH_REPORT
+const unsigned long healthIntervalMillis = 10UL * 60 * 1000;
+// If the health record did not fit into the output queue, e.g. because
+// a report was just put into it, it is tried again after this.
+const unsigned long healthRetryMillis = 1000;
+
+// The "MCU status register" at startup: Bits which tell why the Arduino
+// was reset, see sendHealth(). Several can be set, e.g. PORF and BORF
+// when the power came on slowly.
+byte resetFlags = 0;
+// Number of times a task couldn't run in time, see loop().
+unsigned int healthTasksLate = 0;
+// Number of reports which did not fit into the output queue, and
+// PulseSnapshot::timestampsLost, since startup.
+unsigned long healthReportsDropped = 0;
+unsigned long healthTimestampsLost = 0;
+#endif
+
+// If 1 then the time it takes to process a pulse in the interrupt, and
+// the time for which takePulseSnapshot() disables interrupts, is
+// measured in CPU cycles and printed with each measurement.
+// With OUTPUT_FORMAT_BINARY they are a frame of
+// frameTypeInstrumentation instead, see BinaryInstrumentation. With
+// OUTPUT_FORMAT_MODBUS they are in the input registers, see
+// readModbusInputValues().
+// The longer interrupts are disabled, the longer a pulse may have to
+// wait until it is counted. So this allows proving that no pulses can
+// be lost: As long as all of it is far below the debounce delay every
+// pulse will be counted.
+// At 16 MHz 1 CPU cycle is 0.0625 microseconds.
+// The measurement uses Timer1. With PULSE_INPUT_EXTERNAL_INTERRUPT it
+// is then unavailable for anything else, e.g. for the Servo library or
+// analogWrite() on pin 9 and 10.
+// Needs ~ 70 bytes of RAM, plus 128 for the larger OUTPUT_QUEUE_SIZE,
+// or 64 with OUTPUT_FORMAT_BINARY.
+// This is for development only, it makes the interrupt slower.
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION 0
+#endif
+
+// Only used with INSTRUMENTATION: If 1 then additionally pin 7 is set
+// to HIGH during the measured times. Connect an oscilloscope to it to
+// see them.
+#ifndef INSTRUMENTATION_SCOPE_PIN
+#define INSTRUMENTATION_SCOPE_PIN 0
+#endif
+
+#if INSTRUMENTATION
+// Pin 7 is bit 7 of "port D", see setupInputPin().
+const byte instrumentationScopePortDBit = 7;
+
+// CPU cycles per count of Timer1: With PULSE_INPUT_TIMER1_CAPTURE it
+// counts with 1/8 of the CPU speed, see pulseTicksPerSecond, which we
+// cannot change. Otherwise we make it count every cycle.
+const byte cyclesPerTimer1Count
+	= PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE ? 8 : 1;
+
+// Statistics of a measured duration.
+struct CycleStatistics {
+	// In counts of Timer1, see cyclesPerTimer1Count.
+	unsigned int min;
+	unsigned int max;
+	unsigned long sum;
+	// Number of measurements. 32 bits like the sum, because with 16 it
+	// could overflow during a long measurement at a high wind speed.
+	unsigned long count;
+};
+
+// Time spent in the pulse interrupt.
+// Volatile because it is modified by the interrupt.
+volatile CycleStatistics isrCycles = { UINT_MAX, 0, 0, 0 };
+// Time spent with interrupts disabled in takePulseSnapshot().
+CycleStatistics criticalSectionCycles = { UINT_MAX, 0, 0, 0 };
+#if PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE
+// Time from the pulse to the start of the interrupt function. Only
+// known with PULSE_INPUT_TIMER1_CAPTURE because the time of the pulse
+// is captured by the hardware.
+volatile CycleStatistics isrLatencyCycles = { UINT_MAX, 0, 0, 0 };
+#endif
+
+// The statistics of a measured duration in CPU cycles, as reported, see
+// takeInstrumentation(). All 0 if count is 0.
+struct CycleResult {
+	unsigned long min;
+	unsigned long average;
+	unsigned long max;
+	unsigned long count;
+};
+
+// The statistics of the last measurement. reportIsrLatencyCycles stays 0
+// without PULSE_INPUT_TIMER1_CAPTURE.
+CycleResult reportIsrCycles = { 0, 0, 0, 0 };
+CycleResult reportIsrLatencyCycles = { 0, 0, 0, 0 };
+CycleResult reportCriticalSectionCycles = { 0, 0, 0, 0 };
+
+// Adds a measured duration in counts of Timer1 to the statistics.
+// Once the sum would overflow the duration only goes into min and max,
+// so the average stays the one of the durations counted so far instead
+// of becoming wrong. That needs more than 65536 durations of the
+// maximum, and the statistics are reset with each report anyway.
+inline void addCycles(volatile CycleStatistics &statistics,
+		unsigned int counts) {
+	if(counts < statistics.min)
+		statistics.min = counts;
+	if(counts > statistics.max)
+		statistics.max = counts;
+	if(statistics.sum > ULONG_MAX - counts)
+		return;
+	statistics.sum += counts;
+	++statistics.count;
+}
+
+// Measures the time from its creation until the end of the block of
+// code in which it was created, e.g.:
+//     {
+//         CycleMeasurement measurement(isrCycles);
+//         countPulse();
+//     }
+// The measurement begins and ends with a single read of Timer1, which
+// takes only a few cycles. Unsigned subtraction yields the correct
+// duration even if Timer1 overflowed in between, as long as the
+// duration is shorter than a full round of it, i.e. 4 milliseconds.
+class CycleMeasurement {
+public:
+	CycleMeasurement(volatile CycleStatistics &statistics)
+		: statistics(statistics) {
+#if INSTRUMENTATION_SCOPE_PIN
+		PORTD |= _BV(instrumentationScopePortDBit);
+#endif
+		start = TCNT1;
+	}
+	
+	~CycleMeasurement() {
+		unsigned int end = TCNT1;
+#if INSTRUMENTATION_SCOPE_PIN
+		PORTD &= ~_BV(instrumentationScopePortDBit);
+#endif
+		addCycles(statistics, end - start);
+	}
+	
+private:
+	volatile CycleStatistics &statistics;
+	unsigned int start;
+};
+#endif
+
+#if GUST_ALERT
+// See GUST_ALERT. The defaults are Beaufort 6 "strong breeze", at
+// which awnings should be retracted, and the upper end of Beaufort 5.
+const unsigned long gustAlertOnMillimetersPerSecond = 10800;
+const unsigned long gustAlertOnMillis = 0;
+const unsigned long gustAlertOffMillimetersPerSecond = 8000;
+const unsigned long gustAlertOffMillis = 10000;
+// Shorter reacts more quickly, longer is less affected by single
+// pulses coming a bit early or late.
+const unsigned long gustAlertWindowMillis = 500;
+
+static_assert(gustAlertWindowMillis % sampleIntervalMillis == 0
+		&& gustAlertWindowMillis > 0
+		&& gustAlertOnMillis % sampleIntervalMillis == 0
+		&& gustAlertOffMillis % sampleIntervalMillis == 0,
+	"The gust alert times must be multiples of sampleIntervalMillis");
+static_assert(gustAlertOffMillimetersPerSecond
+		<= gustAlertOnMillimetersPerSecond,
+	"The gust alert must end below the speed at which it starts");
+static_assert(GUST_ALERT_PIN == 0
+	|| (GUST_ALERT_PIN >= 2 && GUST_ALERT_PIN <= 19 && GUST_ALERT_PIN != 13
+		&& (GUST_ALERT_PIN != 7 || !INSTRUMENTATION_SCOPE_PIN)
+		&& channelOfPin(GUST_ALERT_PIN) == channelCount),
+	"GUST_ALERT_PIN is used for something else");
+
+// Number of samples in gustAlertWindowMillis etc.
+const byte gustAlertWindowSamples
+	= gustAlertWindowMillis / sampleIntervalMillis;
+const unsigned int gustAlertOnSamples
+	= gustAlertOnMillis / sampleIntervalMillis;
+const unsigned int gustAlertOffSamples
+	= gustAlertOffMillis / sampleIntervalMillis;
+
+// The pulse counts and the PulseSnapshot::lastPulse of the last
+// gustAlertWindowSamples samples, as a ring buffer whose oldest entry
+// is at gustAlertPosition.
+PulseCount gustAlertCounts[gustAlertWindowSamples];
+unsigned long gustAlertLastPulses[gustAlertWindowSamples];
+byte gustAlertPosition = 0;
+// Sum of gustAlertCounts.
+unsigned long gustAlertSum = 0;
+// The last pulse before the window, i.e. the pulses of gustAlertSum
+// came during the time since it. False if there was none yet, or if it
+// was so long ago that the tick count may have wrapped around since,
+// see reciprocalModeMaxPeriodSeconds.
+unsigned long gustAlertReferencePulse = 0;
+bool gustAlertReferenceValid = false;
+
+// Whether there is a gust alert.
+bool gustAlertActive = false;
+// Number of samples in a row for which the wind speed was beyond the
+// threshold for changing gustAlertActive.
+unsigned int gustAlertSamplesBeyond = 0;
+// The wind speed and millis() when gustAlertActive changed the last
+// time, for sendGustAlert().
+unsigned long gustAlertMillimetersPerSecond = 0;
+unsigned long gustAlertMillis = 0;
+// True if the alert did not fit into the output queue yet.
+bool gustAlertPending = false;
+#endif
+
+// Besides counting it, the interrupt stores the time of each pulse in
+// this many entries of the pulseTimestamps buffer, from which
+// processPulseTimestamps() takes them out again. This allows analyzing
+// the individual pulses without making the interrupt any slower.
+// Each entry costs 4 bytes of the 2048 bytes of RAM of the Arduino
+// Uno, so the default of 32 uses 128 bytes.
+// If loop() is too busy to take them out before the buffer is full
+// the further pulses are still counted but their times are lost, see
+// pulseTimestampsLost.
+// Must be a power of 2, i.e. 2, 4, 8, ..., 128, so the position in
+// the buffer can be computed quickly. 0 disables storing the times.
+#ifndef PULSE_TIMESTAMP_BUFFER_SIZE
+#define PULSE_TIMESTAMP_BUFFER_SIZE 32
+#endif
+
+static_assert(PULSE_TIMESTAMP_BUFFER_SIZE <= 128
+	&& (PULSE_TIMESTAMP_BUFFER_SIZE & (PULSE_TIMESTAMP_BUFFER_SIZE - 1)) == 0,
+	"PULSE_TIMESTAMP_BUFFER_SIZE must be 0 or a power of 2 up to 128");
+
+#if PULSE_TIMESTAMP_BUFFER_SIZE > 0
+// A "ring buffer": The interrupt writes to the entry at
+// pulseTimestampsWritten, the main code reads from the entry at
+// pulseTimestampsRead. Both numbers only ever increase - they are
+// converted to the position in the buffer by taking the remainder of
+// dividing them by the size, which likewise makes them start again
+// at the beginning of the buffer when they reach its end. So the
+// buffer contains pulseTimestampsWritten - pulseTimestampsRead
+// entries.
+// As each of both numbers is only modified by one side, and as they
+// are only 1 byte large so reading them cannot be interrupted half
+// way, there is no need to disable interrupts for accessing the
+// buffer.
+// The numbers may wrap around from 255 to 0, which is no problem:
+// Unsigned subtraction still yields the correct number of entries as
+// long as there are less than 256.
+volatile unsigned long pulseTimestamps[PULSE_TIMESTAMP_BUFFER_SIZE];
+volatile byte pulseTimestampsWritten = 0;
+volatile byte pulseTimestampsRead = 0;
+// Number of pulses whose time could not be stored because the buffer
+// was full. Read and reset by takePulseSnapshot().
+volatile unsigned int pulseTimestampsLost = 0;
+#endif
+
+// Shortest time between two pulses during the current measurement in
+// ticks as determined by processPulseTimestamps(). This tells about
+// short gusts which the average over the whole measurement hides.
+// ULONG_MAX if there were fewer than 2 pulses.
+unsigned long shortestPulsePeriod = ULONG_MAX;
+// Time in ticks of the last pulse which processPulseTimestamps() took
+// out of the buffer.
+unsigned long lastProcessedPulse = 0;
+// False if processPulseTimestamps() did not see any pulse yet.
+bool lastProcessedPulseValid = false;
+
+// If 1 then processPulseTimestamps() counts how often each length of the
+// time between two pulses happened, in a "histogram", and countPulse()
+// counts the edges which the debounce code rejected. The PC can get
+// them by sending the line "histogram", or "histogram clear" to also
+// start counting anew afterwards, see sendHistogram().
+// That tells about problems of the wind sensor before they spoil the
+// measurements: A worn bearing makes the times between the pulses of
+// a steady wind vary more, i.e. spread over more bins, and a bouncing
+// switch causes many rejected edges - or, if the debounce delay is too
+// short, very short times between pulses.
+// The bins are "log-scaled": The first one counts the times below
+// histogramFirstBinMicros and each further one the times up to twice
+// as long as the previous one. So they cover 512 microseconds to 33
+// seconds with few bins, each with the same relative precision.
+// Costs 40 bytes of RAM and very little time per pulse, see
+// addToHistogram(). Needs a PULSE_TIMESTAMP_BUFFER_SIZE above 0.
+#ifndef PULSE_HISTOGRAM
+#define PULSE_HISTOGRAM 0
+#endif
+
+#if PULSE_HISTOGRAM
+#if PULSE_TIMESTAMP_BUFFER_SIZE == 0
+#error "PULSE_HISTOGRAM needs a PULSE_TIMESTAMP_BUFFER_SIZE above 0"
+#endif
+
+// Returns the number of the highest bit which is set in the number, e.g.
+// 3 for 8 to 15. So it is the logarithm to base 2, rounded down.
+constexpr byte highestBit(unsigned long number) {
+	return number <= 1 ? 0 : 1 + highestBit(number >> 1);
+}
+
+const byte histogramBins = 18;
+const unsigned long histogramFirstBinMicros = 512;
+// The bin of a time in ticks is the number of its highest bit minus
+// this, see addToHistogram().
+const byte histogramFirstBit = highestBit(
+	histogramFirstBinMicros * (pulseTicksPerSecond / 1000000)) - 1;
+
+static_assert((histogramFirstBinMicros & (histogramFirstBinMicros - 1)) == 0,
+	"histogramFirstBinMicros must be a power of 2");
+
+// Number of times between two pulses of each bin, up to 65535.
+uint16_t histogramCounts[histogramBins];
+// Number of edges of the Sensor which the debounce code rejected, as
+// counted by countPulse() since the previous PulseSnapshot.
+volatile unsigned int sensorRejectedEdges = 0;
+// The sum of the sensorRejectedEdges of all PulseSnapshots.
+unsigned long histogramRejectedEdges = 0;
+
+// Adds a time between two pulses in ticks to the histogramCounts.
+// Called by processPulseTimestamps().
+// The bin is the number of the highest bit of the time, which
+// __builtin_clzl() tells quickly by counting the 0 bits above it
+// ("count leading zeros"), instead of computing a logarithm with
+// decimals as numberOfDecimalsNeeded() does.
+inline void addToHistogram(unsigned long ticks) {
+	byte bin = 0;
+	if(ticks > 0) {
+		byte bit = sizeof(ticks) * 8 - 1 - __builtin_clzl(ticks);
+		if(bit > histogramFirstBit)
+			bin = bit - histogramFirstBit;
+		if(bin >= histogramBins)
+			bin = histogramBins - 1;
+	}
+	if(histogramCounts[bin] < 65535)
+		++histogramCounts[bin];
+}
+#endif
+
+// If 1 then the time and level of every edge which the interrupt of the
+// Sensor sees, before the debounce code, is sent to the PC in frames of
+// frameTypeTrace, see sendTrace(). That allows recording the pulses in
+// the field and replaying them with "replay-trace" of
+// test/host-harness.cpp, through the same debounce and statistics code,
+// to find out what caused odd readings.
+// The interrupt stores the edges in a ring buffer of
+// PULSE_TRACE_BUFFER_SIZE entries like pulseTimestamps, and sendTrace()
+// sends them as the difference to the previous edge in as few bytes as
+// possible, e.g. 2 bytes for edges less than ~ 8 milliseconds apart
+// instead of 4 bytes for every time. So ~ 4000 edges per second can be
+// sent at 115200 bits per second, or ~ 350 at 9600.
+// Needs OUTPUT_FORMAT_BINARY.
+#ifndef PULSE_TRACE
+#define PULSE_TRACE 0
+#endif
+
+// Only used with PULSE_TRACE: Number of entries of the traceEdges
+// buffer, each of 4 bytes. Must be a power of 2 up to 128.
+#ifndef PULSE_TRACE_BUFFER_SIZE
+#define PULSE_TRACE_BUFFER_SIZE 32
+#endif
+
+#if PULSE_TRACE
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_BINARY
+#error "PULSE_TRACE needs OUTPUT_FORMAT_BINARY"
+#endif
+
+static_assert(PULSE_TRACE_BUFFER_SIZE > 0 && PULSE_TRACE_BUFFER_SIZE <= 128
+	&& (PULSE_TRACE_BUFFER_SIZE & (PULSE_TRACE_BUFFER_SIZE - 1)) == 0,
+	"PULSE_TRACE_BUFFER_SIZE must be a power of 2 up to 128");
+
+// A ring buffer of the edges, which works like pulseTimestamps: The
+// lowest bit of an entry is 1 if the pin was at the level of the edge
+// of the Sensor, see isActiveLevel(). The other bits are the time in
+// ticks - the lowest one is thrown away, which doesn't matter because
+// sendTrace() throws it away anyway, see traceTickShift.
+volatile unsigned long traceEdges[PULSE_TRACE_BUFFER_SIZE];
+volatile byte traceEdgesWritten = 0;
+volatile byte traceEdgesRead = 0;
+// Number of edges which could not be stored because the buffer was
+// full, up to 255. Read and reset by sendTraceFrame().
+volatile byte traceEdgesLost = 0;
+
+// Stores an edge of the Sensor in the traceEdges buffer.
+// Called by countPulse().
+inline void traceEdge(unsigned long time, bool active) {
+	byte written = traceEdgesWritten;
+	if((byte)(written - traceEdgesRead) < PULSE_TRACE_BUFFER_SIZE) {
+		traceEdges[written & (PULSE_TRACE_BUFFER_SIZE - 1)]
+			= (time & ~1UL) | active;
+		traceEdgesWritten = written + 1;
+	} else if(traceEdgesLost < 255)
+		++traceEdgesLost;
+}
+#endif
+
+// If 1 then the result of each measurement is additionally stored in
+// the EEPROM of the Arduino, which keeps it while the power is off, so
+// a PC which was not listening, e.g. because it was rebooting, can
+// get the measurements it missed afterwards: It sends the line
+//     dump 123
+// and gets all stored measurements from reportSequence 123 on, or all
+// of them with just "dump", see sendLog(). The reportSequence then
+// continues after the last stored measurement when the Arduino
+// restarts, so the PC can tell which ones it is missing.
+// The EEPROM of the Arduino Uno has 1024 bytes, which is room for
+// logRecordCount = 56 measurements, i.e. ~ 1 hour with the default
+// SENSOR_VARIANT.
+// Each byte of the EEPROM can only be written ~ 100000 times, so the
+// measurements are stored one after another in a ring, see
+// writeLog(), which spreads the writes evenly over all bytes: Every
+// byte is written once per logRecordCount measurements, i.e. the
+// EEPROM lasts for ~ 10 years with measurements of 60 seconds.
+// Needs ~ 50 bytes of RAM.
+#ifndef EEPROM_LOG
+#define EEPROM_LOG 0
+#endif
+
+// If 1 then additionally to each measurement the following is
+// printed, as used by weather services following the rules of the
+// World Meteorological Organization (WMO):
+// - The average pulses per second of the last statisticsMeanMinutes.
+// - The standard deviation of the pulses per second of the samples
+//   during that time. This tells how gusty the wind is.
+// - The "gust": The highest average pulses per second over
+//   statisticsGustSeconds during that time.
+// This needs about 400 bytes of RAM with the default values.
+#ifndef MOVING_STATISTICS
+#define MOVING_STATISTICS 1
+#endif
+
+#if MOVING_STATISTICS
+// Length of the time over which the average and stddev are computed.
+// WMO: 10 minutes.
+const unsigned int statisticsMeanMinutes = 10;
+// Length of a gust. WMO: 3 seconds.
+const unsigned int statisticsGustSeconds = 3;
+// Storing all samples of 10 minutes would need too much RAM. We thus
+// sum them up into "blocks" of this many seconds. The statistics are
+// updated whenever a block is finished, i.e. they are this many
+// seconds old at most.
+// statisticsMeanMinutes must be a multiple of this.
+const unsigned int statisticsBlockSeconds = 20;
+
+// Number of samples in a gust.
+const byte statisticsGustSamples
+	= (unsigned long)statisticsGustSeconds * 1000 / sampleIntervalMillis;
+// Number of samples in a block.
+const unsigned int statisticsBlockSamples
+	= (unsigned long)statisticsBlockSeconds * 1000 / sampleIntervalMillis;
+// Number of blocks in statisticsMeanMinutes.
+const byte statisticsBlocks
+	= (unsigned long)statisticsMeanMinutes * 60 / statisticsBlockSeconds;
+
+static_assert((unsigned long)statisticsGustSeconds * 1000
+		% sampleIntervalMillis == 0
+	&& (unsigned long)statisticsMeanMinutes * 60
+		% statisticsBlockSeconds == 0,
+	"Invalid statistics durations");
+
+// The sums below must not overflow even if every sample has the highest
+// possible count. Only a very short debounce delay can cause that,
+// e.g. of less than ~ 200 microseconds with the default durations.
+// Returns whether that is the case for the given debounce delay.
+constexpr bool statisticsDebounceValid(unsigned long debounceMicros) {
+	return maxPulsesPerSample(debounceMicros) * statisticsGustSamples
+			<= UINT_MAX
+		&& (unsigned long long)maxPulsesPerSample(debounceMicros)
+			* maxPulsesPerSample(debounceMicros)
+			* statisticsBlockSamples * statisticsBlocks <= ULONG_MAX;
+}
+
+static_assert(statisticsDebounceValid(Sensor::debounceDelayMicros),
+	"Too many pulses per sample for MOVING_STATISTICS, increase the "
+	"debounce delay or disable MOVING_STATISTICS");
+
+// Sums of a block.
+struct StatisticsBlock {
+	// Sum of the pulse counts of the samples.
+	unsigned long sum;
+	// Sum of the squares of the pulse counts of the samples, for
+	// computing the standard deviation.
+	unsigned long sumOfSquares;
+	// Highest sum of statisticsGustSamples consecutive samples which
+	// ended in this block.
+	unsigned int gustMax;
+};
+
+// All computations are "incremental": When a sample or block is added
+// then the oldest one is subtracted from the running sums, and the new
+// one is added, instead of adding up all of them again. That is much
+// quicker, so the time it takes doesn't grow when using more of them.
+
+// The last statisticsGustSamples samples, as a ring buffer whose
+// oldest entry is at statisticsGustPosition.
+unsigned int statisticsGustRing[statisticsGustSamples];
+byte statisticsGustPosition = 0;
+// Sum of statisticsGustRing.
+unsigned int statisticsGustSum = 0;
+
+// The block which is currently being filled with samples.
+StatisticsBlock statisticsCurrentBlock = { 0, 0, 0 };
+unsigned int statisticsCurrentBlockSamples = 0;
+
+// The last statisticsBlocks finished blocks as a ring buffer whose
+// oldest entry is at statisticsBlockPosition.
+StatisticsBlock statisticsBlockRing[statisticsBlocks];
+byte statisticsBlockPosition = 0;
+// Number of valid entries in statisticsBlockRing. Is less than
+// statisticsBlocks during the first statisticsMeanMinutes after
+// startup.
+byte statisticsBlocksFilled = 0;
+// Sums of all entries of statisticsBlockRing.
+unsigned long statisticsSum = 0;
+unsigned long statisticsSumOfSquares = 0;
+// Number of blocks finished since startup. Only the lowest 8 bits are
+// stored, which is enough as there are never more than 255 blocks in
+// the ring.
+byte statisticsBlockNumber = 0;
+
+// Finding the maximum of the gustMax of all blocks in the ring without
+// looking at all of them uses a "monotonic queue": It contains only
+// blocks which can still become the maximum, ordered by decreasing
+// gustMax. A block gets removed from the back as soon as a newer block
+// with a higher or equal gustMax is added, because the older one
+// can never again be the maximum: It will leave the ring before the
+// newer one. So the first entry always is the maximum.
+// The numbers are statisticsBlockNumber values.
+byte statisticsMaxQueueBlock[statisticsBlocks];
+unsigned int statisticsMaxQueueValue[statisticsBlocks];
+// Position of the first entry and number of entries of the queue.
+byte statisticsMaxQueueStart = 0;
+byte statisticsMaxQueueLength = 0;
+#endif
+
+#if TIME_SYNC
+// Minimal time between two "time" for computing the
+// clockCorrectionPpb: The PC's time and when the line arrives are only
+// precise to a few milliseconds, which is ~ 5 ppm of 10 minutes.
+const unsigned long timeSyncDriftMinMillis = 10UL * 60 * 1000;
+// Largest clockCorrectionPpb, 0.5 percent, which is the tolerance of
+// the resonator. If it seems to be off by more then the PC's clock was
+// set in between, so it is ignored.
+const long timeSyncMaxCorrectionPpb = 5000000;
+// By how much alignSample() makes the time until the next sample
+// shorter or longer at most. So the samples of the MOVING_STATISTICS
+// stay of nearly the same length while the measurements are moved to
+// the multiples of sensorMeasurementSeconds.
+const unsigned long sampleAlignMaxMillis = sampleIntervalMillis / 10;
+
+// False until the PC sent the first "time".
+bool timeSynchronized = false;
+// The PC's time in milliseconds since 1970, and the uptimeTicks(), at
+// the last "time", see hostMillis().
+unsigned long long syncHostMillis = 0;
+unsigned long long syncUptimeTicks = 0;
+// The same at the start of the time over which the clockCorrectionPpb
+// is being computed, see synchronizeTime().
+unsigned long long driftHostMillis = 0;
+unsigned long long driftUptimeTicks = 0;
+// By how much the PC's clock was faster than the one of the Arduino,
+// in parts per billion, i.e. 1000 is 1 ppm, 0.0001 percent. Negative if
+// it was slower.
+long clockCorrectionPpb = 0;
+#endif
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+static_assert(!EEPROM_LOG && !PULSE_HISTOGRAM && !TIME_SYNC,
+	"EEPROM_LOG, PULSE_HISTOGRAM and TIME_SYNC don't work with "
+	"OUTPUT_FORMAT_MODBUS");
+static_assert(MODBUS_ADDRESS >= 1 && MODBUS_ADDRESS <= 247,
+	"MODBUS_ADDRESS must be 1 to 247");
+static_assert(MODBUS_DE_PIN == 0
+	|| (MODBUS_DE_PIN >= 2 && MODBUS_DE_PIN <= 19 && MODBUS_DE_PIN != 13
+		&& (MODBUS_DE_PIN != 7 || !INSTRUMENTATION_SCOPE_PIN)
+		&& (MODBUS_DE_PIN != GUST_ALERT_PIN || !GUST_ALERT)
+		&& channelOfPin(MODBUS_DE_PIN) == channelCount),
+	"MODBUS_DE_PIN is used for something else");
+
+// Number of the values in the input and holding registers, see
+// readModbusInputValues(). Each has 2 registers.
+const byte modbusInputValues = 29 + 2 * (channelCount - 1);
+const byte modbusHoldingValues = 4;
+
+// The longest frame which is received or sent: The answer to reading
+// all input registers, with the address, function code, number of
+// bytes and CRC, which is longer than any request for the registers.
+const byte modbusFrameMaxBytes = 5 + 4 * modbusInputValues;
+static_assert(modbusFrameMaxBytes >= 9 + 4 * modbusHoldingValues,
+	"A request for writing the holding registers must fit");
+
+// The frame which the serial port interrupt is receiving, or which is
+// being sent, and its length.
+volatile byte modbusFrame[modbusFrameMaxBytes];
+volatile byte modbusLength = 0;
+// True if a byte of the frame was received with an error or didn't fit,
+// so the frame is ignored.
+volatile bool modbusFrameError = false;
+// Position of the next byte which the interrupt sends.
+volatile byte modbusSendPosition = 0;
+
+// Values of modbusState.
+// Receiving a request, until Timer2 tells that the bus was silent long
+// enough, see setupModbus().
+const byte modbusReceiving = 0;
+// A request has been received, which handleModbus() processes.
+const byte modbusReceived = 1;
+// The answer is being sent by the interrupts.
+const byte modbusSending = 2;
+
+volatile byte modbusState = modbusReceiving;
+#endif
+
+#if I2C_ADDRESS
+// Pin A4 and A5, which the I2C bus uses.
+const byte i2cSdaPin = 18;
+const byte i2cSclPin = 19;
+
+// Addresses 0 to 7 and 120 to 127 are reserved by the I2C
+// specification.
+static_assert(I2C_ADDRESS >= 8 && I2C_ADDRESS <= 119,
+	"I2C_ADDRESS must be 8 to 119");
+static_assert(channelOfPin(i2cSdaPin) == channelCount
+		&& channelOfPin(i2cSclPin) == channelCount
+		&& (!GUST_ALERT || (GUST_ALERT_PIN != i2cSdaPin
+			&& GUST_ALERT_PIN != i2cSclPin))
+		&& (OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+			|| (MODBUS_DE_PIN != i2cSdaPin && MODBUS_DE_PIN != i2cSclPin)),
+	"Pin A4 and A5 are used by I2C_ADDRESS");
+
+// The result of a channel in an I2cSnapshot.
+struct __attribute__((packed)) I2cChannel {
+	// Number of pulses during the measurement.
+	uint32_t pulseCount;
+	// Milli pulses per second by counting.
+	uint32_t milliPulsesPerSecond;
+};
+
+// What the I2C master reads, see I2C_ADDRESS: The last finished
+// measurement, as put together by updateI2cSnapshot().
+// The master writes a single byte, the position in here at which it
+// wants to start reading, and then reads as many bytes as it wants
+// from there on. Later reads start at the same position again unless
+// the master writes a new one, so a master which always wants all of
+// it only has to write 0 once and then just reads sizeof(I2cSnapshot)
+// bytes each time. Bytes beyond the end are 0xFF.
+// Multi-byte numbers are "little endian", i.e. lowest byte first, as
+// in the BinaryReport of OUTPUT_FORMAT_BINARY, for the same reasons.
+struct __attribute__((packed)) I2cSnapshot {
+	// See reportSequence. Tells the master whether there is a new
+	// measurement since it read the last one.
+	uint16_t sequence;
+	// Seconds since startup at the end of the measurement, see
+	// reportEndUptimeTicks.
+	uint32_t endUptimeSeconds;
+	// Length of the measurement in milliseconds. 0 until the first
+	// measurement has finished.
+	uint32_t measurementMillis;
+	// Number of pulses of the Sensor during the measurement.
+	uint32_t pulseCount;
+	// Milli pulses per second as with the text output, and the
+	// resulting wind speed in millimeters per second, see
+	// windMillimetersPerSecond().
+	uint32_t milliPulsesPerSecond;
+	uint32_t windMillimetersPerSecond;
+	// Moving statistics in milli pulses per second, all 0 if
+	// MOVING_STATISTICS is disabled or if the first block has not been
+	// finished yet, and the wind speeds of the mean and of the gust.
+	uint32_t meanMilliPulsesPerSecond;
+	uint32_t stddevMilliPulsesPerSecond;
+	uint32_t gustMilliPulsesPerSecond;
+	uint32_t meanWindMillimetersPerSecond;
+	uint32_t gustWindMillimetersPerSecond;
+	// Combination of the i2cFlag... values.
+	uint8_t flags;
+	// Number of entries of channels, see CHANNEL_VARIANT.
+	uint8_t numberOfChannels;
+	// All channels in the order of channelConfigurations, starting with
+	// the Sensor.
+	I2cChannel channels[channelCount];
+	// "CRC-16/MODBUS" of all bytes before it, as in sendFrame(), so the
+	// master can tell whether it read them without errors on the bus.
+	uint16_t crc;
+};
+
+// The master reads at most 255 bytes from the position it wrote.
+static_assert(sizeof(I2cSnapshot) <= 255, "Too many channels for I2C");
+
+// The snapshot is "double-buffered": The TWI_vect interrupt sends one
+// of them to the master, i2cSnapshots[i2cPublished], while
+// updateI2cSnapshot() puts the next measurement into the other one and
+// then switches i2cPublished to it. So the master never has to wait for
+// the loop(), and never gets half of one measurement and half of the
+// next one, see updateI2cSnapshot().
+I2cSnapshot i2cSnapshots[2];
+volatile byte i2cPublished = 0;
+// Value of i2cSending while nothing is sent.
+const byte i2cNoSnapshot = 2;
+// The one of i2cSnapshots which the interrupt is sending, from when the
+// master starts reading until it stops.
+volatile byte i2cSending = i2cNoSnapshot;
+// The position which the master wrote, and the one of the next byte
+// which the interrupt sends.
+volatile byte i2cStartPosition = 0;
+volatile byte i2cSendPosition = 0;
+// True if the master has started writing, so the next byte it writes
+// is the position.
+volatile bool i2cPositionExpected = false;
+// True if updateI2cSnapshot() has to put a new result into the
+// i2cSnapshots. Initially to have one before the first measurement.
+bool i2cSnapshotPending = true;
+#endif
+
+// Results of the moving statistics as computed by computeStatistics().
+// All rates are in milli pulses per second.
+struct StatisticsResult {
+	// Length of the time over which mean and stddev were computed.
+	unsigned long seconds;
+	unsigned long mean;
+	unsigned long stddev;
+	unsigned long gust;
+};
+
+// Data of the current measurement as copied out of the variables of
+// the interrupt by takePulseSnapshot().
+struct PulseSnapshot {
+	// Number of pulses of each channel since the previous snapshot,
+	// i.e. counts[0] is the one of the Sensor.
+	PulseCount counts[channelCount];
+	// Time in ticks of the last pulse of the Sensor. Only valid if there
+	// ever was a pulse.
+	unsigned long lastPulse;
+	// Time in ticks at which the snapshot was taken.
+	unsigned long now;
+	// Number of pulses since the previous snapshot whose time could not
+	// be stored in the pulseTimestamps buffer.
+	unsigned int timestampsLost;
+	// True if one of the counts overflowed, see PULSE_COUNTER_BITS. It
+	// is then the highest possible value instead. Only used by the
+	// "measurement" variable: The counts of a single snapshot cannot
+	// overflow.
+	bool countsOverflowed;
+#if PULSE_HISTOGRAM
+	// See sensorRejectedEdges.
+	unsigned int rejectedEdges;
+#endif
+};
+
+// A pulse rate as determined by measureRate(): "pulses" pulses happened
+// in "ticks" ticks, see reportRatePulses. If reciprocal is true it was
+// measured by reciprocal frequency measurement.
+struct PulseRate {
+	PulseCount pulses;
+	unsigned long ticks;
+	bool reciprocal;
+};
+
+// Time in ticks of the last pulse of previous measurements. The time
+// between it and the last pulse of the current measurement is used
+// for reciprocal frequency measurement, see reciprocalModeMaxPulses.
+unsigned long referencePulse = 0;
+// False if there was no pulse yet or if the referencePulse is too old,
+// see reciprocalModeMaxPeriodSeconds.
+bool referencePulseValid = false;
+
+#if REPORT_INTERVAL_SECONDS
+// The result of an interval, see REPORT_INTERVAL_SECONDS.
+struct ReportInterval {
+	// Number of pulses of each channel.
+	PulseCount counts[channelCount];
+	// Time in ticks of the last pulse of the Sensor until the end of the
+	// interval, as in the PulseSnapshot.
+	unsigned long lastPulse;
+	// Length of the interval.
+	unsigned int millis;
+};
+
+// The intervals of the window as a ring buffer whose oldest entry is at
+// reportIntervalPosition, see addReportInterval(). Only the first
+// sensorMeasurementSeconds / REPORT_INTERVAL_SECONDS entries are used.
+ReportInterval reportIntervals[reportIntervalsMax];
+byte reportIntervalPosition = 0;
+// Number of valid entries of reportIntervals. Less than the window
+// during the first measurement.
+byte reportIntervalsFilled = 0;
+// Sums of the counts and millis of the intervals in the window.
+unsigned long reportWindowCounts[channelCount];
+unsigned long reportWindowMillis = 0;
+// The lastPulse of the interval which left the window the last time,
+// i.e. of the last pulse before the window, for reciprocal frequency
+// measurement over the window as with referencePulse. False if there
+// was no pulse before the window yet.
+unsigned long reportWindowReference = 0;
+bool reportWindowReferenceValid = false;
+#endif
+
+// Result of the last finished measurement as stored by
+// finishMeasurement() for being printed by printReport().
+// The pulses of each channel, i.e. reportPulseCounts[0] is for the
+// Sensor.
+PulseCount reportPulseCounts[channelCount];
+// The pulse rate as determined by finishMeasurement() with either
+// counting or reciprocal frequency measurement: reportRatePulses
+// pulses happened in reportRateTicks ticks.
+// It is stored as this fraction instead of as pulses per second so it
+// can be converted to pulses per second and per minute without
+// rounding errors, see milliPulsesPer().
+PulseCount reportRatePulses = 0;
+unsigned long reportRateTicks = 1;
+// True if the rate was measured by reciprocal frequency
+// measurement.
+bool reportReciprocal = false;
+#if REPORT_INTERVAL_SECONDS
+// The rate during the last interval alone, see REPORT_INTERVAL_SECONDS.
+PulseRate reportCurrentRate = { 0, 1, false };
+#endif
+// shortestPulsePeriod and PulseSnapshot::timestampsLost of the last
+// finished measurement.
+unsigned long reportShortestPulsePeriod = ULONG_MAX;
+unsigned int reportTimestampsLost = 0;
+// PulseSnapshot::countsOverflowed of the last finished measurement.
+bool reportCountsOverflowed = false;
+// Length of the last finished measurement. Is usually equal to
+// sensorMeasurementSeconds but can be a few milliseconds longer
+// if loop() was busy with something else when the measurement was due.
+unsigned long reportMeasurementMillis = 0;
+// Value of millis() when the last finished measurement ended.
+unsigned long reportEndMillis = 0;
+#if LOW_POWER
+// Percentage of the last finished measurement during which the Arduino
+// was awake, i.e. not sleeping, in thousandths of a percent: 1000 means
+// 1 percent.
+unsigned long reportAwakeMilliPercent = 0;
+#endif
+// Value of uptimeTicks() when the last finished measurement ended.
+// Unlike reportEndMillis it never overflows back to 0, so it can be
+// used for timestamping the reports even on an Arduino which has been
+// running for years.
+unsigned long long reportEndUptimeTicks = 0;
+#if TIME_SYNC
+// The PC's time in milliseconds since 1970 at the start and at the end
+// of the last finished measurement, see TIME_SYNC. 0 if the time has
+// not been synchronized yet.
+unsigned long long reportStartUnixMillis = 0;
+unsigned long long reportEndUnixMillis = 0;
+#endif
+// Number of the last finished measurement. Starts at 1 after startup
+// and wraps around to 0 after 65535. Allows the PC to notice if
+// reports got lost. With EEPROM_LOG it continues after the last
+// stored measurement instead, see setupLog().
+unsigned int reportSequence = 0;
+// Set to true by finishMeasurement() to tell printReport() that there
+// is a new result to print.
+bool reportPending = false;
+
+// Time in milliseconds at which the current measurement was started.
+unsigned long measurementStart = 0;
+#if TIME_SYNC
+// The same as uptimeTicks(), see hostMillis().
+unsigned long long measurementStartUptime = 0;
+#endif
+// The samples of the current measurement added up by takeSample().
+// All values start at 0, or false.
+PulseSnapshot measurement = {};
+unsigned int samplesInMeasurement = 0;
+#if LOW_POWER
+// Microseconds which the Arduino slept during the current measurement,
+// see sleepUntilInterrupt().
+unsigned long sleepMicros = 0;
+#endif
+
+// Instead of waiting with delay(), which would block the Arduino from
+// doing anything else, loop() uses a very simple "scheduler":
+// Each thing the Arduino has to do is a "task", i.e. a function which
+// loop() calls whenever its intervalMillis has passed since the last
+// time it ran. The functions must return quickly so the other tasks
+// are not delayed, i.e. they must never call delay().
+// If you want the Arduino to do something else additionally to
+// measuring the wind then add a function for it to the list of tasks.
+struct Task {
+	void (*run)();
+	// An interval of 0 means: Run at every pass of loop().
+	unsigned long intervalMillis;
+	// Time in milliseconds at which the task was due the last time.
+	unsigned long lastRunMillis;
+};
+
+// True if readCommands() receives lines of text from the PC, for the
+// features which are controlled by them. Not with OUTPUT_FORMAT_MODBUS,
+// which uses the serial port by itself.
+#define COMMAND_LINES ((SERIAL_COMMANDS || EEPROM_LOG || PULSE_HISTOGRAM \
+	|| TIME_SYNC) && OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS)
+
+void setupPulseInput();
+void processPulseTimestamps();
+void takeSample();
+void printReport();
+void updateI2cSnapshot();
+void sendTrace();
+void readCommands();
+void writeLog();
+void sendLog();
+void sendHealth();
+void sendOutput();
+void handleModbus();
+
+Task tasks[] = {
+	// Must run before takeSample() so it has seen all pulses of the
+	// measurement.
+	{ processPulseTimestamps, 0, 0 },
+	{ takeSample, sampleIntervalMillis, 0 },
+	{ printReport, 0, 0 },
+#if I2C_ADDRESS
+	{ updateI2cSnapshot, 0, 0 },
+#endif
+#if PULSE_TRACE
+	// After printReport() so the reports are in the output queue first,
+	// see sendTraceFrame().
+	{ sendTrace, 0, 0 },
+#endif
+#if COMMAND_LINES
+	{ readCommands, 0, 0 },
+#endif
+#if EEPROM_LOG
+	{ writeLog, 0, 0 },
+	// After printReport() for the same reason as sendTrace().
+	{ sendLog, 0, 0 },
+#endif
+#if HEALTH_REPORT && OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	{ sendHealth, healthIntervalMillis, 0 },
+#endif
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+	{ handleModbus, 0, 0 },
+#else
+	{ sendOutput, 0, 0 },
+#endif
+};
+
+const byte taskCount = sizeof(tasks) / sizeof(tasks[0]);
+
+// The other functions which are used before they are defined below.
+// The Arduino software generates these "prototypes" by itself, but
+// a normal C++ compiler needs them, e.g. for test/host-harness.cpp.
+void setupChannels();
+void takePulseSnapshot(PulseSnapshot &snapshot);
+void finishMeasurement(unsigned long now, unsigned long long uptime);
+PulseRate measureRate(PulseCount count, unsigned long millis,
+	unsigned long lastPulse, unsigned long now, unsigned long reference,
+	bool referenceValid);
+void addReportInterval(const PulseSnapshot &interval, unsigned long millis);
+unsigned long long uptimeTicks();
+unsigned long channelMilliPulsesPerSecond(byte channel);
+void printTextReport();
+void printChannels();
+void sendBinaryReport();
+void sendFrame(byte type, const void *data, byte length);
+#if MOVING_STATISTICS
+void addStatisticsSample(unsigned int count);
+void addStatisticsBlock(const StatisticsBlock &block);
+void printStatistics();
+#endif
+bool computeStatistics(StatisticsResult &result);
+void setupInstrumentation();
+void takeInstrumentation();
+void printInstrumentation();
+void setupLowPower();
+void sleepUntilInterrupt();
+void setupLog();
+void logReport();
+void setupSettings();
+bool parseNumber(const char *text, unsigned long &number);
+unsigned long multiplyDivide(unsigned long a, unsigned long b,
+	unsigned long c);
+unsigned long integerSquareRoot(unsigned long long number);
+byte eepromCheck(const void *data, byte length);
+unsigned long windMillimetersPerSecond(unsigned long milliPulsesPerSecond);
+void printMilli(unsigned long milli);
+unsigned long long hostMillis(unsigned long long uptime);
+bool alignSample(unsigned long now, unsigned long long uptime);
+void printThousandths(long long thousandths);
+void paintStack();
+void updateGustAlert(const PulseSnapshot &sample, unsigned long now);
+void setupModbus();
+void setupI2c();
 
 void setup() 
 {
-	Serial.begin(9600); 
+#if WATCHDOG || HEALTH_REPORT
+#if HEALTH_REPORT
+	resetFlags = MCUSR;
+#endif
+	// The flags stay set until they are cleared, so the next reset
+	// wouldn't tell what caused it. After a reset by the watchdog it also
+	// stays on, with the shortest timeout, until WDRF is cleared.
+	MCUSR = 0;
+	wdt_disable();
+#endif
+#if SERIAL_COMMANDS
+	// Before everything which uses the settings.
+	setupSettings();
+#endif
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+	setupModbus();
+#else
+	Serial.begin(serialBaud); 
+#endif
 	
-	pinMode(pin, INPUT);
 	// Tells the Arduino to attach the pin to +5V by a 20 kOhm
 	// resistor and thereby define its idle state as HIGH.
 	// This is necessary because when the wind sensor contact is not
@@ -103,112 +2320,3689 @@ void setup()
 	// See:
 	// https://www.arduino.cc/reference/en/language/functions/digital-io/pinmode/
 	// https://www.arduino.cc/en/Tutorial/DigitalPins
-	pinMode(pin, INPUT_PULLUP);
-	// Count voltage going from HIGH to LOW as a pulse by
-	// configurating the interrupt controller to call countPulse()
-	// on a falling signal edge.
-	// Change to LOW is the pulse because we configured the pin to
-	// be at HIGH by default, and because the other wire of the wind
-	// sensor is attached to GND, i.e. LOW. So if the wind sensor
-	// contact is closed then the pin will be pulled to low.
-	// See: https://www.arduino.cc/reference/en/language/functions/external-interrupts/attachinterrupt/
-	attachInterrupt(digitalPinToInterrupt(pin), countPulse, FALLING);
-	// Disable counting of pulses at first to ensure the first
-	// measurement in loop() is correct.
-	noInterrupts();
-	
-	pinMode(LED_BUILTIN, OUTPUT);
-	// Initialize the LED to match the ledState variable.
-	digitalWrite(LED_BUILTIN, ledState);
-}
-
-void countPulse() {
-	// WARNING: millis() is NOT updated during an interrupt!
-	// We can only measure the value at the start of it - which is
-	// sufficient for our purposes here.
-	unsigned long time = millis();
-	unsigned long timeSinceLastPulse;
-	
-	if(time >= lastPulse)
-		timeSinceLastPulse = time - lastPulse;
-	else {
-		// The Arduino has been running for so long that the time
-		// counter reached ULONG_MAX and overflowed back to 0.
-		// This happens after ~ 50 days.
-		// See: https://www.arduino.cc/reference/en/language/functions/time/millis/
-		timeSinceLastPulse = (ULONG_MAX - lastPulse) + time;
+	Sensor::setupPin();
+#if DEBOUNCE_STRATEGY == DEBOUNCE_ADAPTIVE
+	// Start with the full debounce delay as lockout, see debounceEdge().
+	for(byte channel = 0; channel < channelCount; ++channel) {
+		pulseCounters[channel].averagePeriod = 4 * (channel == 0
+			? sensorDebounceTicks : channelDebounceTicks(channel));
 	}
+#endif
+	setupPulseInput();
+	setupChannels();
+#if INSTRUMENTATION
+	setupInstrumentation();
+#endif
+#if LOW_POWER
+	setupLowPower();
+#endif
+#if EEPROM_LOG
+	setupLog();
+#endif
 	
-	if(timeSinceLastPulse <= debounceDelayMillis)
-		return;
-	
-	lastPulse = time;
+#if PULSE_LED
+	// Same as pinMode(LED_BUILTIN, OUTPUT). The LED is off initially.
+	DDRB |= _BV(ledPortBBit);
+#endif
+#if GUST_ALERT && GUST_ALERT_PIN
+	setupOutputPin(GUST_ALERT_PIN);
+#endif
+#if I2C_ADDRESS
+	setupI2c();
+#endif
 	
-	++pulseCount;
-	// If you plan to use this with something faster than a wind
-	// sensor you should check for overflow!
-	/*
-	if(pulseCount == UINT_MAX)
-		Serial.print("ERROR: RPM too high, counter will overflow!!");
-	*/
+	// Start the first measurement now. Pulses which were counted while
+	// setup() was still running are thrown away to ensure the first
+	// measurement is correct.
+	unsigned long now = millis();
+	PulseSnapshot snapshot;
+	takePulseSnapshot(snapshot);
+	measurementStart = now;
+#if TIME_SYNC
+	measurementStartUptime = uptimeTicks();
+#endif
+	for(byte i = 0; i < taskCount; ++i)
+		tasks[i].lastRunMillis = now;
 	
-	ledState = (ledState == HIGH ? LOW : HIGH);
-	digitalWrite(LED_BUILTIN, ledState);
+#if HEALTH_REPORT
+	paintStack();
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	// The first one right away, as the PC wants to know why the Arduino
+	// was reset. The output queue is still empty, so it fits.
+	sendHealth();
+#endif
+#endif
+#if WATCHDOG
+	// Only now, so setup() doesn't have to tell the watchdog that
+	// everything is fine while it reads the EEPROM etc.
+	wdt_enable(watchdogTimeout);
+#endif
 }
 
-void loop()
-{ 
-	pulseCount = 0; 
-	// Enable counting of pulses.
-	interrupts();
-	// Cast variable up to unsigned long to leave some room for the
-	// multiplication by 1000. delay() consumes ulong anyway.
-	delay((unsigned long)measurementDelaySeconds * 1000); 
-	// Disable counting of pulses.
-	noInterrupts();
-	
-	float pulsesPerSecond
-		= (float)pulseCount / measurementDelaySeconds;
-	float pulsesPerMinute
-		= (float)pulseCount*60 / measurementDelaySeconds;
-	
-	Serial.print("Pulses measured: "); 
-	Serial.println(pulseCount);
-	Serial.print("Pulses per second: "); 
-	// Print the pulses per second with the number of decimals chosen
-	// as needed to represent the maximal impulse frequency we can
-	// reliably measure as determined by the debounce delay.
-	// In other words: Don't show more decimals than we're capable
-	// of measuring accurately.
-	int displayedDecimals
-		= numberOfDecimalsNeeded((float)1 / maxImpulsesPerSecond);
-	Serial.println(pulsesPerSecond, displayedDecimals);
-	Serial.print("Pulses per minute: ");
-	// Same number of decimals as with seconds: We're using the same
-	// input value to calculate this as with the seconds so the
-	// precision has not changed as the input has not changed.
-	Serial.println(pulsesPerMinute, displayedDecimals);
+// Counts a pulse of the Sensor which has passed the debounce code and
+// stores its time, in ticks, in the pulseTimestamps buffer.
+// Called by countPulse().
+inline void registerPulse(unsigned long time) {
+	++pulseCounters[0].count;
 	
-	// The wind sensor is producing more impulses than we could
-	// measure at most with the given debounce delay.
-	if(pulsesPerSecond >= maxImpulsesPerSecond) {
-		Serial.println(
-			"ERROR: Debounce delay too high for impulse speed!");
-	}
+#if PULSE_TIMESTAMP_BUFFER_SIZE > 0
+	byte written = pulseTimestampsWritten;
+	if((byte)(written - pulseTimestampsRead) < PULSE_TIMESTAMP_BUFFER_SIZE) {
+		pulseTimestamps[written & (PULSE_TIMESTAMP_BUFFER_SIZE - 1)] = time;
+		// Only make the entry visible to processPulseTimestamps() after
+		// it has been completely written.
+		pulseTimestampsWritten = written + 1;
+	} else
+		++pulseTimestampsLost;
+#else
+	// Not stored then, e.g. with BUILD_PROFILE_MINIMAL.
+	(void)time;
+#endif
 	
-	Serial.println("-----------------------------------------------");
+#if PULSE_LED
+	// Invert the LED. Writing a 1 to a bit of the PINB register makes
+	// the hardware invert the pin, which takes a single instruction.
+	// digitalWrite() would take dozens because it has to look up the
+	// port of the pin and has to read the old state.
+	PINB = _BV(ledPortBBit);
+#endif
 }
 
-// Returns the number of decimal places needed to display all numbers
-// >= smallestNumber
-int numberOfDecimalsNeeded(float smallestNumber) {
-	// The logarithm of base 10 of X is the number which satisfies
-	///     10 ^ log10(X) = X.
-	// Thus if our X is 0.001, we get log10(x) = -3.
-	// So at first glance abs(log(x))) is the number of decimal places
-	// needed to display all numbers >= smallestNumber.
-	// However if smallestNumber is not a power of 10 then this may be
-	// something such as e.g. 1.2345 - then 2 decimal places would be
-	// better. Thus we always round up - which is what ceil() is for.
-	return ceil(abs(log10(smallestNumber)));
-}
\ No newline at end of file
+// Only used with DEBOUNCE_ADAPTIVE: DEBOUNCE_ADAPTIVE_MIN_MICROS
+// converted to ticks, see pulseTicksPerSecond.
+const unsigned long adaptiveDebounceMinTicks
+	= DEBOUNCE_ADAPTIVE_MIN_MICROS * (pulseTicksPerSecond / 1000000);
+
+// Decides whether an edge at the pin of a channel is a pulse according
+// to the DEBOUNCE_STRATEGY.
+// The time is the time of the edge in ticks, active tells whether the
+// pin is at the level of the edge after it, see isActiveLevel(). With
+// DEBOUNCE_LOCKOUT and DEBOUNCE_ADAPTIVE the interrupts only happen on
+// the edge of the channel, so it is always true then, except for the
+// pin change interrupts which happen on both edges.
+// The debounceTicks are the debounce delay of the channel.
+// Returns true if it is a pulse. The time of the pulse is then stored
+// in the lastPulse of the counter.
+// Called by the interrupts, so this must be quick. As it is "inline"
+// and called with constant debounceTicks, the compiler removes the
+// code of the other strategies and inserts the values directly.
+inline bool debounceEdge(volatile PulseCounter &counter, unsigned long time,
+		bool active, unsigned long debounceTicks) {
+#if DEBOUNCE_STRATEGY == DEBOUNCE_LOCKOUT
+	if(!active || timeSince(counter.lastPulse, time) <= debounceTicks)
+		return false;
+	
+	counter.lastPulse = time;
+	return true;
+#elif DEBOUNCE_STRATEGY == DEBOUNCE_STABLE
+	if(active) {
+		// If the interrupt of the previous edge was missed, e.g. because
+		// the pin bounced faster than the interrupt could run, keep the
+		// earlier time.
+		if(!counter.active) {
+			counter.active = true;
+			counter.activeSince = time;
+		}
+		return false;
+	}
+	
+	if(!counter.active)
+		return false;
+	
+	counter.active = false;
+	if(timeSince(counter.activeSince, time) < debounceTicks)
+		return false;
+	
+	counter.lastPulse = counter.activeSince;
+	return true;
+#elif DEBOUNCE_STRATEGY == DEBOUNCE_ADAPTIVE
+	if(!active)
+		return false;
+	
+	unsigned long period = timeSince(counter.lastPulse, time);
+	// Shifting by 2 bits to the right is a quick division by 4.
+	unsigned long lockout = counter.averagePeriod >> 2;
+	if(lockout > debounceTicks)
+		lockout = debounceTicks;
+	if(lockout < adaptiveDebounceMinTicks)
+		lockout = adaptiveDebounceMinTicks;
+	if(period <= lockout)
+		return false;
+	
+	// Longer periods can't make the lockout longer than the debounce
+	// delay, so they are limited to that. That way after a pause the
+	// average becomes short again after a few quick pulses.
+	if(period > 4 * debounceTicks)
+		period = 4 * debounceTicks;
+	// Moving average which gives each new period a weight of 1/8, so
+	// single longer or shorter periods don't change it much.
+	counter.averagePeriod
+		= counter.averagePeriod - (counter.averagePeriod >> 3) + (period >> 3);
+	
+	counter.lastPulse = time;
+	return true;
+#endif
+}
+
+// Counts a pulse of the Sensor if the edge, see debounceEdge(), passes
+// the debounce code.
+// Called by the interrupt of the selected PULSE_INPUT.
+inline void countPulse(unsigned long time, bool active) {
+#if PULSE_TRACE
+	traceEdge(time, active);
+#endif
+	if(debounceEdge(pulseCounters[0], time, active, sensorDebounceTicks))
+		registerPulse(pulseCounters[0].lastPulse);
+#if PULSE_HISTOGRAM
+	// With DEBOUNCE_STABLE each pulse starts with an active edge which
+	// is not counted yet, so only the others are rejected edges then.
+	else if(DEBOUNCE_STRATEGY != DEBOUNCE_STABLE || !active)
+		++sensorRejectedEdges;
+#endif
+}
+
+#if PULSE_INPUT == PULSE_INPUT_EXTERNAL_INTERRUPT
+
+void setupPulseInput() {
+	// Count voltage going from HIGH to LOW as a pulse by
+	// configurating the interrupt controller to call countPulse()
+	// on a falling signal edge - if the Sensor has the usual edgeMode
+	// of FALLING.
+	// Change to LOW is the pulse because we configured the pin to
+	// be at HIGH by default, and because the other wire of the wind
+	// sensor is attached to GND, i.e. LOW. So if the wind sensor
+	// contact is closed then the pin will be pulled to low.
+	enableExternalInterrupt(Sensor::interruptNumber,
+		interruptEdge(Sensor::edge));
+}
+
+// Returns the current time in ticks.
+// Unlike millis(), micros() returns the correct time in interrupts and
+// while interrupts are disabled - in the latter case only for up to 1
+// millisecond, which we never disable them for.
+inline unsigned long currentPulseTicks() {
+	return micros();
+}
+
+// micros() overflows back to 0 every ~ 71 minutes. uptimeTicks() counts
+// that in here, which is the upper 32 bits of its result.
+unsigned long tickOverflows = 0;
+// Result of micros() at the previous call of uptimeTicks().
+unsigned long uptimeTicksLast = 0;
+
+// Returns the number of ticks since startup, as 64 bits, which would
+// only overflow after ~ 580000 years.
+// Timer0, from which micros() gets its time, belongs to the Arduino
+// core, so we can't use its overflow interrupt. Instead each call
+// notices whether micros() has overflowed since the previous one. It
+// thus must be called at least once per ~ 71 minutes, which
+// takeSample() does.
+// Must not be called in interrupts.
+unsigned long long uptimeTicks() {
+	unsigned long ticks = currentPulseTicks();
+	
+	if(ticks < uptimeTicksLast)
+		++tickOverflows;
+	uptimeTicksLast = ticks;
+	
+	return ((unsigned long long)tickOverflows << 32) | ticks;
+}
+
+#elif PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE
+
+// Timer1 only counts from 0 to 65535 (16 bits) and then starts at 0
+// again, which takes 32.768 milliseconds at our speed. So to get times
+// which can be compared over a longer time than that we count how
+// often that happened in here. The number of overflows is used as the
+// upper 16 bits of a 32 bit tick count which then overflows only
+// every ~ 36 minutes.
+volatile unsigned int timer1Overflows = 0;
+// Number of overflows of timer1Overflows, i.e. the upper 32 bits of
+// the 64 bit tick count of uptimeTicks(). It is separate so the
+// interrupts, which only need 32 bits, don't have to read it.
+volatile unsigned long timer1OverflowsHigh = 0;
+
+void setupPulseInput() {
+	// We configure the registers of Timer1 directly because there is no
+	// Arduino function for the input capture unit.
+	// See chapter "16-bit Timer/Counter1 with PWM" of the ATmega328P
+	// datasheet.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		// Normal mode: Count up to 65535, then overflow to 0.
+		TCCR1A = 0;
+		// Clock source = CPU clock / 8, see pulseTicksPerSecond.
+		// ICES1 not set = capture on the falling edge, for the same
+		// reasons as explained in the PULSE_INPUT_EXTERNAL_INTERRUPT
+		// version of this function.
+		TCCR1B = _BV(CS11)
+			| (Sensor::edge == RISING ? _BV(ICES1) : 0)
+			| (TIMER1_NOISE_CANCELER ? _BV(ICNC1) : 0);
+		TCNT1 = 0;
+		timer1Overflows = 0;
+		timer1OverflowsHigh = 0;
+		// Clear any old capture and overflow by writing a 1 to them.
+		TIFR1 = _BV(ICF1) | _BV(TOV1);
+		// Call the below ISR()s on a capture and on an overflow.
+		TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+	}
+}
+
+ISR(TIMER1_OVF_vect) {
+	if(++timer1Overflows == 0)
+		++timer1OverflowsHigh;
+}
+
+// Converts a value of Timer1, i.e. the lower 16 bits of a tick count,
+// to the full 32 bit tick count.
+// Must be called with interrupts disabled, i.e. in an interrupt or in
+// an ATOMIC_BLOCK.
+inline unsigned long timer1Ticks(unsigned int timerValue) {
+	unsigned int overflows = timer1Overflows;
+	
+	// If Timer1 overflowed while interrupts were disabled then
+	// TIMER1_OVF_vect has not run yet. In that case the overflow has
+	// only happened before the timerValue was taken if the timerValue
+	// is small, i.e. close after the overflow.
+	if((TIFR1 & _BV(TOV1)) && timerValue < 0x8000)
+		++overflows;
+	
+	return ((unsigned long)overflows << 16) | timerValue;
+}
+
+// Returns the current time in ticks.
+// Must be called with interrupts disabled.
+inline unsigned long currentPulseTicks() {
+	return timer1Ticks(TCNT1);
+}
+
+// Returns the number of ticks since startup, as 64 bits, which would
+// only overflow after ~ 290000 years.
+unsigned long long uptimeTicks() {
+	unsigned long long ticks;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		unsigned int timerValue = TCNT1;
+		unsigned int overflows = timer1Overflows;
+		unsigned long overflowsHigh = timer1OverflowsHigh;
+		
+		// See timer1Ticks().
+		if((TIFR1 & _BV(TOV1)) && timerValue < 0x8000) {
+			if(++overflows == 0)
+				++overflowsHigh;
+		}
+		
+		ticks = ((unsigned long long)overflowsHigh << 32)
+			| ((unsigned long)overflows << 16) | timerValue;
+	}
+	
+	return ticks;
+}
+
+// Passes the captured pulses to countPulse() with this PULSE_INPUT.
+ISR(TIMER1_CAPT_vect) {
+#if INSTRUMENTATION
+	CycleMeasurement measurement(isrCycles);
+	// ICR1 can't have changed yet: The next pulse can't be captured
+	// before this interrupt has finished because interrupts are
+	// disabled during it. TCNT1 may have overflowed since the capture,
+	// which the unsigned subtraction handles.
+	addCycles(isrLatencyCycles, TCNT1 - ICR1);
+#endif
+	
+	// ICR1 is the value which Timer1 had when the pulse happened.
+	// Unlike with micros() in the external interrupt it is not delayed
+	// by the time it took until we got here.
+	// TIMER1_OVF_vect cannot run in between because it has a lower
+	// priority than us.
+	unsigned long time = timer1Ticks(ICR1);
+	
+#if DEBOUNCE_STRATEGY == DEBOUNCE_STABLE
+	// The input capture unit can only capture one of the edges, so we
+	// alternate between them: If ICES1 is set the rising edge was
+	// captured.
+	bool active = isActiveLevel(Sensor::edge, TCCR1B & _BV(ICES1));
+	TCCR1B ^= _BV(ICES1);
+	// The datasheet says that changing the edge may cause a capture,
+	// which we clear by writing a 1 to it.
+	TIFR1 = _BV(ICF1);
+	countPulse(time, active);
+	
+	// If the pin has already changed back before we switched the edge
+	// then the input capture unit has missed that. So we process it now,
+	// and switch back to the edge which will happen next.
+	if(isActiveLevel(Sensor::edge, readPin(Sensor::pin)) != active) {
+		TCCR1B ^= _BV(ICES1);
+		TIFR1 = _BV(ICF1);
+		countPulse(currentPulseTicks(), !active);
+	}
+#else
+	countPulse(time, true);
+#endif
+}
+
+#endif
+
+// Counts a pulse of the given channel besides the Sensor if the edge,
+// see debounceEdge(), passes the debounce code.
+// Called by the below ISR()s. As they call it with a constant channel,
+// or in a loop over the constant channelConfigurations, the compiler
+// can insert the debounce delay directly.
+inline void countChannelPulse(byte channel, unsigned long time,
+		bool active) {
+	volatile PulseCounter &counter = pulseCounters[channel];
+	
+	if(debounceEdge(counter, time, active, channelDebounceTicks(channel)))
+		++counter.count;
+}
+
+#if PULSE_INPUT == PULSE_INPUT_EXTERNAL_INTERRUPT || ADDITIONAL_CHANNELS
+
+// Called by the below ISR()s of the external interrupts, for
+// interruptNumber 0 on pin 2 and 1 on pin 3.
+// As it is a template, the channel is computed while compiling, so the
+// compiler removes the code which is not needed for the pin.
+template<byte interruptNumber>
+inline void externalInterrupt() {
+	constexpr byte pin = interruptNumber + 2;
+	constexpr byte channel = channelOfPin(pin);
+	if(channel >= channelCount)
+		return;
+	
+#if INSTRUMENTATION
+	CycleMeasurement measurement(isrCycles);
+#endif
+	// We can only measure the time at the start of the interrupt, a few
+	// microseconds after the edge - which is sufficient for our
+	// purposes here.
+	unsigned long time = currentPulseTicks();
+	// Only DEBOUNCE_STABLE needs to know the level of the pin, see
+	// interruptEdge(). Otherwise the interrupt only happens on the edge.
+	bool active = DEBOUNCE_STRATEGY != DEBOUNCE_STABLE
+		|| isActiveLevel(channelConfigurations[channel].edge, readPin(pin));
+	
+#if PULSE_INPUT == PULSE_INPUT_EXTERNAL_INTERRUPT
+	if(channel == 0) {
+		countPulse(time, active);
+		return;
+	}
+#endif
+	// With PULSE_INPUT_TIMER1_CAPTURE the Sensor is on pin 8, so the
+	// channel can't be 0 then.
+	countChannelPulse(channel, time, active);
+}
+
+// The interrupt functions of the external interrupts. Those are called
+// by the hardware directly, which is quicker than attachInterrupt():
+// That would call an Arduino function which then calls countPulse()
+// by looking up its address in a table.
+// Only the ones of pins which are used by a channel are enabled by
+// setupPulseInput() and setupChannels().
+ISR(INT0_vect) {
+	externalInterrupt<0>();
+}
+
+ISR(INT1_vect) {
+	externalInterrupt<1>();
+}
+
+#endif
+
+#if ADDITIONAL_CHANNELS
+
+// Numbers of the ports for the pin change interrupts. They are equal to
+// the number of the bits in the PCICR register, and of the PCMSK
+// registers, for the ports.
+const byte portB = 0;
+const byte portC = 1;
+const byte portD = 2;
+
+// Returns the port of the given pin, see setupInputPin().
+constexpr byte portOfPin(byte pin) {
+	return pin < 8 ? portD : pin < 14 ? portB : portC;
+}
+
+// Returns the bit of the given pin in its port.
+constexpr byte portBitOfPin(byte pin) {
+	return pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14;
+}
+
+// Returns true if the given pin uses a pin change interrupt, i.e. is
+// not one of the pins of the external interrupts.
+constexpr bool usesPinChangeInterrupt(byte pin) {
+	return pin != 2 && pin != 3;
+}
+
+// State of the pins of each port when its pin change interrupt
+// happened the last time. Only used by the interrupts, and by
+// setupChannels() before they are enabled.
+byte pinChangeLastState[3];
+
+// Called by the below ISR()s of the pin change interrupts with the
+// number of the port and the current state of its pins. Passes the edge
+// of each channel of the port whose pin has changed to
+// countChannelPulse().
+template<byte port>
+inline void pinChangeInterrupt(byte state) {
+#if INSTRUMENTATION
+	CycleMeasurement measurement(isrCycles);
+#endif
+	byte changed = state ^ pinChangeLastState[port];
+	pinChangeLastState[port] = state;
+	// Take the time before the loop so all channels get the time of the
+	// interrupt.
+	unsigned long time = currentPulseTicks();
+	
+	for(byte channel = 1; channel < channelCount; ++channel) {
+		const ChannelConfiguration &configuration
+			= channelConfigurations[channel];
+		if(!usesPinChangeInterrupt(configuration.pin)
+				|| portOfPin(configuration.pin) != port)
+			continue;
+		
+		byte bit = _BV(portBitOfPin(configuration.pin));
+		if(!(changed & bit))
+			continue;
+		
+		countChannelPulse(channel, time,
+			isActiveLevel(configuration.edge, state & bit));
+	}
+}
+
+// The interrupt functions of the pin change interrupts of the ports.
+// Only the ones of ports which are used by a channel are enabled by
+// setupChannels().
+// Notice that this makes the SoftwareSerial library unusable as it
+// needs these interrupts as well.
+ISR(PCINT0_vect) {
+	pinChangeInterrupt<portB>(PINB);
+}
+
+ISR(PCINT1_vect) {
+	pinChangeInterrupt<portC>(PINC);
+}
+
+ISR(PCINT2_vect) {
+	pinChangeInterrupt<portD>(PIND);
+}
+
+#endif
+
+// Configures the pins and interrupts of the channels besides the
+// Sensor, see channelConfigurations.
+void setupChannels() {
+#if ADDITIONAL_CHANNELS
+	for(byte channel = 1; channel < channelCount; ++channel) {
+		const ChannelConfiguration &configuration
+			= channelConfigurations[channel];
+		byte pin = configuration.pin;
+		
+		setupInputPin(pin);
+		
+		if(!usesPinChangeInterrupt(pin)) {
+			enableExternalInterrupt(pin - 2,
+				interruptEdge(configuration.edge));
+			continue;
+		}
+		
+		byte port = portOfPin(pin);
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			byte bit = _BV(portBitOfPin(pin));
+			if(port == portB) {
+				pinChangeLastState[port] = PINB;
+				PCMSK0 |= bit;
+			} else if(port == portC) {
+				pinChangeLastState[port] = PINC;
+				PCMSK1 |= bit;
+			} else {
+				pinChangeLastState[port] = PIND;
+				PCMSK2 |= bit;
+			}
+			// Clear an old interrupt by writing a 1 to it.
+			PCIFR = _BV(PCIF0 + port);
+			PCICR |= _BV(PCIE0 + port);
+		}
+	}
+#endif
+}
+
+void loop()
+{ 
+	unsigned long now = millis();
+	
+	for(byte i = 0; i < taskCount; ++i) {
+		Task &task = tasks[i];
+		if(timeSince(task.lastRunMillis, now) < task.intervalMillis)
+			continue;
+		
+		// Advance by the interval instead of setting it to "now" so a
+		// task which ran a bit late doesn't delay all its following
+		// runs: A measurement every 60 seconds will stay at that even
+		// if some of them had to start a few milliseconds late.
+		task.lastRunMillis += task.intervalMillis;
+		// If the task fell behind by more than a whole interval there
+		// is no point in running it multiple times in a row to catch
+		// up so we start anew from now.
+		if(timeSince(task.lastRunMillis, now) >= task.intervalMillis) {
+			task.lastRunMillis = now;
+#if HEALTH_REPORT
+			// Not for the tasks which run at every pass anyway.
+			if(task.intervalMillis > 0)
+				++healthTasksLate;
+#endif
+		}
+		
+		task.run();
+	}
+	
+#if WATCHDOG
+	// All tasks have had their turn, so the program isn't stuck.
+	wdt_reset();
+#endif
+	
+#if LOW_POWER
+	// Everything the tasks wait for, i.e. pulses, time passing and
+	// Serial being ready to send, is signalled by an interrupt, so
+	// there is nothing to do until the next one.
+	sleepUntilInterrupt();
+#endif
+}
+
+// Copies the number of pulses counted since the previous call, and the
+// time of the last pulse, into the given snapshot, and resets the
+// counters to 0.
+// All channels are copied at once so their counts are of exactly the
+// same time.
+// Copying and resetting must not be interrupted by countPulse() because:
+// - Reading the 2 bytes of the unsigned int is not done in a single
+//   step on the Arduino Uno so we could read a half-updated value.
+// - A pulse which is counted between the copying and the resetting
+//   would be lost.
+// So interrupts are disabled while we do it. But ONLY for that: The
+// code in the ATOMIC_BLOCK is just a few machine instructions which
+// take well below 1 microsecond. Everything else, especially the
+// calculations and Serial output, must happen outside of it because
+// while interrupts are disabled millis() doesn't advance, Serial
+// cannot send and pulses which arrive in the meantime are delayed.
+// If you add code which accesses pulseCounters outside of the interrupts
+// please use this function or an ATOMIC_BLOCK as well and keep it
+// equally short.
+// See: https://www.nongnu.org/avr-libc/user-manual/group__util__atomic.html
+void takePulseSnapshot(PulseSnapshot &snapshot) {
+	// ATOMIC_RESTORESTATE re-enables interrupts afterwards only if they
+	// had been enabled before so this is also safe to use in places
+	// where interrupts are disabled, e.g. in other interrupts.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#if INSTRUMENTATION
+		CycleMeasurement measurement(criticalSectionCycles);
+#endif
+		for(byte channel = 0; channel < channelCount; ++channel) {
+			snapshot.counts[channel] = pulseCounters[channel].count;
+			pulseCounters[channel].count = 0;
+		}
+		snapshot.lastPulse = pulseCounters[0].lastPulse;
+		snapshot.now = currentPulseTicks();
+#if PULSE_TIMESTAMP_BUFFER_SIZE > 0
+		snapshot.timestampsLost = pulseTimestampsLost;
+		pulseTimestampsLost = 0;
+#else
+		snapshot.timestampsLost = 0;
+#endif
+#if PULSE_HISTOGRAM
+		snapshot.rejectedEdges = sensorRejectedEdges;
+		sensorRejectedEdges = 0;
+#endif
+	}
+}
+
+// Task which takes the times of the pulses out of the pulseTimestamps
+// buffer and analyzes them.
+// If you want to do further analysis of the individual pulses, e.g.
+// of their distribution, then this is the place to add it.
+void processPulseTimestamps() {
+#if PULSE_TIMESTAMP_BUFFER_SIZE > 0
+	byte read = pulseTimestampsRead;
+	
+	while(read != pulseTimestampsWritten) {
+		unsigned long time
+			= pulseTimestamps[read & (PULSE_TIMESTAMP_BUFFER_SIZE - 1)];
+		// Tell the interrupt that it may overwrite the entry only after
+		// we've finished reading it.
+		pulseTimestampsRead = ++read;
+		
+		// If times got lost because the buffer was full then this is
+		// the time since an older pulse, i.e. longer than the actual
+		// time between the pulses. That is harmless because we only
+		// want the shortest one.
+		if(lastProcessedPulseValid
+				&& timeSince(lastProcessedPulse, time) < shortestPulsePeriod)
+			shortestPulsePeriod = timeSince(lastProcessedPulse, time);
+#if PULSE_HISTOGRAM
+		if(lastProcessedPulseValid)
+			addToHistogram(timeSince(lastProcessedPulse, time));
+#endif
+		
+		lastProcessedPulse = time;
+		lastProcessedPulseValid = true;
+	}
+#endif
+}
+
+// Returns the number of samples after which takeSample() finishes the
+// measurement.
+inline unsigned int samplesPerReport() {
+#if REPORT_INTERVAL_SECONDS
+	return reportIntervalSamples;
+#else
+	return sensorSamplesPerMeasurement;
+#endif
+}
+
+// Task which takes the pulses out of the interrupt and adds them to the
+// current measurement and to the moving statistics. Finishes the
+// measurement if it has reached the sensorMeasurementSeconds, or the
+// REPORT_INTERVAL_SECONDS.
+void takeSample() {
+	unsigned long now = millis();
+	PulseSnapshot sample;
+	takePulseSnapshot(sample);
+	// Must be called regularly, see PULSE_INPUT_EXTERNAL_INTERRUPT.
+	unsigned long long uptime = uptimeTicks();
+	
+#if MOVING_STATISTICS
+	addStatisticsSample(sample.counts[0]);
+#endif
+#if PULSE_HISTOGRAM
+	histogramRejectedEdges += sample.rejectedEdges;
+#endif
+#if HEALTH_REPORT
+	healthTimestampsLost += sample.timestampsLost;
+#endif
+#if GUST_ALERT
+	// Before finishing the measurement so the alert comes before the
+	// report.
+	updateGustAlert(sample, now);
+#endif
+	
+	for(byte channel = 0; channel < channelCount; ++channel) {
+		PulseCount count = measurement.counts[channel] + sample.counts[channel];
+		// If the sum is too large for a PulseCount, it "wraps around" to
+		// the part which fits, which is smaller than what we added.
+		if(count < sample.counts[channel]) {
+			count = (PulseCount)~0UL;
+			measurement.countsOverflowed = true;
+		}
+		measurement.counts[channel] = count;
+	}
+	measurement.lastPulse = sample.lastPulse;
+	measurement.now = sample.now;
+	measurement.timestampsLost += sample.timestampsLost;
+	
+	bool finished = ++samplesInMeasurement >= samplesPerReport();
+#if TIME_SYNC
+	if(timeSynchronized)
+		finished = alignSample(now, uptime);
+#endif
+	if(!finished)
+		return;
+	
+	finishMeasurement(now, uptime);
+	
+	for(byte channel = 0; channel < channelCount; ++channel)
+		measurement.counts[channel] = 0;
+	measurement.timestampsLost = 0;
+	measurement.countsOverflowed = false;
+	samplesInMeasurement = 0;
+}
+
+// Ends the current measurement, whose samples are in the
+// "measurement" variable, and computes its results for printReport().
+// The next measurement starts immediately so no pulse gets lost in
+// between.
+// With REPORT_INTERVAL_SECONDS the measurement is an interval, which is
+// added to the window, and the results are of the window.
+// The now parameter is the time in milliseconds at which the last
+// sample was taken, the uptime the uptimeTicks() at that time.
+void finishMeasurement(unsigned long now, unsigned long long uptime) {
+	const PulseSnapshot &snapshot = measurement;
+	// The pulses of the Sensor.
+	const PulseCount count = snapshot.counts[0];
+	const unsigned long measurementMillis = timeSince(measurementStart, now);
+	
+	reportShortestPulsePeriod = shortestPulsePeriod;
+	shortestPulsePeriod = ULONG_MAX;
+	reportTimestampsLost = snapshot.timestampsLost;
+	reportEndMillis = now;
+	reportEndUptimeTicks = uptime;
+	++reportSequence;
+	measurementStart = now;
+#if LOW_POWER
+	// sleepMicros * 100000 / (measurementMillis * 1000)
+	unsigned long sleptMilliPercent
+		= multiplyDivide(sleepMicros, 100, measurementMillis);
+	// Sleeping cannot be longer than the measurement, but the times are
+	// measured differently, so it could be off by a few microseconds.
+	reportAwakeMilliPercent = sleptMilliPercent < 100000
+		? 100000 - sleptMilliPercent : 0;
+	sleepMicros = 0;
+#endif
+#if INSTRUMENTATION
+	takeInstrumentation();
+#endif
+	
+	PulseRate rate = measureRate(count, measurementMillis,
+		snapshot.lastPulse, snapshot.now, referencePulse, referencePulseValid);
+	if(count > 0) {
+		referencePulse = snapshot.lastPulse;
+		referencePulseValid = true;
+	} else if(timeSince(snapshot.lastPulse, snapshot.now)
+			> reciprocalModeMaxPeriodSeconds * pulseTicksPerSecond) {
+		referencePulseValid = false;
+	}
+	
+#if REPORT_INTERVAL_SECONDS
+	reportCurrentRate = rate;
+	addReportInterval(snapshot, measurementMillis);
+	
+	reportCountsOverflowed = snapshot.countsOverflowed;
+	for(byte channel = 0; channel < channelCount; ++channel) {
+		unsigned long windowCount = reportWindowCounts[channel];
+		if(windowCount > (PulseCount)~0UL) {
+			windowCount = (PulseCount)~0UL;
+			reportCountsOverflowed = true;
+		}
+		reportPulseCounts[channel] = windowCount;
+	}
+	reportMeasurementMillis = reportWindowMillis;
+	
+	// The same as for the interval, but since the last pulse before the
+	// window. Too old if there was no pulse for
+	// reciprocalModeMaxPeriodSeconds before the window started.
+	bool referenceValid = reportWindowReferenceValid
+		&& timeSince(reportWindowReference, snapshot.now)
+			<= (reportMeasurementMillis + reciprocalModeMaxPeriodSeconds * 1000)
+				* (unsigned long long)(pulseTicksPerSecond / 1000);
+	rate = measureRate(reportPulseCounts[0], reportMeasurementMillis,
+		snapshot.lastPulse, snapshot.now, reportWindowReference,
+		referenceValid);
+#else
+	for(byte channel = 0; channel < channelCount; ++channel)
+		reportPulseCounts[channel] = snapshot.counts[channel];
+	reportCountsOverflowed = snapshot.countsOverflowed;
+	reportMeasurementMillis = measurementMillis;
+#endif
+	reportRatePulses = rate.pulses;
+	reportRateTicks = rate.ticks;
+	reportReciprocal = rate.reciprocal;
+	
+#if TIME_SYNC
+	// The start by the current synchronization as well, which is more
+	// precise if there was a "time" during the measurement.
+	if(timeSynchronized) {
+#if REPORT_INTERVAL_SECONDS
+		reportStartUnixMillis = hostMillis(uptime - reportMeasurementMillis
+			* (unsigned long long)(pulseTicksPerSecond / 1000));
+#else
+		reportStartUnixMillis = hostMillis(measurementStartUptime);
+#endif
+		reportEndUnixMillis = hostMillis(uptime);
+	}
+	measurementStartUptime = uptime;
+#endif
+	
+	reportPending = true;
+}
+
+// Returns the pulse rate of count pulses of the Sensor in a measurement
+// of the given length, with either counting or reciprocal frequency
+// measurement. lastPulse is the time of the last one, now the end of
+// the measurement and reference the last pulse before the measurement,
+// all in ticks. referenceValid is false if there is none or it is too
+// old, see referencePulseValid.
+PulseRate measureRate(PulseCount count, unsigned long millis,
+		unsigned long lastPulse, unsigned long now, unsigned long reference,
+		bool referenceValid) {
+	PulseRate rate;
+	// Time since the last pulse when the measurement ended, and since
+	// the last pulse before the measurement, in ticks.
+	unsigned long timeSinceLastPulse = timeSince(lastPulse, now);
+	unsigned long period = timeSince(reference, lastPulse);
+	
+	if(count == 0 || count > reciprocalModeMaxPulses || !referenceValid) {
+		// Counting: If there were many pulses because that is accurate
+		// enough then, or if there is no previous pulse to measure
+		// the time since. Also if there was no pulse at all because
+		// then the time between pulses is unknown.
+		rate.pulses = count;
+		rate.ticks = millis * (pulseTicksPerSecond / 1000);
+		rate.reciprocal = false;
+	} else {
+		// Reciprocal: The "period" contains exactly count
+		// pulses, so the average time between them is
+		// period / count.
+		rate.pulses = count;
+		rate.ticks = period;
+		rate.reciprocal = true;
+	}
+	
+	if(reciprocalModeMaxPulses > 0 && referenceValid
+			&& (rate.reciprocal || count == 0)) {
+		// If the time since the last pulse is longer than the time
+		// between the pulses then the wind has become slower since
+		// then: The next pulse cannot have happened sooner than that
+		// so the frequency is at most 1 / time since the last pulse.
+		// Without this a sensor which stopped rotating would report the
+		// speed of its last rotation until it rotates again.
+		// 1 / timeSinceLastPulse < pulses / ticks
+		// <=> ticks < pulses * timeSinceLastPulse
+		if(rate.ticks < (unsigned long long)rate.pulses * timeSinceLastPulse
+				|| count == 0) {
+			rate.pulses = 1;
+			rate.ticks = timeSinceLastPulse;
+			rate.reciprocal = true;
+		}
+	}
+	
+	// The sensor is standing still, see reciprocalModeMaxPeriodSeconds.
+	if(count == 0 && timeSinceLastPulse
+			> reciprocalModeMaxPeriodSeconds * pulseTicksPerSecond) {
+		rate.pulses = 0;
+		rate.reciprocal = false;
+	}
+	return rate;
+}
+
+#if REPORT_INTERVAL_SECONDS
+// Returns the number of intervals in the window, see
+// REPORT_INTERVAL_SECONDS.
+inline byte reportWindowIntervals() {
+	return sensorMeasurementSeconds / REPORT_INTERVAL_SECONDS;
+}
+
+// Adds the interval of the given length to the window, in place of the
+// oldest one once the window is full. Called by finishMeasurement().
+// As with the moving statistics the sums are updated instead of being
+// added up again, so this takes the same time for any length of the
+// window.
+void addReportInterval(const PulseSnapshot &interval, unsigned long millis) {
+	byte position = reportIntervalPosition;
+	ReportInterval &entry = reportIntervals[position];
+	
+	if(reportIntervalsFilled == reportWindowIntervals()) {
+		for(byte channel = 0; channel < channelCount; ++channel)
+			reportWindowCounts[channel] -= entry.counts[channel];
+		reportWindowMillis -= entry.millis;
+		// Its last pulse is the one before the window now. If it had no
+		// pulses that is the same as before.
+		if(entry.counts[0] > 0)
+			reportWindowReferenceValid = true;
+		reportWindowReference = entry.lastPulse;
+	} else
+		++reportIntervalsFilled;
+	
+	for(byte channel = 0; channel < channelCount; ++channel) {
+		entry.counts[channel] = interval.counts[channel];
+		reportWindowCounts[channel] += interval.counts[channel];
+	}
+	entry.lastPulse = interval.lastPulse;
+	// Only longer than REPORT_INTERVAL_SECONDS if loop() was very late.
+	entry.millis = millis < UINT_MAX ? millis : UINT_MAX;
+	reportWindowMillis += entry.millis;
+	
+	reportIntervalPosition
+		= position + 1 < reportWindowIntervals() ? position + 1 : 0;
+}
+
+// Empties the window, e.g. when its length has been changed by
+// SERIAL_COMMANDS.
+void resetReportWindow() {
+	reportIntervalPosition = 0;
+	reportIntervalsFilled = 0;
+	for(byte channel = 0; channel < channelCount; ++channel)
+		reportWindowCounts[channel] = 0;
+	reportWindowMillis = 0;
+	reportWindowReferenceValid = false;
+}
+#endif
+
+// Returns true if the window of the last report doesn't overlap the one
+// of the report which was sensorMeasurementSeconds before, i.e. it is
+// one of the same measurements as without REPORT_INTERVAL_SECONDS, so
+// there is one every sensorMeasurementSeconds.
+inline bool reportIsWholeMeasurement() {
+#if REPORT_INTERVAL_SECONDS
+	return reportIntervalPosition == 0
+		&& reportIntervalsFilled == reportWindowIntervals();
+#else
+	return true;
+#endif
+}
+
+// Returns the pulse rate of the last finished measurement in milli
+// pulses per the given number of seconds.
+unsigned long milliPulsesPer(unsigned long seconds) {
+	return (unsigned long long)reportRatePulses
+		* pulseTicksPerSecond * 1000 * seconds / reportRateTicks;
+}
+
+// Returns the pulse rate during the last interval in milli pulses per
+// second, see REPORT_INTERVAL_SECONDS. Without it that is the whole
+// measurement.
+unsigned long currentMilliPulsesPerSecond() {
+#if REPORT_INTERVAL_SECONDS
+	return (unsigned long long)reportCurrentRate.pulses
+		* pulseTicksPerSecond * 1000 / reportCurrentRate.ticks;
+#else
+	return milliPulsesPer(1);
+#endif
+}
+
+// Returns the pulse rate of the given channel in the last finished
+// measurement in milli pulses per second, by counting.
+unsigned long channelMilliPulsesPerSecond(byte channel) {
+	return multiplyDivide(reportPulseCounts[channel], 1000UL * 1000,
+		reportMeasurementMillis);
+}
+
+// Task which prints the result of the last measurement.
+void printReport() {
+	if(!reportPending)
+		return;
+	
+	reportPending = false;
+	
+	// With OUTPUT_FORMAT_MODBUS the master reads the results instead,
+	// see readModbusInputValues().
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	output.beginReport();
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	printTextReport();
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	sendBinaryReport();
+#endif
+	if(output.endReport())
+		output.droppedReports = 0;
+#if HEALTH_REPORT
+	else
+		++healthReportsDropped;
+#endif
+#endif
+	
+#if I2C_ADDRESS
+	i2cSnapshotPending = true;
+#endif
+#if EEPROM_LOG
+	// Otherwise the EEPROM would wear out much sooner, and the log would
+	// contain the same pulses several times.
+	if(reportIsWholeMeasurement())
+		logReport();
+#endif
+}
+
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+// Task which sends the output queue to the PC.
+void sendOutput() {
+	output.send();
+}
+#endif
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+
+// Prints the result of the last measurement as text.
+void printTextReport() {
+	unsigned long milliPulsesPerSecond = milliPulsesPer(1);
+	unsigned long milliPulsesPerMinute = milliPulsesPer(60);
+	
+	output.print("Pulses measured: "); 
+	output.println(reportPulseCounts[0]);
+	output.print("Pulses per second: "); 
+	printMilli(milliPulsesPerSecond);
+	output.print("Pulses per minute: ");
+	// Same number of decimals as with seconds: We're using the same
+	// input value to calculate this as with the seconds so the
+	// precision has not changed as the input has not changed.
+	printMilli(milliPulsesPerMinute);
+	output.print("Wind speed in m/s: ");
+	printMilli(windMillimetersPerSecond(milliPulsesPerSecond));
+	output.print("Measured by: ");
+	output.println(reportReciprocal
+		? "Time between pulses" : "Counting pulses");
+#if REPORT_INTERVAL_SECONDS
+	unsigned long current = currentMilliPulsesPerSecond();
+	output.print("Current pulses per second: ");
+	printMilli(current);
+	output.print("Current wind speed in m/s: ");
+	printMilli(windMillimetersPerSecond(current));
+#endif
+	
+#if ADDITIONAL_CHANNELS
+	printChannels();
+#endif
+	
+#if PULSE_TIMESTAMP_BUFFER_SIZE > 0
+	if(reportShortestPulsePeriod != ULONG_MAX) {
+		// The pulses per second if all pulses had come as fast as
+		// the two which were closest to each other.
+		output.print("Max. pulses per second between two pulses: ");
+		printMilli(pulseTicksPerSecond * 1000
+			/ reportShortestPulsePeriod);
+	}
+	
+	if(reportTimestampsLost > 0) {
+		output.print("WARNING: Times of pulses lost: ");
+		output.println(reportTimestampsLost);
+	}
+#endif
+	
+	if(reportCountsOverflowed) {
+		output.println(
+			"ERROR: Pulse counter overflowed, set PULSE_COUNTER_BITS to 32!");
+	}
+	
+	if(output.droppedReports > 0) {
+		output.print("WARNING: Reports lost because sending was too slow: ");
+		output.println(output.droppedReports);
+	}
+	
+	// The wind sensor is producing more impulses than we could
+	// measure at most with the given debounce delay.
+	if(milliPulsesPerSecond >= sensorMaxMilliPulsesPerSecond) {
+		output.println(
+			"ERROR: Debounce delay too high for impulse speed!");
+	}
+	
+#if MOVING_STATISTICS
+	printStatistics();
+#endif
+
+#if INSTRUMENTATION
+	printInstrumentation();
+#endif
+	
+#if LOW_POWER
+	output.print("Awake in percent: ");
+	printMilli(reportAwakeMilliPercent);
+#endif
+	
+#if TIME_SYNC
+	if(reportEndUnixMillis != 0) {
+		// Seconds since 1970 with 3 decimals, which e.g.
+		// "date -d @1760000000.123" converts to the date.
+		output.print("Start time: ");
+		printThousandths(reportStartUnixMillis);
+		output.print("End time: ");
+		printThousandths(reportEndUnixMillis);
+	}
+#endif
+	
+	output.print("Uptime in seconds: ");
+	output.println(
+		(unsigned long)(reportEndUptimeTicks / pulseTicksPerSecond));
+	
+	output.println("-----------------------------------------------");
+}
+
+#if ADDITIONAL_CHANNELS
+// Prints the pulses of the channels besides the Sensor as part of
+// printTextReport().
+void printChannels() {
+	for(byte channel = 1; channel < channelCount; ++channel) {
+		output.print("Channel ");
+		output.print(channel);
+		output.print(" (pin ");
+		output.print(channelConfigurations[channel].pin);
+		output.print(") pulses measured: ");
+		output.println(reportPulseCounts[channel]);
+		output.print("Channel ");
+		output.print(channel);
+		output.print(" pulses per second: ");
+		printMilli(channelMilliPulsesPerSecond(channel));
+	}
+}
+#endif
+
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+
+// Types of frames, see sendFrame().
+const byte frameTypeReport = 1;
+// Sent directly after each frameTypeReport if there are channels
+// besides the Sensor, see BinaryChannelsReport.
+const byte frameTypeChannels = 2;
+// Sent directly after each frameTypeReport, and frameTypeChannels, if
+// LOW_POWER is enabled, see BinaryPowerReport.
+const byte frameTypePower = 3;
+// Edges of the Sensor if PULSE_TRACE is enabled, see TraceFrame.
+const byte frameTypeTrace = 4;
+// Sent directly after each frameTypeReport, and the above, if TIME_SYNC
+// is enabled and the time has been synchronized, see BinaryTimeReport.
+const byte frameTypeTime = 9;
+// Sent directly after each frameTypeReport, and the above, if
+// INSTRUMENTATION is enabled, see BinaryInstrumentation.
+const byte frameTypeInstrumentation = 13;
+
+// The content of a frame of frameTypeReport.
+// Multi-byte numbers are sent as "little endian", i.e. lowest byte
+// first, which is how the Arduino stores them. "packed" tells the
+// compiler not to insert empty bytes between the values, which it
+// wouldn't do on the Arduino Uno anyway, so a PC can read the frame at
+// the same positions when compiling this struct. For the same reason
+// the types with explicit sizes are used: uint16_t is an unsigned int
+// on the Arduino Uno, uint32_t an unsigned long - but on a PC those
+// can be larger.
+struct __attribute__((packed)) BinaryReport {
+	// See reportSequence.
+	uint16_t sequence;
+	// millis() at the end of the measurement.
+	uint32_t endMillis;
+	// Microseconds since startup at the end of the measurement, see
+	// reportEndUptimeTicks. Never overflows, unlike endMillis.
+	uint64_t endUptimeMicros;
+	// Length of the measurement in milliseconds.
+	uint32_t measurementMillis;
+	// Number of pulses during the measurement. 32 bits for all
+	// PULSE_COUNTER_BITS so the format is always the same.
+	uint32_t pulseCount;
+	// Milli pulses per second as with the text output.
+	uint32_t milliPulsesPerSecond;
+	// Milli pulses per second between the two closest pulses, 0 if
+	// unknown.
+	uint32_t peakMilliPulsesPerSecond;
+	// Moving statistics, all 0 if MOVING_STATISTICS is disabled or if
+	// the first block has not been finished yet.
+	uint32_t meanMilliPulsesPerSecond;
+	uint32_t stddevMilliPulsesPerSecond;
+	uint32_t gustMilliPulsesPerSecond;
+	// Combination of the binaryReportFlag... values.
+	uint8_t flags;
+	// Wind speeds in millimeters per second of milliPulsesPerSecond,
+	// meanMilliPulsesPerSecond and gustMilliPulsesPerSecond, see
+	// windMillimetersPerSecond(). After the flags so programs which
+	// were written before they existed can still read the frame.
+	uint32_t windMillimetersPerSecond;
+	uint32_t meanWindMillimetersPerSecond;
+	uint32_t gustWindMillimetersPerSecond;
+	// Milli pulses per second of the last REPORT_INTERVAL_SECONDS, the
+	// same as milliPulsesPerSecond without it.
+	uint32_t currentMilliPulsesPerSecond;
+};
+
+static_assert(sizeof(BinaryReport) == 59, "BinaryReport has the wrong size");
+
+// milliPulsesPerSecond was measured by the time between pulses.
+const byte binaryReportFlagReciprocal = 1;
+// See "Debounce delay too high" of printTextReport().
+const byte binaryReportFlagDebounceTooHigh = 2;
+// See "Times of pulses lost" of printTextReport().
+const byte binaryReportFlagTimestampsLost = 4;
+// Previous reports were dropped because sending was too slow, see
+// OUTPUT_QUEUE_SIZE. The sequence numbers of the missing reports are
+// skipped.
+const byte binaryReportFlagReportsDropped = 8;
+// See "Pulse counter overflowed" of printTextReport().
+const byte binaryReportFlagCountsOverflowed = 16;
+
+#if ADDITIONAL_CHANNELS
+// The result of a channel in a frame of frameTypeChannels.
+struct __attribute__((packed)) BinaryChannelReport {
+	// Number of pulses during the measurement, see BinaryReport.
+	uint32_t pulseCount;
+	// Milli pulses per second by counting.
+	uint32_t milliPulsesPerSecond;
+};
+
+// The content of a frame of frameTypeChannels.
+struct __attribute__((packed)) BinaryChannelsReport {
+	// The sequence of the BinaryReport this belongs to.
+	uint16_t sequence;
+	// All channels in the order of channelConfigurations, starting with
+	// the Sensor. Its milliPulsesPerSecond are by counting as well.
+	BinaryChannelReport channels[channelCount];
+};
+
+static_assert(sizeof(BinaryChannelsReport) <= 255,
+	"Too many channels for a frame");
+#endif
+
+#if LOW_POWER
+// The content of a frame of frameTypePower.
+struct __attribute__((packed)) BinaryPowerReport {
+	// The sequence of the BinaryReport this belongs to.
+	uint16_t sequence;
+	// See reportAwakeMilliPercent.
+	uint32_t awakeMilliPercent;
+};
+#endif
+
+#if TIME_SYNC
+// The content of a frame of frameTypeTime.
+struct __attribute__((packed)) BinaryTimeReport {
+	// The sequence of the BinaryReport this belongs to.
+	uint16_t sequence;
+	// See reportStartUnixMillis.
+	uint64_t startUnixMillis;
+	uint64_t endUnixMillis;
+	// See clockCorrectionPpb.
+	int32_t clockCorrectionPpb;
+};
+#endif
+
+#if INSTRUMENTATION
+// A measured duration in a frame of frameTypeInstrumentation, see
+// CycleResult.
+struct __attribute__((packed)) BinaryCycles {
+	uint32_t minCycles;
+	uint32_t averageCycles;
+	uint32_t maxCycles;
+	uint32_t count;
+};
+
+// The content of a frame of frameTypeInstrumentation.
+struct __attribute__((packed)) BinaryInstrumentation {
+	// The sequence of the BinaryReport this belongs to.
+	uint16_t sequence;
+	// See reportIsrCycles etc.
+	BinaryCycles isr;
+	BinaryCycles isrLatency;
+	BinaryCycles criticalSection;
+};
+
+static_assert(sizeof(BinaryInstrumentation) == 50,
+	"BinaryInstrumentation has the wrong size");
+
+// Copies the result into the frame.
+void setBinaryCycles(BinaryCycles &cycles, const CycleResult &result) {
+	cycles.minCycles = result.min;
+	cycles.averageCycles = result.average;
+	cycles.maxCycles = result.max;
+	cycles.count = result.count;
+}
+#endif
+
+// Sends the result of the last measurement as a binary frame.
+void sendBinaryReport() {
+	BinaryReport report;
+	
+	report.sequence = reportSequence;
+	report.endMillis = reportEndMillis;
+	report.endUptimeMicros
+		= reportEndUptimeTicks / (pulseTicksPerSecond / 1000000);
+	report.measurementMillis = reportMeasurementMillis;
+	report.pulseCount = reportPulseCounts[0];
+	report.milliPulsesPerSecond = milliPulsesPer(1);
+	report.peakMilliPulsesPerSecond
+		= reportShortestPulsePeriod == ULONG_MAX ? 0
+		: pulseTicksPerSecond * 1000 / reportShortestPulsePeriod;
+	
+	StatisticsResult statistics = { 0, 0, 0, 0 };
+#if MOVING_STATISTICS
+	computeStatistics(statistics);
+#endif
+	report.meanMilliPulsesPerSecond = statistics.mean;
+	report.stddevMilliPulsesPerSecond = statistics.stddev;
+	report.gustMilliPulsesPerSecond = statistics.gust;
+	
+	report.flags = 0;
+	if(reportReciprocal)
+		report.flags |= binaryReportFlagReciprocal;
+	if(report.milliPulsesPerSecond >= sensorMaxMilliPulsesPerSecond)
+		report.flags |= binaryReportFlagDebounceTooHigh;
+	if(reportTimestampsLost > 0)
+		report.flags |= binaryReportFlagTimestampsLost;
+	if(output.droppedReports > 0)
+		report.flags |= binaryReportFlagReportsDropped;
+	if(reportCountsOverflowed)
+		report.flags |= binaryReportFlagCountsOverflowed;
+	
+	report.windMillimetersPerSecond
+		= windMillimetersPerSecond(report.milliPulsesPerSecond);
+	report.meanWindMillimetersPerSecond
+		= windMillimetersPerSecond(statistics.mean);
+	report.gustWindMillimetersPerSecond
+		= windMillimetersPerSecond(statistics.gust);
+	report.currentMilliPulsesPerSecond = currentMilliPulsesPerSecond();
+	
+	sendFrame(frameTypeReport, &report, sizeof(report));
+	
+#if ADDITIONAL_CHANNELS
+	BinaryChannelsReport channels;
+	channels.sequence = reportSequence;
+	for(byte channel = 0; channel < channelCount; ++channel) {
+		channels.channels[channel].pulseCount = reportPulseCounts[channel];
+		channels.channels[channel].milliPulsesPerSecond
+			= channelMilliPulsesPerSecond(channel);
+	}
+	sendFrame(frameTypeChannels, &channels, sizeof(channels));
+#endif
+	
+#if LOW_POWER
+	BinaryPowerReport power;
+	power.sequence = reportSequence;
+	power.awakeMilliPercent = reportAwakeMilliPercent;
+	sendFrame(frameTypePower, &power, sizeof(power));
+#endif
+	
+#if TIME_SYNC
+	if(reportEndUnixMillis != 0) {
+		BinaryTimeReport time;
+		time.sequence = reportSequence;
+		time.startUnixMillis = reportStartUnixMillis;
+		time.endUnixMillis = reportEndUnixMillis;
+		time.clockCorrectionPpb = clockCorrectionPpb;
+		sendFrame(frameTypeTime, &time, sizeof(time));
+	}
+#endif
+	
+#if INSTRUMENTATION
+	BinaryInstrumentation instrumentation;
+	instrumentation.sequence = reportSequence;
+	setBinaryCycles(instrumentation.isr, reportIsrCycles);
+	setBinaryCycles(instrumentation.isrLatency, reportIsrLatencyCycles);
+	setBinaryCycles(instrumentation.criticalSection,
+		reportCriticalSectionCycles);
+	sendFrame(frameTypeInstrumentation, &instrumentation,
+		sizeof(instrumentation));
+#endif
+}
+
+// Sends a binary frame, which consists of:
+// - 2 bytes 0xA5 0x5A to mark the start of a frame. The PC can search
+//   for them to find the next frame if it started reading in the
+//   middle of one.
+// - 1 byte type, which tells what the data is, e.g. frameTypeReport.
+// - 1 byte length of the data.
+// - The data.
+// - 2 bytes checksum of the type, length and data, lowest byte first:
+//   The "CRC-16/MODBUS", i.e. initial value 0xFFFF and polynomial
+//   0xA001. This allows the PC to check whether the frame arrived
+//   without transmission errors.
+void sendFrame(byte type, const void *data, byte length) {
+	const byte *bytes = (const byte *)data;
+	unsigned int crc = 0xFFFF;
+	
+	crc = _crc16_update(crc, type);
+	crc = _crc16_update(crc, length);
+	for(byte i = 0; i < length; ++i)
+		crc = _crc16_update(crc, bytes[i]);
+	
+	output.write(0xA5);
+	output.write(0x5A);
+	output.write(type);
+	output.write(length);
+	output.write(bytes, length);
+	output.write(crc & 0xFF);
+	output.write(crc >> 8);
+}
+
+// Number of bytes which sendFrame() sends additionally to the data.
+const byte frameOverheadBytes = 6;
+
+#if PULSE_TRACE
+
+// The times of the edges in a TraceFrame are in units of 2 ^ this many
+// ticks, which is the resolution of the times: With
+// PULSE_INPUT_EXTERNAL_INTERRUPT micros() is always a multiple of 4.
+// With PULSE_INPUT_TIMER1_CAPTURE a resolution of 1 microsecond is
+// enough because the noise canceler and the wind sensor are not that
+// precise anyway.
+const byte traceTickShift
+	= PULSE_INPUT == PULSE_INPUT_EXTERNAL_INTERRUPT ? 2 : 1;
+// A frame is sent at the latest after this many milliseconds, so the PC
+// gets the edges quickly also if there are only a few.
+const unsigned long traceFrameMaxMillis = 500;
+// Largest number of bytes of a number in a TraceFrame: 7 bits per byte
+// for 32 bits.
+const byte traceNumberMaxBytes = 5;
+
+// The content of a frame of frameTypeTrace. Only the first
+// traceFrameLength bytes of "edges" are sent.
+struct __attribute__((packed)) TraceFrame {
+	// Nanoseconds per tick, see pulseTicksPerSecond.
+	uint16_t tickNanoseconds;
+	// See traceTickShift.
+	uint8_t tickShift;
+	// Number of edges which got lost since the previous TraceFrame
+	// because the traceEdges buffer was full, at most 255.
+	uint8_t edgesLost;
+	// The edges, each as a number of 1 to traceNumberMaxBytes bytes,
+	// see writeTraceNumber(). Their lowest bit is 1 if the pin was at
+	// the level of the edge of the Sensor, see isActiveLevel(). The
+	// other bits are:
+	// - For the first edge: Its time in units of traceTickShift, i.e.
+	//   ticks / 2 ^ traceTickShift (ignoring overflows of the ticks).
+	// - For the others: The time since the previous edge in these
+	//   units.
+	byte edges[32];
+};
+
+static_assert(frameOverheadBytes + sizeof(TraceFrame)
+		<= OUTPUT_QUEUE_SIZE / 2,
+	"OUTPUT_QUEUE_SIZE is too small for PULSE_TRACE");
+
+// The frame which sendTrace() is filling.
+TraceFrame traceFrame;
+byte traceFrameLength = 0;
+// millis() when the first edge was added to traceFrame.
+unsigned long traceFrameStartMillis = 0;
+// The traceEdges entry of the previous edge in traceFrame.
+unsigned long traceLastEdge = 0;
+
+// Appends a number to traceFrame as a "varint": 7 bits per byte, lowest
+// bits first. The highest bit of a byte is set if another one follows.
+// So small numbers need fewer bytes.
+void writeTraceNumber(unsigned long number) {
+	while(number >= 0x80) {
+		traceFrame.edges[traceFrameLength++] = (number & 0x7F) | 0x80;
+		number >>= 7;
+	}
+	traceFrame.edges[traceFrameLength++] = number;
+}
+
+// Sends traceFrame. Returns false if it doesn't fit into the output
+// queue: Half of it is kept free for the reports so tracing never
+// causes them to get lost.
+bool sendTraceFrame() {
+	byte length = sizeof(TraceFrame) - sizeof(traceFrame.edges)
+		+ traceFrameLength;
+	unsigned int needed = frameOverheadBytes + length + OUTPUT_QUEUE_SIZE / 2;
+	if(output.freeSpace() < needed)
+		return false;
+	
+	traceFrame.tickNanoseconds = 1000000000 / pulseTicksPerSecond;
+	traceFrame.tickShift = traceTickShift;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		traceFrame.edgesLost = traceEdgesLost;
+		traceEdgesLost = 0;
+	}
+	sendFrame(frameTypeTrace, &traceFrame, length);
+	traceFrameLength = 0;
+	return true;
+}
+
+// Task which takes the edges out of the traceEdges buffer and sends
+// them, see PULSE_TRACE.
+// If the output queue is full the edges stay in the buffer, and if
+// that becomes full as well then further edges get lost, which the next
+// frame tells by its edgesLost.
+void sendTrace() {
+	unsigned long now = millis();
+	
+	if(traceFrameLength > sizeof(traceFrame.edges) - traceNumberMaxBytes
+			|| (traceFrameLength > 0
+				&& timeSince(traceFrameStartMillis, now) >= traceFrameMaxMillis)) {
+		if(!sendTraceFrame())
+			return;
+	}
+	
+	byte read = traceEdgesRead;
+	
+	while(read != traceEdgesWritten
+			&& traceFrameLength
+				<= sizeof(traceFrame.edges) - traceNumberMaxBytes) {
+		unsigned long edge = traceEdges[read & (PULSE_TRACE_BUFFER_SIZE - 1)];
+		// See processPulseTimestamps().
+		traceEdgesRead = ++read;
+		
+		const unsigned long active = edge & 1;
+		const unsigned long ticks = edge & ~1UL;
+		if(traceFrameLength == 0) {
+			traceFrameStartMillis = now;
+			writeTraceNumber(((ticks >> traceTickShift) << 1) | active);
+		} else {
+			writeTraceNumber(
+				((timeSince(traceLastEdge & ~1UL, ticks) >> traceTickShift) << 1)
+				| active);
+		}
+		traceLastEdge = edge;
+	}
+}
+
+#endif
+
+#endif
+
+#if EEPROM_LOG
+
+// A measurement as stored in the EEPROM by logReport(). "packed" for
+// the same reason as with BinaryReport, as it is sent by sendLog() in
+// the same way.
+struct __attribute__((packed)) LogRecord {
+	// See reportSequence.
+	uint16_t sequence;
+	// Seconds since startup at the end of the measurement. Starts at 0
+	// again when the Arduino restarts, unlike the sequence.
+	uint32_t endUptimeSeconds;
+	// Number of pulses of the Sensor, up to 65535 to save space.
+	uint16_t pulseCount;
+	// Milli pulses per second as with the reports.
+	uint32_t milliPulsesPerSecond;
+	// See StatisticsResult. 0 if MOVING_STATISTICS is disabled or if the
+	// first block has not been finished yet.
+	uint32_t gustMilliPulsesPerSecond;
+	// CRC-8 of the other bytes, see logRecordCheck(). Tells whether the
+	// slot contains a record at all - the EEPROM of a new Arduino
+	// contains only 0xFF - and whether the power went off while it was
+	// being written.
+	uint8_t check;
+};
+
+// The first bytes of the EEPROM are left free for other uses.
+const unsigned int logEepromStart = 64;
+// Number of LogRecords in the ring in the EEPROM. E2END is the address
+// of the last byte of the EEPROM.
+const byte logRecordCount = (E2END + 1 - logEepromStart) / sizeof(LogRecord);
+
+static_assert(logRecordCount >= 2, "The EEPROM is too small for EEPROM_LOG");
+
+// Slot of the ring to which the next record will be written. It
+// contains the oldest record.
+byte logNextSlot = 0;
+// The record which writeLog() is writing to logNextSlot, and how many
+// of its bytes it has written already.
+LogRecord logRecord;
+byte logRecordWritten = sizeof(LogRecord);
+
+// Only used while sendLog() is sending the records which the PC asked
+// for with "dump": Slot of the next record to send, number of slots
+// which are left, the lowest sequence to send, and number of records
+// which have been sent.
+byte logDumpSlot = 0;
+byte logDumpSlotsLeft = 0;
+uint16_t logDumpFromSequence = 0;
+byte logDumpRecordsSent = 0;
+bool logDumping = false;
+
+// Returns the check of a LogRecord.
+byte logRecordCheck(const LogRecord &record) {
+	return eepromCheck(&record, sizeof(LogRecord) - 1);
+}
+
+// Address of a slot of the ring in the EEPROM.
+byte *logSlotAddress(byte slot) {
+	return (byte *)(logEepromStart + (unsigned int)slot * sizeof(LogRecord));
+}
+
+// Reads the record of the given slot. Returns false if the slot doesn't
+// contain a valid record.
+bool readLogRecord(byte slot, LogRecord &record) {
+	eeprom_read_block(&record, logSlotAddress(slot), sizeof(LogRecord));
+	return record.check == logRecordCheck(record);
+}
+
+// Returns true if sequence a is b or comes after it, taking into
+// account that the sequence wraps around to 0.
+bool sequenceNotBefore(uint16_t a, uint16_t b) {
+	return (uint16_t)(a - b) < 0x8000;
+}
+
+// Finds the newest record in the ring, which tells where to continue
+// writing and at which reportSequence to continue.
+// Called by setup().
+void setupLog() {
+	bool found = false;
+	uint16_t newest = 0;
+	for(byte slot = 0; slot < logRecordCount; ++slot) {
+		LogRecord record;
+		if(!readLogRecord(slot, record))
+			continue;
+		if(!found || sequenceNotBefore(record.sequence, newest)) {
+			found = true;
+			newest = record.sequence;
+			logNextSlot = slot + 1 < logRecordCount ? slot + 1 : 0;
+		}
+	}
+	
+	if(found)
+		reportSequence = newest;
+}
+
+// Stores the result of the last measurement in the ring.
+// Called by printReport().
+// Writing a byte of the EEPROM takes 3.3 milliseconds, during which the
+// Arduino would have to wait before writing the next one. So this only
+// puts the record into logRecord, and writeLog() writes one byte of it
+// whenever the EEPROM is ready, without waiting. That takes ~ 60
+// milliseconds per record, much less than a measurement, so the
+// previous record has always been written when the next one comes.
+void logReport() {
+	if(logRecordWritten < sizeof(LogRecord))
+		return;
+	
+	logRecord.sequence = reportSequence;
+	logRecord.endUptimeSeconds = reportEndUptimeTicks / pulseTicksPerSecond;
+	logRecord.pulseCount
+		= reportPulseCounts[0] < 65535 ? reportPulseCounts[0] : 65535;
+	logRecord.milliPulsesPerSecond = milliPulsesPer(1);
+	StatisticsResult statistics = { 0, 0, 0, 0 };
+#if MOVING_STATISTICS
+	computeStatistics(statistics);
+#endif
+	logRecord.gustMilliPulsesPerSecond = statistics.gust;
+	logRecord.check = logRecordCheck(logRecord);
+	logRecordWritten = 0;
+}
+
+// Task which writes the next byte of logRecord to the EEPROM, see
+// logReport().
+// eeprom_update_byte() only writes if the byte in the EEPROM differs,
+// which is often the case for the upper bytes of the numbers, so it
+// saves wear and time.
+void writeLog() {
+	if(logRecordWritten == sizeof(LogRecord) || !eeprom_is_ready())
+		return;
+	
+	eeprom_update_byte(logSlotAddress(logNextSlot) + logRecordWritten,
+		((const byte *)&logRecord)[logRecordWritten]);
+	
+	if(++logRecordWritten == sizeof(LogRecord)) {
+		if(++logNextSlot == logRecordCount)
+			logNextSlot = 0;
+	}
+}
+
+// Starts sending the records from the given sequence on, or all of
+// them, see sendLog(). Called by runCommand() for "dump".
+void startLogDump(bool all, uint16_t fromSequence) {
+	// Starting at the oldest record, i.e. at the one which gets
+	// overwritten next, so the ones which are written while sending are
+	// not overwritten before they are sent.
+	logDumping = true;
+	logDumpSlot = logNextSlot;
+	logDumpSlotsLeft = logRecordCount;
+	logDumpRecordsSent = 0;
+	// With "dump" the oldest record which is still in the ring is sent
+	// first: Any sequence is not before the one which is half of the
+	// range before the newest.
+	logDumpFromSequence
+		= all ? (uint16_t)(reportSequence - 0x7FFF) : fromSequence;
+}
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+// Longest line which sendLog() prints.
+const byte logLineMaxBytes = 60;
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+// Types of frames, see sendFrame() and the others such as
+// frameTypeReport: A LogRecord without its check as the frame has a
+// CRC anyway, and the end of the records sent for "dump", which is a
+// BinaryLogEnd.
+const byte frameTypeLog = 5;
+const byte frameTypeLogEnd = 6;
+
+struct __attribute__((packed)) BinaryLogEnd {
+	// Number of frameTypeLog frames sent for the "dump".
+	uint16_t records;
+};
+#endif
+
+// Task which sends the records which the PC asked for with "dump", as
+// many as fit into the output queue - keeping half of it free for the
+// reports, as with sendTraceFrame(). The text output is a line of the
+// values of the LogRecord, separated by commas, e.g.
+//     Log: 12,720,300,5000,6333
+// for each record, which is easy for a program to read. Followed by
+// "Log dump finished, records: " and the number of records.
+void sendLog() {
+	while(logDumping) {
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+		unsigned int needed = logLineMaxBytes + OUTPUT_QUEUE_SIZE / 2;
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+		unsigned int needed = frameOverheadBytes + sizeof(LogRecord)
+			+ OUTPUT_QUEUE_SIZE / 2;
+#endif
+		if(output.freeSpace() < needed)
+			return;
+		
+		if(logDumpSlotsLeft == 0) {
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+			output.print("Log dump finished, records: ");
+			output.println(logDumpRecordsSent);
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+			BinaryLogEnd end;
+			end.records = logDumpRecordsSent;
+			sendFrame(frameTypeLogEnd, &end, sizeof(end));
+#endif
+			logDumping = false;
+			return;
+		}
+		
+		LogRecord record;
+		bool valid = readLogRecord(logDumpSlot, record);
+		if(++logDumpSlot == logRecordCount)
+			logDumpSlot = 0;
+		--logDumpSlotsLeft;
+		if(!valid || !sequenceNotBefore(record.sequence, logDumpFromSequence))
+			continue;
+		
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+		output.print("Log: ");
+		output.print(record.sequence);
+		output.print(',');
+		output.print(record.endUptimeSeconds);
+		output.print(',');
+		output.print(record.pulseCount);
+		output.print(',');
+		output.print(record.milliPulsesPerSecond);
+		output.print(',');
+		output.println(record.gustMilliPulsesPerSecond);
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+		sendFrame(frameTypeLog, &record, sizeof(LogRecord) - 1);
+#endif
+		++logDumpRecordsSent;
+	}
+}
+
+#endif
+
+#if PULSE_HISTOGRAM
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+// Type of frame of the answer to "histogram", see sendFrame().
+const byte frameTypeHistogram = 8;
+
+// The content of a frame of frameTypeHistogram.
+struct __attribute__((packed)) BinaryHistogram {
+	// See histogramFirstBinMicros.
+	uint16_t firstBinMicros;
+	// See histogramRejectedEdges.
+	uint32_t rejectedEdges;
+	// See histogramCounts.
+	uint16_t counts[histogramBins];
+};
+#endif
+
+// Sends the histogramCounts and histogramRejectedEdges, see
+// PULSE_HISTOGRAM, and resets them if clear is true. The text output is
+// the number of each bin, separated by commas, so it is easy to copy
+// into a spreadsheet, e.g.
+//     Pulse intervals from 512 us, doubling: 0,0,0,0,0,0,0,0,20,380,...
+//     Edges rejected by the debounce: 12
+void sendHistogram(bool clear) {
+	output.beginReport();
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	output.print("Pulse intervals from ");
+	output.print(histogramFirstBinMicros);
+	output.print(" us, doubling: ");
+	for(byte bin = 0; bin < histogramBins; ++bin) {
+		if(bin > 0)
+			output.print(',');
+		output.print(histogramCounts[bin]);
+	}
+	output.println();
+	output.print("Edges rejected by the debounce: ");
+	output.println(histogramRejectedEdges);
+	output.println("-----------------------------------------------");
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	BinaryHistogram histogram;
+	histogram.firstBinMicros = histogramFirstBinMicros;
+	histogram.rejectedEdges = histogramRejectedEdges;
+	for(byte bin = 0; bin < histogramBins; ++bin)
+		histogram.counts[bin] = histogramCounts[bin];
+	sendFrame(frameTypeHistogram, &histogram, sizeof(histogram));
+#endif
+	output.endReport();
+	
+	if(clear) {
+		for(byte bin = 0; bin < histogramBins; ++bin)
+			histogramCounts[bin] = 0;
+		histogramRejectedEdges = 0;
+	}
+}
+
+#endif
+
+#if TIME_SYNC
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+// Type of frame of the answer to "time", see sendFrame().
+const byte frameTypeTimeSync = 10;
+
+// The content of a frame of frameTypeTimeSync.
+struct __attribute__((packed)) BinaryTimeSync {
+	// The time which the PC sent minus the one which the Arduino
+	// expected, in milliseconds. 0 for the first "time".
+	int32_t differenceMillis;
+	// See clockCorrectionPpb.
+	int32_t clockCorrectionPpb;
+};
+#endif
+
+// Returns the PC's time in milliseconds since 1970 at the given
+// uptimeTicks(): The time of the last "time" plus the time since then,
+// corrected by the clockCorrectionPpb. Also works for times before
+// the last "time", e.g. for the start of the measurement during which
+// it came.
+unsigned long long hostMillis(unsigned long long uptime) {
+	// Negative for times before the last "time".
+	long long elapsed = (long long)(uptime - syncUptimeTicks)
+		/ (long long)(pulseTicksPerSecond / 1000);
+	return syncHostMillis
+		+ (elapsed + elapsed * clockCorrectionPpb / 1000000000);
+}
+
+// Converts the text of a Unix time with up to 3 decimals, e.g.
+// "1760000000.5", to milliseconds. Returns false if it is not such a
+// number.
+bool parseUnixMillis(const char *text, unsigned long long &millis) {
+	millis = 0;
+	byte digits = 0;
+	// Number of decimals after the '.', -1 before it.
+	int decimals = -1;
+	for(; *text != '\0'; ++text) {
+		if(*text == '.' && decimals < 0 && digits > 0) {
+			decimals = 0;
+			continue;
+		}
+		if(*text < '0' || *text > '9' || ++digits > 15 || decimals >= 3)
+			return false;
+		if(decimals >= 0)
+			++decimals;
+		millis = millis * 10 + (*text - '0');
+	}
+	for(; decimals < 3; ++decimals)
+		millis *= 10;
+	return digits > 0;
+}
+
+// Sends the answer to "time", with the given difference between the
+// time which the PC sent and the one which the Arduino expected.
+void sendTimeSync(long differenceMillis) {
+	output.beginReport();
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	output.print("Time synchronized, difference in milliseconds: ");
+	output.println(differenceMillis);
+	output.print("Clock correction in ppm: ");
+	printThousandths(clockCorrectionPpb);
+	output.println("-----------------------------------------------");
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	BinaryTimeSync sync;
+	sync.differenceMillis = differenceMillis;
+	sync.clockCorrectionPpb = clockCorrectionPpb;
+	sendFrame(frameTypeTimeSync, &sync, sizeof(sync));
+#endif
+	output.endReport();
+}
+
+// Runs "time", whose argument is the PC's time, see TIME_SYNC.
+// Called by runCommand(), so the line of the given length has just
+// arrived. Returns false if the time is invalid.
+// The clockCorrectionPpb is computed over the time since the previous
+// computation, so it follows when the clock of the Arduino changes with
+// the temperature.
+bool synchronizeTime(const char *arguments, byte lineLength) {
+	unsigned long long host;
+	if(!parseUnixMillis(arguments, host))
+		return false;
+	// Sending the line took 10 bits per byte, including the line break.
+	host += (lineLength + 1) * 10000UL / serialBaud;
+	unsigned long long uptime = uptimeTicks();
+	
+	long differenceMillis = 0;
+	if(timeSynchronized) {
+		long long difference = (long long)(host - hostMillis(uptime));
+		// Only more if the PC's clock was set, so it fits into 32 bits.
+		if(difference > 2000000000)
+			difference = 2000000000;
+		else if(difference < -2000000000)
+			difference = -2000000000;
+		differenceMillis = difference;
+	
+		long long arduinoMillis = (uptime - driftUptimeTicks)
+			/ (pulseTicksPerSecond / 1000);
+		if(arduinoMillis >= (long long)timeSyncDriftMinMillis) {
+			long long pcMillis = (long long)(host - driftHostMillis);
+			long long correction = (pcMillis - arduinoMillis) * 1000000000
+				/ arduinoMillis;
+			if(correction >= -timeSyncMaxCorrectionPpb
+					&& correction <= timeSyncMaxCorrectionPpb)
+				clockCorrectionPpb = correction;
+			driftHostMillis = host;
+			driftUptimeTicks = uptime;
+		}
+	} else {
+		driftHostMillis = host;
+		driftUptimeTicks = uptime;
+	}
+	
+	syncHostMillis = host;
+	syncUptimeTicks = uptime;
+	timeSynchronized = true;
+	sendTimeSync(differenceMillis);
+	return true;
+}
+
+// Called by takeSample() for each sample once the time has been
+// synchronized, instead of counting the samples. Returns true if the
+// measurement ends with this sample: If it is at a whole multiple of
+// sensorMeasurementSeconds, or REPORT_INTERVAL_SECONDS, of the PC's
+// time - or if the measurement has become twice as long as it should,
+// which only happens if the PC's clock was set.
+// Moves the following samples to whole multiples of
+// sampleIntervalMillis of the PC's time, by making the time until the
+// next one up to sampleAlignMaxMillis shorter or longer. After the
+// first "time" that takes a few samples, afterwards it is a
+// millisecond once in a while as the clocks drift apart.
+bool alignSample(unsigned long now, unsigned long long uptime) {
+	Task *task = tasks;
+	while(task->run != takeSample)
+		++task;
+	
+	// The PC's time when the sample was due - loop() may have run it a
+	// few milliseconds later - rounded to the nearest multiple of
+	// sampleIntervalMillis, and by how much it was after that.
+	unsigned long long due
+		= hostMillis(uptime) - timeSince(task->lastRunMillis, now);
+	long late = due % sampleIntervalMillis;
+	if(late >= (long)sampleIntervalMillis / 2)
+		late -= sampleIntervalMillis;
+	due -= late;
+	
+	if(late > (long)sampleAlignMaxMillis)
+		late = sampleAlignMaxMillis;
+	else if(late < -(long)sampleAlignMaxMillis)
+		late = -(long)sampleAlignMaxMillis;
+	// loop() advances lastRunMillis by this before the next run.
+	task->intervalMillis = sampleIntervalMillis - late;
+	
+	return due % ((unsigned long long)samplesPerReport() * sampleIntervalMillis)
+			== 0
+		|| samplesInMeasurement >= 2 * samplesPerReport();
+}
+
+// Prints the given number of thousandths with 3 decimals, followed by a
+// line break. For example -1005 is printed as "-1.005".
+void printThousandths(long long thousandths) {
+	if(thousandths < 0) {
+		output.print('-');
+		thousandths = -thousandths;
+	}
+	output.print((unsigned long)(thousandths / 1000));
+	output.print('.');
+	unsigned int decimals = thousandths % 1000;
+	if(decimals < 100)
+		output.print('0');
+	if(decimals < 10)
+		output.print('0');
+	output.println(decimals);
+}
+
+#endif
+
+#if SERIAL_COMMANDS
+
+// The settings as stored in the EEPROM, see SERIAL_COMMANDS.
+struct __attribute__((packed)) StoredSettings {
+	uint16_t measurementSeconds;
+	uint32_t debounceMicros;
+	uint32_t baud;
+	// See eepromCheck(). An EEPROM which was never written by this
+	// program, e.g. of a new Arduino, is thus ignored.
+	uint8_t check;
+};
+
+// Address of the StoredSettings in the EEPROM.
+const unsigned int settingsEepromAddress = 0;
+#if EEPROM_LOG
+static_assert(settingsEepromAddress + sizeof(StoredSettings)
+		<= logEepromStart,
+	"The StoredSettings overlap with the EEPROM_LOG");
+#endif
+
+// Set by "set baud" to tell readCommands() to change the speed of
+// Serial to serialBaud once the answer has been sent. With
+// OUTPUT_FORMAT_MODBUS handleModbus() does that.
+bool serialBaudPending = false;
+
+#if COMMAND_LINES
+// Results of a command, as sent in the BinarySettings.
+const byte commandResultOk = 0;
+const byte commandResultUnknown = 1;
+const byte commandResultInvalidValue = 2;
+const byte commandResultReadOnly = 3;
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+// Type of frame of the answer to each command, see sendFrame().
+const byte frameTypeSettings = 7;
+
+// The content of a frame of frameTypeSettings.
+struct __attribute__((packed)) BinarySettings {
+	// One of the commandResult... values.
+	uint8_t result;
+	uint16_t measurementSeconds;
+	uint32_t debounceMicros;
+	uint32_t baud;
+	// See OUTPUT_FORMAT.
+	uint8_t outputFormat;
+};
+#endif
+#endif
+
+// Whether the settings are allowed: The same as what the
+// SensorConfiguration checks while compiling.
+bool measurementSecondsValid(unsigned long seconds) {
+#if REPORT_INTERVAL_SECONDS
+	// The window can't have more intervals than reportIntervals.
+	if(seconds % REPORT_INTERVAL_SECONDS != 0
+			|| seconds > Sensor::measurementDelaySeconds)
+		return false;
+#endif
+	return seconds > 0 && seconds <= ULONG_MAX / pulseTicksPerSecond;
+}
+
+bool debounceMicrosValid(unsigned long micros) {
+	// Up to 1 second, which is plenty, so the ticks can't overflow.
+	if(micros == 0 || micros > 1000000
+			|| maxPulsesPerSample(micros) > (PulseCount)~0UL)
+		return false;
+#if MOVING_STATISTICS
+	if(!statisticsDebounceValid(micros))
+		return false;
+#endif
+	return true;
+}
+
+bool baudValid(unsigned long baud) {
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+	// See setupModbus().
+	return baud >= 2400 && baud <= 115200;
+#else
+	return baud >= 300 && baud <= 1000000;
+#endif
+}
+
+// Changes the settings of the Sensor and computes the values which are
+// derived from them.
+void applySettings(unsigned int measurementSeconds,
+		unsigned long debounceMicros) {
+	sensorMeasurementSeconds = measurementSeconds;
+	sensorSamplesPerMeasurement
+		= (unsigned long)measurementSeconds * 1000 / sampleIntervalMillis;
+	sensorDebounceMicros = debounceMicros;
+	sensorMaxMilliPulsesPerSecond = maxMilliPulsesPerSecondFor(debounceMicros);
+	displayedDecimals = displayedDecimalsFor(debounceMicros);
+	
+	unsigned long ticks = debounceMicros * (pulseTicksPerSecond / 1000000);
+	// Reading the 4 bytes must not be interrupted by countPulse().
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		sensorDebounceTicks = ticks;
+	}
+#if REPORT_INTERVAL_SECONDS
+	// The intervals which were added with the old number of intervals
+	// of the window don't fit anymore.
+	resetReportWindow();
+#endif
+}
+
+// Loads the settings from the EEPROM, if they were stored there and are
+// valid. Called by setup().
+void setupSettings() {
+	StoredSettings stored;
+	eeprom_read_block(&stored, (const void *)settingsEepromAddress,
+		sizeof(stored));
+	if(stored.check != eepromCheck(&stored, sizeof(stored) - 1)
+			|| !measurementSecondsValid(stored.measurementSeconds)
+			|| !debounceMicrosValid(stored.debounceMicros)
+			|| !baudValid(stored.baud))
+		return;
+	
+	applySettings(stored.measurementSeconds, stored.debounceMicros);
+	serialBaud = stored.baud;
+}
+
+// Stores the settings in the EEPROM.
+// Unlike writeLog() this waits until the EEPROM has written each byte,
+// ~ 3.3 milliseconds per changed byte. That's fine for something which
+// happens rarely, and the interrupts still count the pulses meanwhile.
+void saveSettings() {
+	StoredSettings stored;
+	stored.measurementSeconds = sensorMeasurementSeconds;
+	stored.debounceMicros = sensorDebounceMicros;
+	stored.baud = serialBaud;
+	stored.check = eepromCheck(&stored, sizeof(stored) - 1);
+	eeprom_update_block(&stored, (void *)settingsEepromAddress,
+		sizeof(stored));
+}
+
+#if COMMAND_LINES
+// Sends the answer to a command: The result and the settings.
+void sendSettings(byte result) {
+	output.beginReport();
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	if(result == commandResultOk)
+		output.println("OK");
+	else if(result == commandResultUnknown)
+		output.println("ERROR: Unknown command");
+	else if(result == commandResultInvalidValue)
+		output.println("ERROR: Invalid value");
+	else
+		output.println("ERROR: Can only be changed when compiling");
+	output.print("Measurement seconds: ");
+	output.println(sensorMeasurementSeconds);
+	output.print("Debounce microseconds: ");
+	output.println(sensorDebounceMicros);
+	output.println("Output format: text");
+	output.print("Baud: ");
+	output.println(serialBaud);
+	output.println("-----------------------------------------------");
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	BinarySettings settings;
+	settings.result = result;
+	settings.measurementSeconds = sensorMeasurementSeconds;
+	settings.debounceMicros = sensorDebounceMicros;
+	settings.baud = serialBaud;
+	settings.outputFormat = OUTPUT_FORMAT;
+	sendFrame(frameTypeSettings, &settings, sizeof(settings));
+#endif
+	output.endReport();
+}
+
+// Runs "set": The arguments are the name of the setting and the value.
+// Returns one of the commandResult... values.
+byte runSetCommand(char *arguments) {
+	char *value = strchr(arguments, ' ');
+	if(value == NULL)
+		return commandResultInvalidValue;
+	*value++ = '\0';
+	
+	if(strcmp(arguments, "format") == 0)
+		return commandResultReadOnly;
+	
+	unsigned long number;
+	if(!parseNumber(value, number))
+		return commandResultInvalidValue;
+	
+	if(strcmp(arguments, "measurement") == 0) {
+		if(!measurementSecondsValid(number))
+			return commandResultInvalidValue;
+		applySettings(number, sensorDebounceMicros);
+	} else if(strcmp(arguments, "debounce") == 0) {
+		if(!debounceMicrosValid(number))
+			return commandResultInvalidValue;
+		applySettings(sensorMeasurementSeconds, number);
+	} else if(strcmp(arguments, "baud") == 0) {
+		if(!baudValid(number))
+			return commandResultInvalidValue;
+		serialBaud = number;
+		serialBaudPending = true;
+	} else
+		return commandResultUnknown;
+	
+	saveSettings();
+	return commandResultOk;
+}
+
+// Runs the commands of SERIAL_COMMANDS: "get", "set" and "defaults".
+// The arguments are the text after the command.
+void runSettingsCommand(const char *command, char *arguments) {
+	byte result = commandResultOk;
+	
+	if(strcmp(command, "get") == 0 && *arguments == '\0') {
+		// Only sends the settings, as all commands do.
+	} else if(strcmp(command, "set") == 0)
+		result = runSetCommand(arguments);
+	else if(strcmp(command, "defaults") == 0 && *arguments == '\0') {
+		applySettings(Sensor::measurementDelaySeconds,
+			Sensor::debounceDelayMicros);
+		serialBaudPending = serialBaud != SERIAL_BAUD;
+		serialBaud = SERIAL_BAUD;
+		saveSettings();
+	} else
+		result = commandResultUnknown;
+	
+	sendSettings(result);
+}
+#endif
+
+#endif
+
+#if COMMAND_LINES
+
+// The line which readCommands() is receiving from the PC, and its
+// length. The length is set above the size of the buffer once a line
+// is too long, so it is ignored.
+char commandLine[24];
+byte commandLength = 0;
+
+// Converts the text of a decimal number to the number. Returns false if
+// the text is not only digits, or too long for an unsigned long.
+bool parseNumber(const char *text, unsigned long &number) {
+	number = 0;
+	byte digits = 0;
+	for(; *text != '\0'; ++text) {
+		if(*text < '0' || *text > '9' || ++digits > 9)
+			return false;
+		number = number * 10 + (*text - '0');
+	}
+	return digits > 0;
+}
+
+// Runs a line received by readCommands(). The first word is the name
+// of the command, the rest are its arguments, separated by a space.
+void runCommand() {
+	char *arguments = strchr(commandLine, ' ');
+	if(arguments != NULL)
+		*arguments++ = '\0';
+	else
+		arguments = commandLine + commandLength;
+	
+#if EEPROM_LOG
+	// "dump", optionally followed by the sequence of the first record to
+	// send, see EEPROM_LOG.
+	if(strcmp(commandLine, "dump") == 0) {
+		unsigned long from = 0;
+		if(*arguments == '\0')
+			startLogDump(true, 0);
+		else if(parseNumber(arguments, from) && from <= 65535)
+			startLogDump(false, from);
+#if SERIAL_COMMANDS
+		else
+			sendSettings(commandResultInvalidValue);
+#endif
+		return;
+	}
+#endif
+	
+#if PULSE_HISTOGRAM
+	// "histogram", optionally followed by "clear", see PULSE_HISTOGRAM.
+	if(strcmp(commandLine, "histogram") == 0) {
+		if(*arguments == '\0' || strcmp(arguments, "clear") == 0)
+			sendHistogram(*arguments != '\0');
+#if SERIAL_COMMANDS
+		else
+			sendSettings(commandResultInvalidValue);
+#endif
+		return;
+	}
+#endif
+	
+#if TIME_SYNC
+	// "time", followed by the PC's time, see TIME_SYNC.
+	if(strcmp(commandLine, "time") == 0) {
+		if(!synchronizeTime(arguments, commandLength)) {
+#if SERIAL_COMMANDS
+			sendSettings(commandResultInvalidValue);
+#endif
+		}
+		return;
+	}
+#endif
+	
+#if SERIAL_COMMANDS
+	runSettingsCommand(commandLine, arguments);
+#endif
+}
+
+// Task which receives lines of commands from the PC, see
+// SERIAL_COMMANDS, EEPROM_LOG, PULSE_HISTOGRAM and TIME_SYNC.
+// Serial receives the bytes in the background, so this only takes what
+// has been received already and never waits for more.
+// Runs at most one command per call, and only if half of the output
+// queue is free, so the answers of many commands in a row are not
+// dropped for lack of space. The further lines wait in the receive
+// buffer of Serial meanwhile, which has room for 63 bytes, so the PC
+// should wait for the answer to a command before sending the next.
+void readCommands() {
+#if SERIAL_COMMANDS
+	// Switch the speed only after the answer to "set baud" has been sent.
+	if(serialBaudPending && output.freeSpace() == OUTPUT_QUEUE_SIZE) {
+		// Waits until Serial has sent the rest of its buffer as well.
+		Serial.flush();
+		Serial.begin(serialBaud);
+		serialBaudPending = false;
+	}
+#endif
+	
+	while(Serial.available() > 0
+			&& output.freeSpace() >= OUTPUT_QUEUE_SIZE / 2) {
+		char c = Serial.read();
+		if(c == '\r' || c == '\n') {
+			bool complete
+				= commandLength > 0 && commandLength < sizeof(commandLine);
+			if(complete) {
+				commandLine[commandLength] = '\0';
+				runCommand();
+			}
+			commandLength = 0;
+			if(complete)
+				return;
+		} else if(commandLength < sizeof(commandLine) - 1)
+			commandLine[commandLength++] = c;
+		else
+			commandLength = sizeof(commandLine);
+	}
+}
+
+#endif
+
+#if MOVING_STATISTICS
+
+// Adds the pulse count of a sample to the moving statistics.
+void addStatisticsSample(unsigned int count) {
+	// Replace the oldest sample of the gust ring with the new one.
+	// During the first statisticsGustSeconds after startup the oldest
+	// entries are the initial zeros, which is harmless.
+	statisticsGustSum -= statisticsGustRing[statisticsGustPosition];
+	statisticsGustSum += count;
+	statisticsGustRing[statisticsGustPosition] = count;
+	if(++statisticsGustPosition == statisticsGustSamples)
+		statisticsGustPosition = 0;
+	
+	StatisticsBlock &block = statisticsCurrentBlock;
+	block.sum += count;
+	block.sumOfSquares += (unsigned long)count * count;
+	if(statisticsGustSum > block.gustMax)
+		block.gustMax = statisticsGustSum;
+	
+	if(++statisticsCurrentBlockSamples < statisticsBlockSamples)
+		return;
+	
+	addStatisticsBlock(block);
+	
+	block.sum = 0;
+	block.sumOfSquares = 0;
+	block.gustMax = 0;
+	statisticsCurrentBlockSamples = 0;
+}
+
+// Adds a finished block to the ring of blocks, replacing the oldest
+// one if the ring is full.
+void addStatisticsBlock(const StatisticsBlock &block) {
+	StatisticsBlock &oldest = statisticsBlockRing[statisticsBlockPosition];
+	
+	if(statisticsBlocksFilled == statisticsBlocks) {
+		statisticsSum -= oldest.sum;
+		statisticsSumOfSquares -= oldest.sumOfSquares;
+	} else
+		++statisticsBlocksFilled;
+	
+	oldest = block;
+	statisticsSum += block.sum;
+	statisticsSumOfSquares += block.sumOfSquares;
+	if(++statisticsBlockPosition == statisticsBlocks)
+		statisticsBlockPosition = 0;
+	
+	byte blockNumber = statisticsBlockNumber++;
+	
+	// Remove the blocks from the back of the max queue which cannot
+	// become the maximum anymore, see statisticsMaxQueueBlock.
+	while(statisticsMaxQueueLength > 0) {
+		byte last = (statisticsMaxQueueStart + statisticsMaxQueueLength - 1)
+			% statisticsBlocks;
+		if(statisticsMaxQueueValue[last] > block.gustMax)
+			break;
+		--statisticsMaxQueueLength;
+	}
+	
+	// Remove the first block if it has left the ring. As the queue
+	// is sorted by age only the first one can have done so.
+	// The byte subtraction yields the correct age even if the
+	// statisticsBlockNumber overflowed from 255 to 0 in between.
+	if(statisticsMaxQueueLength > 0
+			&& (byte)(blockNumber
+				- statisticsMaxQueueBlock[statisticsMaxQueueStart])
+				>= statisticsBlocks) {
+		statisticsMaxQueueStart
+			= (statisticsMaxQueueStart + 1) % statisticsBlocks;
+		--statisticsMaxQueueLength;
+	}
+	
+	byte position = (statisticsMaxQueueStart + statisticsMaxQueueLength)
+		% statisticsBlocks;
+	statisticsMaxQueueBlock[position] = blockNumber;
+	statisticsMaxQueueValue[position] = block.gustMax;
+	++statisticsMaxQueueLength;
+}
+
+// Computes the moving statistics for the reports.
+// Returns false if there is no block yet, i.e. during the first
+// statisticsBlockSeconds after startup.
+bool computeStatistics(StatisticsResult &result) {
+	if(statisticsBlocksFilled == 0)
+		return false;
+	
+	// For converting the pulse count of a sample to milli pulses per
+	// second.
+	const unsigned long milliSamplesPerSecond
+		= 1000UL * 1000 / sampleIntervalMillis;
+	
+	unsigned long samples
+		= (unsigned long)statisticsBlocksFilled * statisticsBlockSamples;
+	// This is less than statisticsMeanMinutes shortly after startup.
+	result.seconds = samples * sampleIntervalMillis / 1000;
+	result.mean
+		= multiplyDivide(statisticsSum, milliSamplesPerSecond, samples);
+	// Variance = average of the squares - square of the average
+	//          = (samples * sumOfSquares - sum * sum) / samples^2
+	// Computing it like this avoids rounding errors because it only
+	// divides once. The standard deviation is the square root of that.
+	// The variance can't overflow: sumOfSquares is below 2^32, see
+	// statisticsDebounceValid(), and samples is below 2^12.
+	unsigned long long variance
+		= (unsigned long long)samples * statisticsSumOfSquares
+		- (unsigned long long)statisticsSum * statisticsSum;
+	// But multiplied by milliSamplesPerSecond^2 it can with a short
+	// debounce delay, e.g. half of the samples at 0 and half at 1250
+	// pulses with 200 microseconds. Then the variance is divided by 4
+	// until it fits, and the square root multiplied by 2 as often,
+	// which only loses digits far below the ones which are shown.
+	const unsigned long long squaredMilliSamplesPerSecond
+		= (unsigned long long)milliSamplesPerSecond * milliSamplesPerSecond;
+	byte shift = 0;
+	while(variance > ULLONG_MAX / squaredMilliSamplesPerSecond) {
+		variance >>= 2;
+		++shift;
+	}
+	result.stddev = ((unsigned long long)integerSquareRoot(
+		variance * squaredMilliSamplesPerSecond) << shift) / samples;
+	result.gust = multiplyDivide(
+		statisticsMaxQueueValue[statisticsMaxQueueStart],
+		milliSamplesPerSecond, statisticsGustSamples);
+	return true;
+}
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+// Prints the moving statistics as part of printTextReport().
+void printStatistics() {
+	StatisticsResult statistics;
+	if(!computeStatistics(statistics))
+		return;
+	
+	output.print("Pulses per second, average of last ");
+	output.print(statistics.seconds);
+	output.print(" s: ");
+	printMilli(statistics.mean);
+	output.print("Pulses per second, standard deviation: ");
+	printMilli(statistics.stddev);
+	output.print("Pulses per second, max. ");
+	output.print(statisticsGustSeconds);
+	output.print(" s gust: ");
+	printMilli(statistics.gust);
+	// The wind speed of the average pulses per second, which is close
+	// to the average wind speed as the windCalibration is almost
+	// linear above low speeds.
+	output.print("Wind speed in m/s, average: ");
+	printMilli(windMillimetersPerSecond(statistics.mean));
+	output.print("Wind speed in m/s, max. gust: ");
+	printMilli(windMillimetersPerSecond(statistics.gust));
+}
+#endif
+
+#endif
+
+#if INSTRUMENTATION
+
+void setupInstrumentation() {
+#if INSTRUMENTATION_SCOPE_PIN
+	// Same as pinMode(7, OUTPUT), the pin is LOW initially.
+	DDRD |= _BV(instrumentationScopePortDBit);
+#endif
+	
+#if PULSE_INPUT != PULSE_INPUT_TIMER1_CAPTURE
+	// Let Timer1 count with the CPU clock, from 0 to 65535 and then
+	// from 0 again, without any interrupts. See setupPulseInput() of
+	// PULSE_INPUT_TIMER1_CAPTURE.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TCCR1A = 0;
+		TCCR1B = _BV(CS10);
+		TIMSK1 = 0;
+	}
+#endif
+}
+
+// Copies the statistics modified by the interrupt to the result and
+// resets them.
+void takeCycleStatistics(volatile CycleStatistics &statistics,
+		CycleResult &result) {
+	CycleStatistics copy;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		copy.min = statistics.min;
+		copy.max = statistics.max;
+		copy.sum = statistics.sum;
+		copy.count = statistics.count;
+		statistics.min = UINT_MAX;
+		statistics.max = 0;
+		statistics.sum = 0;
+		statistics.count = 0;
+	}
+	
+	result.count = copy.count;
+	if(copy.count == 0) {
+		result.min = 0;
+		result.average = 0;
+		result.max = 0;
+		return;
+	}
+	result.min = (unsigned long)copy.min * cyclesPerTimer1Count;
+	result.average
+		= multiplyDivide(copy.sum, cyclesPerTimer1Count, copy.count);
+	result.max = (unsigned long)copy.max * cyclesPerTimer1Count;
+}
+
+// Takes the instrumentation statistics of the measurement which has
+// just finished for its report, and resets them so the next report has
+// the values of the next measurement only. Called by
+// finishMeasurement().
+void takeInstrumentation() {
+	takeCycleStatistics(isrCycles, reportIsrCycles);
+#if PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE
+	takeCycleStatistics(isrLatencyCycles, reportIsrLatencyCycles);
+#endif
+	// Not modified by an interrupt, but resetting it the same way does
+	// no harm.
+	takeCycleStatistics(criticalSectionCycles, reportCriticalSectionCycles);
+}
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+// Prints the given statistics as "min / average / max", followed by a
+// line break.
+void printCycles(const CycleResult &result) {
+	if(result.count == 0) {
+		output.println("-");
+		return;
+	}
+	
+	output.print(result.min);
+	output.print(" / ");
+	output.print(result.average);
+	output.print(" / ");
+	output.println(result.max);
+}
+
+// Prints the instrumentation statistics of the last measurement as part
+// of printTextReport().
+// The durations don't include the few cycles which the CPU needs for
+// entering and leaving the interrupt.
+void printInstrumentation() {
+	output.print("CPU cycles in interrupt (min / avg / max): ");
+	printCycles(reportIsrCycles);
+#if PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE
+	output.print("CPU cycles from pulse to interrupt: ");
+	printCycles(reportIsrLatencyCycles);
+#endif
+	output.print("CPU cycles with interrupts disabled: ");
+	printCycles(reportCriticalSectionCycles);
+}
+#endif
+
+#endif
+
+#if LOW_POWER
+
+// Switches off the parts of the chip which are not used, see LOW_POWER.
+// Called by setup().
+void setupLowPower() {
+	// The ADC must be disabled before its clock is switched off,
+	// otherwise it keeps using power.
+	ADCSRA &= ~_BV(ADEN);
+	power_adc_disable();
+	power_spi_disable();
+#if !I2C_ADDRESS
+	power_twi_disable();
+#endif
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	power_timer2_disable();
+#endif
+#if PULSE_INPUT == PULSE_INPUT_EXTERNAL_INTERRUPT && !INSTRUMENTATION
+	power_timer1_disable();
+#endif
+}
+
+// Lets the CPU sleep until the next interrupt, and adds the time to
+// sleepMicros. Called by loop().
+// Interrupts stay enabled, so the pulses are counted while sleeping
+// exactly as while awake.
+// The interrupt which wakes the CPU up runs before sleep_mode()
+// returns, so its time counts as sleeping. That makes the percentage of
+// being awake a bit too low, by ~ 0.5 percent for the timer of
+// millis().
+void sleepUntilInterrupt() {
+	unsigned long start = micros();
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_mode();
+	sleepMicros += timeSince(start, micros());
+}
+
+#endif
+
+#if HEALTH_REPORT
+
+#ifndef HOST_HARNESS
+// Defined by avr-libc: The end of the variables, where the "heap" of
+// malloc() starts, and the end of the heap, 0 if malloc() was never
+// used. The stack grows downwards from the end of the RAM towards
+// them.
+extern char __heap_start;
+extern char *__brkval;
+#endif
+
+// What paintStack() fills the free RAM with.
+const byte stackPaint = 0xC5;
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+// Type of frame of the health record, see sendFrame().
+const byte frameTypeHealth = 11;
+
+// The content of a frame of frameTypeHealth.
+struct __attribute__((packed)) BinaryHealth {
+	// See resetFlags: PORF 1 is power on, EXTRF 2 the reset button, BORF
+	// 4 a too low voltage ("brown-out"), WDRF 8 the WATCHDOG. 0 if the
+	// bootloader cleared them, which older ones do.
+	uint8_t resetFlags;
+	// See reportEndUptimeTicks.
+	uint32_t uptimeSeconds;
+	// See stackMargin().
+	uint16_t stackMarginBytes;
+	// See healthTasksLate etc.
+	uint16_t tasksLate;
+	uint32_t reportsDropped;
+	uint32_t timestampsLost;
+};
+#endif
+
+// Returns the first byte of the RAM which neither the variables nor
+// malloc() use.
+byte *freeRamStart() {
+	return __brkval != 0 ? (byte *)__brkval : (byte *)&__heap_start;
+}
+
+// Fills the free RAM below the stack with stackPaint, so stackMargin()
+// can tell how deep the stack has grown since then. Called by setup().
+// Everything below the stack pointer SP is unused: An interrupt which
+// put something there has already returned.
+void paintStack() {
+	for(byte *address = freeRamStart(); address < (byte *)SP; ++address)
+		*address = stackPaint;
+}
+
+// Returns the number of bytes between the variables and the stack
+// which the stack has never used since paintStack(), i.e. how much
+// more RAM the program could use.
+// Calls of functions and interrupts use more of the stack the deeper
+// they are nested, e.g. when an interrupt happens while printing, so
+// this shows the deepest one which happened so far.
+unsigned int stackMargin() {
+	byte *start = freeRamStart();
+	byte *address = start;
+	while(address < (byte *)SP && *address == stackPaint)
+		++address;
+	return address - start;
+}
+
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+// Task which sends the health record, see HEALTH_REPORT.
+void sendHealth() {
+	unsigned long uptimeSeconds = uptimeTicks() / pulseTicksPerSecond;
+	
+	output.beginReport();
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	output.print("Reset by: ");
+	if(resetFlags & _BV(WDRF))
+		output.println("Watchdog");
+	else if(resetFlags & _BV(BORF))
+		output.println("Too low voltage");
+	else if(resetFlags & _BV(EXTRF))
+		output.println("Reset button");
+	else if(resetFlags & _BV(PORF))
+		output.println("Power on");
+	else
+		output.println("Unknown");
+	output.print("Never used RAM in bytes: ");
+	output.println(stackMargin());
+	output.print("Tasks which were late: ");
+	output.println(healthTasksLate);
+	output.print("Reports dropped since startup: ");
+	output.println(healthReportsDropped);
+	output.print("Times of pulses lost since startup: ");
+	output.println(healthTimestampsLost);
+	output.print("Uptime in seconds: ");
+	output.println(uptimeSeconds);
+	output.println("-----------------------------------------------");
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	BinaryHealth health;
+	health.resetFlags = resetFlags;
+	health.uptimeSeconds = uptimeSeconds;
+	health.stackMarginBytes = stackMargin();
+	health.tasksLate = healthTasksLate;
+	health.reportsDropped = healthReportsDropped;
+	health.timestampsLost = healthTimestampsLost;
+	sendFrame(frameTypeHealth, &health, sizeof(health));
+#endif
+	if(output.endReport())
+		return;
+	
+	// Make loop() run it again after healthRetryMillis instead of a
+	// whole healthIntervalMillis.
+	Task *task = tasks;
+	while(task->run != sendHealth)
+		++task;
+	task->lastRunMillis -= healthIntervalMillis - healthRetryMillis;
+}
+#endif
+
+#endif
+
+#if GUST_ALERT
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+// Type of frame of the gust alert, see sendFrame().
+const byte frameTypeGustAlert = 12;
+
+// The content of a frame of frameTypeGustAlert.
+struct __attribute__((packed)) BinaryGustAlert {
+	// 1 when a gust alert starts, 0 when it ends.
+	uint8_t active;
+	// See gustAlertMillimetersPerSecond etc.
+	uint32_t windMillimetersPerSecond;
+	uint32_t millis;
+};
+#endif
+
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+// Sends the gust alert, see GUST_ALERT. Leaves gustAlertPending true if
+// it doesn't fit into the output queue, so updateGustAlert() tries
+// again with the next sample.
+void sendGustAlert() {
+	output.beginReport();
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	// A single line, so it is short and can't be mistaken for a part
+	// of a report.
+	output.print(gustAlertActive ? "Gust alert on" : "Gust alert off");
+	output.print(", wind speed in m/s: ");
+	printMilli(gustAlertMillimetersPerSecond);
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	BinaryGustAlert alert;
+	alert.active = gustAlertActive;
+	alert.windMillimetersPerSecond = gustAlertMillimetersPerSecond;
+	alert.millis = gustAlertMillis;
+	sendFrame(frameTypeGustAlert, &alert, sizeof(alert));
+#endif
+	if(output.endReport())
+		gustAlertPending = false;
+}
+#endif
+
+// Called by takeSample() for each sample, at the given millis(). Adds
+// it to the window of the gust alert, computes the wind speed over the
+// window and starts or ends the gust alert, see GUST_ALERT.
+void updateGustAlert(const PulseSnapshot &sample, unsigned long now) {
+	// The oldest sample leaves the window, so its last pulse is the one
+	// before the window now. If it had no pulses that is the same as
+	// the one of the sample before it.
+	byte position = gustAlertPosition;
+	if(gustAlertCounts[position] > 0)
+		gustAlertReferenceValid = true;
+	gustAlertReferencePulse = gustAlertLastPulses[position];
+	if(timeSince(gustAlertReferencePulse, sample.now)
+			> reciprocalModeMaxPeriodSeconds * pulseTicksPerSecond)
+		gustAlertReferenceValid = false;
+	gustAlertSum -= gustAlertCounts[position];
+	gustAlertSum += sample.counts[0];
+	gustAlertCounts[position] = sample.counts[0];
+	gustAlertLastPulses[position] = sample.lastPulse;
+	gustAlertPosition
+		= position + 1 < gustAlertWindowSamples ? position + 1 : 0;
+	
+	unsigned long milliPulsesPerSecond = 0;
+	if(gustAlertSum > 0 && gustAlertReferenceValid) {
+		// The pulses came during this time, as in finishMeasurement().
+		unsigned long period
+			= timeSince(gustAlertReferencePulse, sample.lastPulse);
+		// If there was no pulse for longer than their average time apart
+		// the wind has become slower, so the time until now is used.
+		if((unsigned long long)timeSince(sample.lastPulse, sample.now)
+				* gustAlertSum > period)
+			period = timeSince(gustAlertReferencePulse, sample.now);
+		milliPulsesPerSecond = (unsigned long long)gustAlertSum
+			* pulseTicksPerSecond * 1000 / period;
+	} else {
+		milliPulsesPerSecond = multiplyDivide(gustAlertSum, 1000UL * 1000,
+			gustAlertWindowMillis);
+	}
+	unsigned long speed = windMillimetersPerSecond(milliPulsesPerSecond);
+	
+	bool beyond = gustAlertActive
+		? speed < gustAlertOffMillimetersPerSecond
+		: speed >= gustAlertOnMillimetersPerSecond;
+	if(!beyond) {
+		gustAlertSamplesBeyond = 0;
+	} else if(++gustAlertSamplesBeyond
+			> (gustAlertActive ? gustAlertOffSamples : gustAlertOnSamples)) {
+		gustAlertActive = !gustAlertActive;
+		gustAlertSamplesBeyond = 0;
+		gustAlertMillimetersPerSecond = speed;
+		gustAlertMillis = now;
+		gustAlertPending = true;
+#if I2C_ADDRESS
+		// For its flag.
+		i2cSnapshotPending = true;
+#endif
+#if GUST_ALERT_PIN
+		writePin(GUST_ALERT_PIN, gustAlertActive);
+#endif
+	}
+	
+	// With OUTPUT_FORMAT_MODBUS the master reads it from the flags
+	// instead, see readModbusInputValues().
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	if(gustAlertPending)
+		sendGustAlert();
+#endif
+}
+
+#endif
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+
+// Function codes of the requests which handleModbus() answers.
+const byte modbusReadHoldingRegisters = 3;
+const byte modbusReadInputRegisters = 4;
+const byte modbusWriteSingleRegister = 6;
+const byte modbusWriteMultipleRegisters = 16;
+// Exception codes, which the answer contains instead of the data if
+// the request was not done: An unknown function, a register which
+// doesn't exist or can't be written, and an invalid count or value.
+const byte modbusIllegalFunction = 1;
+const byte modbusIllegalDataAddress = 2;
+const byte modbusIllegalDataValue = 3;
+// Requests to this address are for all devices on the bus, which don't
+// answer them.
+const byte modbusBroadcastAddress = 0;
+
+// Bits of the flags of the input registers, see readModbusInputValues().
+// The same as the binaryReportFlag... values of OUTPUT_FORMAT_BINARY.
+const byte modbusFlagReciprocal = 1;
+const byte modbusFlagDebounceTooHigh = 2;
+const byte modbusFlagTimestampsLost = 4;
+const byte modbusFlagCountsOverflowed = 16;
+// There is a GUST_ALERT.
+const byte modbusFlagGustAlert = 32;
+
+// The first modbusWritableValues of the holding registers can be
+// changed with SERIAL_COMMANDS, see writeModbusRegisters().
+const byte modbusWritableValues = 3;
+
+// Microseconds per count of Timer2, which counts every 1024 CPU cycles.
+const unsigned long modbusTimerMicros = 1024 * 1000000UL / F_CPU;
+
+static_assert(SERIAL_BAUD >= 2400 && SERIAL_BAUD <= 115200,
+	"SERIAL_BAUD must be 2400 to 115200 with OUTPUT_FORMAT_MODBUS");
+static_assert(2 * modbusInputValues <= 125,
+	"All input registers must fit into a single answer");
+static_assert(modbusInputValues >= modbusHoldingValues,
+	"readModbusRegisters() reads the values into an array of this size");
+
+// Sets up the serial port and Timer2 for receiving the requests of the
+// Modbus master, see OUTPUT_FORMAT_MODBUS. Called by setup(), and by
+// handleModbus() when the speed has been changed.
+// The end of a request is detected by the bus being silent for 3.5
+// times the time of a byte, i.e. 38.5 bits, but at least for 1.75
+// milliseconds as the Modbus specification says for more than 19200
+// bits/s. Bytes of a request may be apart by up to that as well.
+void setupModbus() {
+	unsigned long silenceMicros
+		= serialBaud > 19200 ? 1750 : 38500000 / serialBaud;
+
+	// Timer2 counts up to OCR2A and then starts at 0 again ("CTC mode"),
+	// at which its interrupt happens - but only while enabled by
+	// USART_RX_vect. Setting TCNT2 to 0 doesn't restart the counting of
+	// the 1024 CPU cycles, so the interrupt comes after OCR2A to
+	// OCR2A + 1 counts, which is why it is rounded up.
+	// At 2400 bits/s the 16 milliseconds are 251 counts, so OCR2A fits
+	// into its 8 bits.
+	// This is the timer which analogWrite() uses on pin 3 and 11, so that
+	// doesn't work anymore.
+	TIMSK2 = 0;
+	TCCR2A = _BV(WGM21);
+	TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);
+	OCR2A = (silenceMicros + modbusTimerMicros - 1) / modbusTimerMicros;
+
+	// The serial port as Serial.begin() sets it up, but with even parity,
+	// i.e. 8 data bits, a parity bit and a stop bit ("8E1"), which is
+	// the default of Modbus RTU. U2X0 makes the speed more precise.
+	UCSR0A = _BV(U2X0);
+	UBRR0 = (F_CPU / 4 / serialBaud - 1) / 2;
+	UCSR0C = _BV(UPM01) | _BV(UCSZ01) | _BV(UCSZ00);
+	UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+
+#if MODBUS_DE_PIN
+	setupOutputPin(MODBUS_DE_PIN);
+#endif
+}
+
+// Throws the modbusFrame away and waits for the next request.
+inline void receiveModbus() {
+	modbusLength = 0;
+	modbusFrameError = false;
+	// Last, as the interrupt only stores the bytes from now on.
+	modbusState = modbusReceiving;
+}
+
+// Called when the serial port has received a byte. Stores it in the
+// modbusFrame and restarts waiting for the silence after it.
+ISR(USART_RX_vect) {
+	// The errors are of the byte in UDR0, so they must be read first.
+	byte errors = UCSR0A & (_BV(FE0) | _BV(DOR0) | _BV(UPE0));
+	byte value = UDR0;
+	// Requests which come while the last one hasn't been answered yet
+	// are ignored, as their start is missing.
+	if(modbusState != modbusReceiving)
+		return;
+
+	byte length = modbusLength;
+	if(errors != 0 || length == modbusFrameMaxBytes)
+		modbusFrameError = true;
+	else {
+		modbusFrame[length] = value;
+		modbusLength = length + 1;
+	}
+
+	TCNT2 = 0;
+	// A match while the interrupt was disabled has set the flag, which
+	// would call the interrupt right away.
+	TIFR2 = _BV(OCF2A);
+	TIMSK2 |= _BV(OCIE2A);
+}
+
+// Called by Timer2 when the bus has been silent since the last byte,
+// see setupModbus(), i.e. the request is complete.
+ISR(TIMER2_COMPA_vect) {
+	TIMSK2 &= ~_BV(OCIE2A);
+	modbusState = modbusReceived;
+}
+
+// Called when the serial port can take the next byte of the answer.
+ISR(USART_UDRE_vect) {
+	byte position = modbusSendPosition;
+	// Writing a 1 clears TXC0, so it only gets set once the last byte
+	// has been sent completely.
+	UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+	UDR0 = modbusFrame[position];
+	if(++position == modbusLength)
+		UCSR0B = (UCSR0B & ~_BV(UDRIE0)) | _BV(TXCIE0);
+	modbusSendPosition = position;
+}
+
+// Called when the last byte of the answer has been sent completely,
+// including its stop bit, so the RS-485 transceiver can stop sending.
+ISR(USART_TX_vect) {
+#if MODBUS_DE_PIN
+	writePin(MODBUS_DE_PIN, false);
+#endif
+	UCSR0B = (UCSR0B & ~_BV(TXCIE0)) | _BV(RXEN0);
+	receiveModbus();
+}
+
+// Returns the 16 bits number at the given position of the modbusFrame.
+// Modbus sends the highest byte first.
+unsigned int modbusWord(byte position) {
+	return (unsigned int)modbusFrame[position] << 8
+		| modbusFrame[position + 1];
+}
+
+void setModbusWord(byte position, unsigned int value) {
+	modbusFrame[position] = value >> 8;
+	modbusFrame[position + 1] = value & 0xFF;
+}
+
+// Replaces the request in the modbusFrame by the answer with the given
+// exception code. Returns its length.
+byte modbusException(byte code) {
+	modbusFrame[1] |= 0x80;
+	modbusFrame[2] = code;
+	return 3;
+}
+
+// Stores the values of the input registers in the given array, which
+// must have modbusInputValues entries.
+// Each value has 32 bits, and thus 2 registers: Register 2 * n is the
+// highest 16 bits of value n, register 2 * n + 1 the lowest. A master
+// which reads both with the same request gets the two halves of the
+// same value.
+// All but 11 to 16 are of the last finished measurement:
+// 0: See reportSequence. Tells the master whether there is a new
+//    measurement since it read the last one.
+// 1: Number of pulses.
+// 2: Milli pulses per second, as with the text output.
+// 3: Wind speed in millimeters per second, see
+//    windMillimetersPerSecond().
+// 4: Length of the measurement in milliseconds.
+// 5: Combination of the modbusFlag... values.
+// 6, 7, 8: Mean, standard deviation and gust of the moving statistics
+//    in milli pulses per second, 0 if MOVING_STATISTICS is disabled or
+//    if the first block has not been finished yet.
+// 9, 10: Wind speed of the mean and the gust.
+// 11: Number of pulses of the current measurement so far, i.e. until
+//    the last sample, which is at most sampleIntervalMillis ago.
+// 12: Seconds since startup.
+// 13 to 16: Only with HEALTH_REPORT, 0 otherwise: The resetFlags, see
+//    BinaryHealth, stackMargin(), healthTasksLate and
+//    healthTimestampsLost.
+// 17 and 18: Number of pulses and milli pulses per second of the first
+//    channel after the Sensor, see CHANNEL_VARIANT, 19 and 20 of the
+//    second one etc.
+// The last 12 after the channels: Only with INSTRUMENTATION, 0
+//    otherwise: The minimum, average, maximum and count of the
+//    reportIsrCycles, then of the reportIsrLatencyCycles and of the
+//    reportCriticalSectionCycles.
+void readModbusInputValues(unsigned long values[]) {
+	StatisticsResult statistics = { 0, 0, 0, 0 };
+#if MOVING_STATISTICS
+	computeStatistics(statistics);
+#endif
+	unsigned long milliPulsesPerSecond = milliPulsesPer(1);
+
+	byte flags = 0;
+	if(reportReciprocal)
+		flags |= modbusFlagReciprocal;
+	if(milliPulsesPerSecond >= sensorMaxMilliPulsesPerSecond)
+		flags |= modbusFlagDebounceTooHigh;
+	if(reportTimestampsLost > 0)
+		flags |= modbusFlagTimestampsLost;
+	if(reportCountsOverflowed)
+		flags |= modbusFlagCountsOverflowed;
+#if GUST_ALERT
+	if(gustAlertActive)
+		flags |= modbusFlagGustAlert;
+#endif
+
+	values[0] = reportSequence;
+	values[1] = reportPulseCounts[0];
+	values[2] = milliPulsesPerSecond;
+	values[3] = windMillimetersPerSecond(milliPulsesPerSecond);
+	values[4] = reportMeasurementMillis;
+	values[5] = flags;
+	values[6] = statistics.mean;
+	values[7] = statistics.stddev;
+	values[8] = statistics.gust;
+	values[9] = windMillimetersPerSecond(statistics.mean);
+	values[10] = windMillimetersPerSecond(statistics.gust);
+	values[11] = measurement.counts[0];
+	values[12] = uptimeTicks() / pulseTicksPerSecond;
+#if HEALTH_REPORT
+	values[13] = resetFlags;
+	values[14] = stackMargin();
+	values[15] = healthTasksLate;
+	values[16] = healthTimestampsLost;
+#else
+	values[13] = 0;
+	values[14] = 0;
+	values[15] = 0;
+	values[16] = 0;
+#endif
+	for(byte channel = 1; channel < channelCount; ++channel) {
+		values[15 + 2 * channel] = reportPulseCounts[channel];
+		// There is no measurement yet if it is 0.
+		values[16 + 2 * channel] = reportMeasurementMillis > 0
+			? channelMilliPulsesPerSecond(channel) : 0;
+	}
+	
+	unsigned long *instrumentation = values + 17 + 2 * (channelCount - 1);
+#if INSTRUMENTATION
+	const CycleResult *results[3] = { &reportIsrCycles,
+		&reportIsrLatencyCycles, &reportCriticalSectionCycles };
+	for(byte i = 0; i < 3; ++i) {
+		instrumentation[4 * i] = results[i]->min;
+		instrumentation[4 * i + 1] = results[i]->average;
+		instrumentation[4 * i + 2] = results[i]->max;
+		instrumentation[4 * i + 3] = results[i]->count;
+	}
+#else
+	for(byte i = 0; i < 12; ++i)
+		instrumentation[i] = 0;
+#endif
+}
+
+// Stores the values of the holding registers in the given array, which
+// must have modbusHoldingValues entries. They have 2 registers each as
+// the input registers, see readModbusInputValues():
+// 0: The measurementDelaySeconds of the Sensor.
+// 1: The debounceDelayMicros of the Sensor.
+// 2: The SERIAL_BAUD.
+// 3: The MODBUS_ADDRESS, which can only be changed when compiling.
+void readModbusHoldingValues(unsigned long values[]) {
+	values[0] = sensorMeasurementSeconds;
+	values[1] = sensorDebounceMicros;
+	values[2] = serialBaud;
+	values[3] = MODBUS_ADDRESS;
+}
+
+// Does the request in the modbusFrame, whose length without the CRC is
+// given, for reading registers: The input registers if input is true,
+// the holding registers otherwise. Returns the length of the answer
+// without the CRC, see answerModbusRequest().
+byte readModbusRegisters(byte length, bool input) {
+	if(length != 6)
+		return modbusException(modbusIllegalDataValue);
+	unsigned int first = modbusWord(2);
+	unsigned int count = modbusWord(4);
+	unsigned int registers
+		= 2 * (input ? modbusInputValues : modbusHoldingValues);
+	// The Modbus specification allows reading up to 125 at once.
+	if(count == 0 || count > 125)
+		return modbusException(modbusIllegalDataValue);
+	if(first >= registers || count > registers - first)
+		return modbusException(modbusIllegalDataAddress);
+
+	unsigned long values[modbusInputValues];
+	if(input)
+		readModbusInputValues(values);
+	else
+		readModbusHoldingValues(values);
+
+	modbusFrame[2] = 2 * count;
+	for(byte i = 0; i < count; ++i) {
+		unsigned int index = first + i;
+		unsigned long value = values[index / 2];
+		setModbusWord(3 + 2 * i,
+			index % 2 == 0 ? value >> 16 : value & 0xFFFF);
+	}
+	return 3 + 2 * count;
+}
+
+#if SERIAL_COMMANDS
+// Does the request in the modbusFrame, whose length without the CRC is
+// given, for writing the holding registers: A single one if single is
+// true, otherwise multiple ones. Returns the length of the answer
+// without the CRC, see answerModbusRequest().
+// The registers of a value must be written together, so it is never
+// half changed - or only the one with its lowest 16 bits, which sets
+// the highest ones to 0, so a single register is enough for the
+// measurement seconds and the debounce microseconds.
+// Changes the settings, which are stored in the EEPROM, as "set" of
+// SERIAL_COMMANDS does. A new speed is taken once the answer has been
+// sent.
+byte writeModbusRegisters(byte length, bool single) {
+	unsigned int first = modbusWord(2);
+	// A single register has its value where the count is otherwise.
+	unsigned int count = single ? 1 : modbusWord(4);
+	byte data = single ? 4 : 7;
+	if(single ? length != 6
+			: count == 0 || length != 7 + 2 * count
+				|| modbusFrame[6] != 2 * count)
+		return modbusException(modbusIllegalDataValue);
+	if(first % 2 != 0 ? count != 1 : count % 2 != 0)
+		return modbusException(modbusIllegalDataAddress);
+	if(first >= 2 * modbusWritableValues
+			|| count > 2 * modbusWritableValues - first)
+		return modbusException(modbusIllegalDataAddress);
+
+	unsigned long values[modbusHoldingValues];
+	readModbusHoldingValues(values);
+	for(byte i = 0; i < count; i += 2) {
+		byte position = data + 2 * i;
+		values[(first + i) / 2] = first % 2 != 0 ? modbusWord(position)
+			: (unsigned long)modbusWord(position) << 16
+				| modbusWord(position + 2);
+	}
+	if(!measurementSecondsValid(values[0])
+			|| !debounceMicrosValid(values[1]) || !baudValid(values[2]))
+		return modbusException(modbusIllegalDataValue);
+
+	applySettings(values[0], values[1]);
+	if(values[2] != serialBaud) {
+		serialBaud = values[2];
+		serialBaudPending = true;
+	}
+	saveSettings();
+	// The answer is the request up to the count, which is all of it for
+	// a single register.
+	return 6;
+}
+#endif
+
+// Does the request in the modbusFrame, whose length without the CRC is
+// given, and replaces it by the answer. Returns the length of the
+// answer without the CRC. The address stays the same.
+byte answerModbusRequest(byte length) {
+	byte function = modbusFrame[1];
+	if(function == modbusReadHoldingRegisters
+			|| function == modbusReadInputRegisters)
+		return readModbusRegisters(length,
+			function == modbusReadInputRegisters);
+#if SERIAL_COMMANDS
+	if(function == modbusWriteSingleRegister
+			|| function == modbusWriteMultipleRegisters)
+		return writeModbusRegisters(length,
+			function == modbusWriteSingleRegister);
+#endif
+	return modbusException(modbusIllegalFunction);
+}
+
+// Task which answers the request which the interrupts have received,
+// see OUTPUT_FORMAT_MODBUS. Requests with transmission errors, i.e.
+// with a wrong CRC or parity, and those to other devices are ignored,
+// as are broadcasts except for writing the settings.
+// Instead of sendOutput(), as Modbus only sends answers.
+void handleModbus() {
+#if SERIAL_COMMANDS
+	// Not while an answer is being sent at the old speed.
+	if(serialBaudPending && modbusState == modbusReceiving) {
+		serialBaudPending = false;
+		setupModbus();
+	}
+#endif
+	if(modbusState != modbusReceived)
+		return;
+
+	// The shortest request is the address, function and the 2 bytes of
+	// the CRC.
+	byte length = modbusLength;
+	if(modbusFrameError || length < 4) {
+		receiveModbus();
+		return;
+	}
+	unsigned int crc = 0xFFFF;
+	for(byte i = 0; i < length - 2; ++i)
+		crc = _crc16_update(crc, modbusFrame[i]);
+	byte address = modbusFrame[0];
+	if(modbusFrame[length - 2] != (crc & 0xFF)
+			|| modbusFrame[length - 1] != crc >> 8
+			|| (address != MODBUS_ADDRESS
+				&& address != modbusBroadcastAddress)) {
+		receiveModbus();
+		return;
+	}
+
+	length = answerModbusRequest(length - 2);
+	if(address == modbusBroadcastAddress) {
+		receiveModbus();
+		return;
+	}
+
+	// The CRC is sent lowest byte first, unlike the other numbers.
+	crc = 0xFFFF;
+	for(byte i = 0; i < length; ++i)
+		crc = _crc16_update(crc, modbusFrame[i]);
+	modbusFrame[length] = crc & 0xFF;
+	modbusFrame[length + 1] = crc >> 8;
+	modbusLength = length + 2;
+	modbusSendPosition = 0;
+	modbusState = modbusSending;
+
+#if MODBUS_DE_PIN
+	writePin(MODBUS_DE_PIN, true);
+#endif
+	// The receiver is off while sending, as the RS-485 transceiver would
+	// otherwise receive the answer as well. USART_UDRE_vect sends the
+	// bytes then.
+	UCSR0B = (UCSR0B & ~_BV(RXEN0)) | _BV(UDRIE0);
+}
+
+#endif
+
+#if I2C_ADDRESS
+
+// Bits of the flags of the I2cSnapshot. The same as the
+// binaryReportFlag... values of OUTPUT_FORMAT_BINARY.
+const byte i2cFlagReciprocal = 1;
+const byte i2cFlagDebounceTooHigh = 2;
+const byte i2cFlagTimestampsLost = 4;
+const byte i2cFlagCountsOverflowed = 16;
+// There is a GUST_ALERT.
+const byte i2cFlagGustAlert = 32;
+
+// The states of the I2C bus after which TWI_vect is called, as in TWSR,
+// see the ATmega328P datasheet: The master has started writing to this
+// address, it has written a byte, it has started reading from this
+// address, and it has read a byte and wants the next one.
+// Everything else ends what the master was doing, e.g. when it has
+// read the last byte it wants, or it is a bus error.
+const byte i2cWriteStarted = 0x60;
+const byte i2cByteReceived = 0x80;
+const byte i2cReadStarted = 0xA8;
+const byte i2cByteSent = 0xB8;
+const byte i2cBusError = 0x00;
+
+// Sets up the I2C hardware ("TWI") as a slave with the I2C_ADDRESS.
+// The master sets the speed, the hardware works with up to 400 kHz.
+// Called by setup().
+void setupI2c() {
+	// Without TWGCE, so it doesn't answer to the "general call" to
+	// address 0.
+	TWAR = I2C_ADDRESS << 1;
+	TWCR = _BV(TWEA) | _BV(TWEN) | _BV(TWIE);
+}
+
+// Called by the I2C hardware for every step of the master, see
+// i2cWriteStarted. Until this finishes the hardware keeps SCL LOW, so
+// the master waits ("clock stretching").
+ISR(TWI_vect) {
+	byte status = TWSR & 0xF8;
+	// Clears TWINT, which tells the hardware to continue, and answers
+	// to the next byte or to the address if TWEA is set.
+	byte control = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE);
+
+	if(status == i2cWriteStarted)
+		i2cPositionExpected = true;
+	else if(status == i2cByteReceived) {
+		// Only the first byte is used, there is nothing to write.
+		if(i2cPositionExpected)
+			i2cStartPosition = TWDR;
+		i2cPositionExpected = false;
+	} else if(status == i2cReadStarted || status == i2cByteSent) {
+		if(status == i2cReadStarted) {
+			// Stays the same until the master stops reading, even if
+			// updateI2cSnapshot() switches i2cPublished meanwhile.
+			i2cSending = i2cPublished;
+			i2cSendPosition = i2cStartPosition;
+		}
+		byte position = i2cSendPosition;
+		if(position < sizeof(I2cSnapshot)) {
+			TWDR = ((const byte *)&i2cSnapshots[i2cSending])[position];
+			i2cSendPosition = position + 1;
+		} else
+			TWDR = 0xFF;
+	} else {
+		i2cSending = i2cNoSnapshot;
+		i2cPositionExpected = false;
+		// Releases the bus, or it may stay stuck.
+		if(status == i2cBusError)
+			control |= _BV(TWSTO);
+	}
+
+	TWCR = control;
+}
+
+// Task which puts the last finished measurement into the i2cSnapshots
+// when there is a new one, see I2cSnapshot.
+// It writes into the one which the master doesn't read, and only then
+// tells the interrupt to send that one instead. But the master may
+// still be reading the other one if it started before, e.g. if it
+// reads very slowly or there was a GUST_ALERT just after the last
+// measurement. Then this waits until it has finished.
+void updateI2cSnapshot() {
+	if(!i2cSnapshotPending)
+		return;
+	byte next = i2cPublished ^ 1;
+	// The interrupt only switches to i2cPublished, so it cannot start
+	// sending the next one after this.
+	if(i2cSending == next)
+		return;
+	i2cSnapshotPending = false;
+
+	I2cSnapshot &snapshot = i2cSnapshots[next];
+	snapshot.sequence = reportSequence;
+	snapshot.endUptimeSeconds = reportEndUptimeTicks / pulseTicksPerSecond;
+	snapshot.measurementMillis = reportMeasurementMillis;
+	snapshot.pulseCount = reportPulseCounts[0];
+	// There is no measurement yet if it is 0.
+	snapshot.milliPulsesPerSecond
+		= reportMeasurementMillis > 0 ? milliPulsesPer(1) : 0;
+	snapshot.windMillimetersPerSecond
+		= windMillimetersPerSecond(snapshot.milliPulsesPerSecond);
+
+	StatisticsResult statistics = { 0, 0, 0, 0 };
+#if MOVING_STATISTICS
+	computeStatistics(statistics);
+#endif
+	snapshot.meanMilliPulsesPerSecond = statistics.mean;
+	snapshot.stddevMilliPulsesPerSecond = statistics.stddev;
+	snapshot.gustMilliPulsesPerSecond = statistics.gust;
+	snapshot.meanWindMillimetersPerSecond
+		= windMillimetersPerSecond(statistics.mean);
+	snapshot.gustWindMillimetersPerSecond
+		= windMillimetersPerSecond(statistics.gust);
+
+	snapshot.flags = 0;
+	if(reportReciprocal)
+		snapshot.flags |= i2cFlagReciprocal;
+	if(snapshot.milliPulsesPerSecond >= sensorMaxMilliPulsesPerSecond)
+		snapshot.flags |= i2cFlagDebounceTooHigh;
+	if(reportTimestampsLost > 0)
+		snapshot.flags |= i2cFlagTimestampsLost;
+	if(reportCountsOverflowed)
+		snapshot.flags |= i2cFlagCountsOverflowed;
+#if GUST_ALERT
+	if(gustAlertActive)
+		snapshot.flags |= i2cFlagGustAlert;
+#endif
+
+	snapshot.numberOfChannels = channelCount;
+	for(byte channel = 0; channel < channelCount; ++channel) {
+		snapshot.channels[channel].pulseCount = reportPulseCounts[channel];
+		snapshot.channels[channel].milliPulsesPerSecond
+			= reportMeasurementMillis > 0
+			? channelMilliPulsesPerSecond(channel) : 0;
+	}
+
+	const byte *bytes = (const byte *)&snapshot;
+	unsigned int crc = 0xFFFF;
+	for(byte i = 0; i < sizeof(snapshot) - sizeof(snapshot.crc); ++i)
+		crc = _crc16_update(crc, bytes[i]);
+	snapshot.crc = crc;
+
+	// The ATOMIC_BLOCK also makes sure that the compiler has written all
+	// of the snapshot before, instead of moving some of it behind this.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		i2cPublished = next;
+	}
+}
+
+#endif
+
+// Returns a * b / c.
+// a * b can be larger than an unsigned long, so the multiplication is
+// done with 64 bits. The result must fit into an unsigned long.
+unsigned long multiplyDivide(unsigned long a, unsigned long b,
+		unsigned long c) {
+	return (unsigned long long)a * b / c;
+}
+
+// Returns the square root of the given number, rounded down.
+// Computes one bit of the result after the other, from the highest to
+// the lowest, by checking whether the square would become too large if
+// the bit was set.
+unsigned long integerSquareRoot(unsigned long long number) {
+	unsigned long result = 0;
+	
+	for(unsigned long bit = 1UL << 31; bit != 0; bit >>= 1) {
+		unsigned long candidate = result | bit;
+		if((unsigned long long)candidate * candidate <= number)
+			result = candidate;
+	}
+	
+	return result;
+}
+
+// Converts milli pulses per second of the Sensor to the wind speed in
+// millimeters per second by the windCalibration. Finds the two points
+// of the table between which the rotations per second are, and
+// interpolates linearly between their wind speeds. Above the last
+// point the line through the last two points is continued.
+// The table is searched from the start, which is fast enough for a
+// dozen points and only done for each report, and for each sample with
+// GUST_ALERT.
+unsigned long windMillimetersPerSecond(unsigned long milliPulsesPerSecond) {
+	unsigned long milliRotationsPerSecond
+		= milliPulsesPerSecond / Sensor::pulsesPerRotationCount;
+	
+	// Find the first point above the speed, or the last point.
+	byte point = 1;
+	while(point < windCalibrationPoints - 1 && milliRotationsPerSecond
+			> pgm_read_word(&windCalibration[point].milliRotationsPerSecond))
+		++point;
+	
+	const WindCalibrationPoint *lower = &windCalibration[point - 1];
+	const WindCalibrationPoint *upper = &windCalibration[point];
+	unsigned int lowerRotations
+		= pgm_read_word(&lower->milliRotationsPerSecond);
+	unsigned int lowerSpeed = pgm_read_word(&lower->millimetersPerSecond);
+	unsigned int upperRotations
+		= pgm_read_word(&upper->milliRotationsPerSecond);
+	unsigned int upperSpeed = pgm_read_word(&upper->millimetersPerSecond);
+	
+	// Can't be below lowerRotations because the table starts with 0.
+	return lowerSpeed + multiplyDivide(
+		milliRotationsPerSecond - lowerRotations,
+		upperSpeed - lowerSpeed, upperRotations - lowerRotations);
+}
+
+// Returns a CRC-8 of the given bytes, for telling whether they were
+// stored in the EEPROM by this program, see LogRecord.
+byte eepromCheck(const void *data, byte length) {
+	const byte *bytes = (const byte *)data;
+	byte crc = 0;
+	for(byte i = 0; i < length; ++i)
+		crc = _crc8_ccitt_update(crc, bytes[i]);
+	// Inverted so bytes which are all 0x00 aren't valid.
+	return ~crc;
+}
+
+// Prints the given number of milli units with displayedDecimals
+// decimals, followed by a line break. For example 1234 with 2
+// decimals is printed as "1.23".
+// The last decimal is rounded, just like Serial.println() does for
+// floating point numbers.
+void printMilli(unsigned long milli) {
+	// Number of milli units per last displayed decimal, i.e. 10 ^ (3 -
+	// displayedDecimals).
+	unsigned long unit = 1;
+	for(int i = displayedDecimals; i < 3; ++i)
+		unit *= 10;
+	
+	unsigned long rounded = (milli + unit / 2) / unit;
+	unsigned long factor = 1000 / unit;
+	
+	output.print(rounded / factor);
+	
+	if(displayedDecimals > 0) {
+		output.print('.');
+		// Print leading zeros of the decimals, e.g. the 0 of "1.05".
+		unsigned long decimals = rounded % factor;
+		for(unsigned long digit = factor / 10; digit > decimals
+				&& digit > 1; digit /= 10)
+			output.print('0');
+		output.print(decimals);
+	}
+	
+	output.println();
+}
+
+// The Arduino Uno has 2048 bytes of RAM. The variables are at its
+// start and the stack grows down from its end, so if the variables
+// take too much the stack overwrites them while the program runs,
+// which causes strange bugs instead of an error. Thus the larger
+// buffers of the features are added up here, and the program doesn't
+// compile if they leave too little for the rest. This is at the end of
+// the program so all variables are declared.
+// The buffers of each feature in bytes, 0 if it is disabled. This
+// shows what each feature costs. For all variables of a build, run
+//     avr-nm --size-sort -S -C eltako-windsensor-ws.ino.elf
+// on the file which "Sketch / Export compiled Binary" creates. And
+// HEALTH_REPORT shows how much RAM was never used while running.
+const unsigned int ramOutputQueueBytes = sizeof(output);
+const unsigned int ramChannelsBytes
+	= sizeof(pulseCounters) + sizeof(reportPulseCounts);
+#if PULSE_TIMESTAMP_BUFFER_SIZE > 0
+const unsigned int ramTimestampsBytes = sizeof(pulseTimestamps);
+#else
+const unsigned int ramTimestampsBytes = 0;
+#endif
+#if PULSE_HISTOGRAM
+const unsigned int ramHistogramBytes = sizeof(histogramCounts);
+#else
+const unsigned int ramHistogramBytes = 0;
+#endif
+#if PULSE_TRACE
+const unsigned int ramTraceBytes = sizeof(traceEdges) + sizeof(traceFrame);
+#else
+const unsigned int ramTraceBytes = 0;
+#endif
+#if MOVING_STATISTICS
+const unsigned int ramStatisticsBytes = sizeof(statisticsGustRing)
+	+ sizeof(statisticsBlockRing) + sizeof(statisticsMaxQueueBlock)
+	+ sizeof(statisticsMaxQueueValue);
+#else
+const unsigned int ramStatisticsBytes = 0;
+#endif
+#if GUST_ALERT
+const unsigned int ramGustAlertBytes
+	= sizeof(gustAlertCounts) + sizeof(gustAlertLastPulses);
+#else
+const unsigned int ramGustAlertBytes = 0;
+#endif
+#if REPORT_INTERVAL_SECONDS
+const unsigned int ramReportWindowBytes
+	= sizeof(reportIntervals) + sizeof(reportWindowCounts);
+#else
+const unsigned int ramReportWindowBytes = 0;
+#endif
+#if TIME_SYNC
+const unsigned int ramTimeSyncBytes = sizeof(timeSynchronized)
+	+ sizeof(syncHostMillis) + sizeof(syncUptimeTicks)
+	+ sizeof(driftHostMillis) + sizeof(driftUptimeTicks)
+	+ sizeof(clockCorrectionPpb) + sizeof(measurementStartUptime)
+	+ sizeof(reportStartUnixMillis) + sizeof(reportEndUnixMillis);
+#else
+const unsigned int ramTimeSyncBytes = 0;
+#endif
+#if EEPROM_LOG
+const unsigned int ramLogBytes = sizeof(logRecord) + sizeof(logNextSlot)
+	+ sizeof(logRecordWritten) + sizeof(logDumpSlot)
+	+ sizeof(logDumpSlotsLeft) + sizeof(logDumpFromSequence)
+	+ sizeof(logDumpRecordsSent) + sizeof(logDumping);
+#else
+const unsigned int ramLogBytes = 0;
+#endif
+#if COMMAND_LINES
+const unsigned int ramCommandsBytes
+	= sizeof(commandLine) + sizeof(commandLength);
+#else
+const unsigned int ramCommandsBytes = 0;
+#endif
+#if INSTRUMENTATION
+const unsigned int ramInstrumentationBytes = sizeof(isrCycles)
+	+ sizeof(criticalSectionCycles)
+#if PULSE_INPUT == PULSE_INPUT_TIMER1_CAPTURE
+	+ sizeof(isrLatencyCycles)
+#endif
+	+ sizeof(reportIsrCycles) + sizeof(reportIsrLatencyCycles)
+	+ sizeof(reportCriticalSectionCycles);
+#else
+const unsigned int ramInstrumentationBytes = 0;
+#endif
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+const unsigned int ramModbusBytes = sizeof(modbusFrame);
+#else
+const unsigned int ramModbusBytes = 0;
+#endif
+#if I2C_ADDRESS
+const unsigned int ramI2cBytes = sizeof(i2cSnapshots);
+#else
+const unsigned int ramI2cBytes = 0;
+#endif
+
+const unsigned int ramBuffersBytes = ramOutputQueueBytes
+	+ ramChannelsBytes + ramTimestampsBytes + ramHistogramBytes
+	+ ramTraceBytes + ramStatisticsBytes + ramGustAlertBytes
+	+ ramReportWindowBytes + ramTimeSyncBytes + ramLogBytes
+	+ ramCommandsBytes + ramInstrumentationBytes + ramModbusBytes
+	+ ramI2cBytes;
+
+// The RAM which the rest needs: ~ 170 bytes for the Arduino software,
+// mostly the buffers of Serial for sending and receiving, and up to
+// ~ 250 bytes for the small variables of this program which are not
+// counted above, e.g. the measurement and the tasks. Added up from
+// their types, those are ~ 160 bytes with the defaults, and each
+// further feature adds a few.
+const unsigned int ramOtherBytes = 170 + 250;
+// What must remain for the stack at least: Each call of a function
+// which hasn't returned yet needs a few bytes up to ~ 40 for its
+// variables and the registers it saved, e.g. printing a number needs
+// a buffer of 33 bytes, and an interrupt can happen at the deepest one
+// and needs ~ 40 more.
+const unsigned int ramStackReserveBytes = 256;
+
+#ifndef HOST_HARNESS
+// Not on a PC, where unsigned long and pointers are larger.
+static_assert(ramBuffersBytes + ramOtherBytes + ramStackReserveBytes
+		<= RAMEND - RAMSTART + 1,
+	"The enabled features need too much RAM, see ramBuffersBytes");
+#endif
+
+// The flash is not checked here: The Arduino software does it when
+// compiling. It prints "Sketch uses ... bytes ... of program storage
+// space. Maximum is 32256 bytes.", the 32 KB minus 512 bytes for the
+// bootloader, and refuses to upload a larger program. For a build with
+// other tools
+//     avr-size -C --mcu=atmega328p eltako-windsensor-ws.ino.elf
+// shows it as "Program", which must not be above 32256 bytes either.
+// Check each BUILD_PROFILE like this after adding a feature, see
+// test/host-harness.cpp for the RAM.
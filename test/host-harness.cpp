@@ -0,0 +1,2714 @@
+// Runs the code of eltako-windsensor-ws.c on a PC instead of the
+// Arduino, to check whether it measures correctly and how quickly it
+// processes the pulses - in seconds, instead of with a paper clip on a
+// bench.
+//
+// Compile and run it in the main folder of the repository with:
+//     g++ -std=gnu++11 -O2 -Wall -o host-harness test/host-harness.cpp
+//     ./host-harness
+// That runs all tests, see tests[], prints which ones failed and
+// returns 1 if any did. The configuration of the sketch can be changed
+// with the same macros as on the Arduino, e.g. add
+// -DDEBOUNCE_STRATEGY=2 to test DEBOUNCE_STABLE, or -DBUILD_PROFILE=2
+// for BUILD_PROFILE_TELEMETRY. Add -v to the command to also see what
+// the sketch sends via Serial.
+// Further commands:
+//     ./host-harness replay pulses.txt
+// feeds a pulse train to the sketch and prints its reports, see
+// replay().
+//     ./host-harness replay-trace trace.bin
+// does the same with a trace which was recorded with PULSE_TRACE, see
+// replayTrace().
+//     ./host-harness benchmark
+// measures how long processing a pulse takes, see benchmark().
+//     ./host-harness budget
+// prints how much RAM the buffers of each feature need, see budget().
+// Compile it with the macros of a build, e.g. -DBUILD_PROFILE=3, to see
+// what they cost before compiling for the Arduino.
+//
+// How it works: This file provides replacements for the parts of the
+// Arduino software and of avr-libc which the sketch uses, i.e.
+// millis(), micros(), Serial and the registers, and then includes the
+// sketch, so the very same code is tested. The ISR()s become normal
+// functions which setPin() calls when the pin changes, according to
+// the registers which the sketch configured, just like the hardware.
+// Each test runs in its own process, via fork(), so it starts with the
+// sketch in the state after a reset.
+//
+// Limits of the simulation:
+// - Interrupts only happen between two passes of loop(), never during
+//   one. So this cannot find problems of the ATOMIC_BLOCKs.
+// - int has 32 bits on a PC instead of 16, so overflows of 16 bit
+//   values cannot be reproduced, e.g. of a PulseCount with
+//   PULSE_COUNTER_BITS 16. unsigned long has 64 bits instead of 32 on
+//   most PCs, so millis() and micros() only overflow at 2^64 there,
+//   which the "wrap" test takes into account. Compile with -m32 to get
+//   32 bits as on the Arduino.
+// - The times of benchmark() are of the PC, not of the Arduino. They are
+//   only useful for comparing versions of the code with each other. See
+//   INSTRUMENTATION for measuring the CPU cycles on the Arduino.
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Replacements of the Arduino software and avr-libc.
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define F_CPU 16000000UL
+#define _BV(bit) (1 << (bit))
+
+// The numbers of the bits of the registers, as in the ATmega328P
+// datasheet.
+#define PORTB5 5
+#define ISC00 0
+#define ISC01 1
+#define INT0 0
+#define INT1 1
+#define INTF0 0
+#define PCIE0 0
+#define PCIF0 0
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define ICES1 6
+#define ICNC1 7
+#define ICIE1 5
+#define TOIE1 0
+#define ICF1 5
+#define TOV1 0
+#define ADEN 7
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define U2X0 1
+#define UPE0 2
+#define DOR0 3
+#define FE0 4
+#define TXC0 6
+#define TXEN0 3
+#define RXEN0 4
+#define UDRIE0 5
+#define TXCIE0 6
+#define RXCIE0 7
+#define UCSZ00 1
+#define UCSZ01 2
+#define UPM01 5
+#define WGM21 1
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define OCIE2A 1
+#define OCF2A 1
+#define TWIE 0
+#define TWEN 2
+#define TWSTO 4
+#define TWEA 6
+#define TWINT 7
+
+// Registers which just store what is written to them.
+volatile uint8_t DDRB, DDRC, DDRD;
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t EICRA, EIMSK, PCICR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+volatile uint16_t ICR1;
+volatile uint8_t ADCSRA;
+volatile uint8_t MCUSR;
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C;
+volatile uint16_t UBRR0;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2;
+volatile uint8_t TWAR, TWCR, TWDR, TWSR;
+
+// A register of interrupt flags, e.g. EIFR: Writing a 1 to a bit
+// clears it.
+class FlagRegister {
+public:
+	operator uint8_t() const {
+		return value;
+	}
+	FlagRegister &operator=(uint8_t bits) {
+		value &= ~bits;
+		return *this;
+	}
+	uint8_t value = 0;
+};
+
+FlagRegister EIFR, PCIFR, TIFR1, TIFR2;
+
+// A PINx register: Reading it returns the levels of the pins of the
+// port, which setPin() changes. Writing a 1 to a bit inverts the bit of
+// the PORTx register, see registerPulse().
+class PinRegister {
+public:
+	PinRegister(volatile uint8_t &port) : port(port) {}
+	operator uint8_t() const {
+		return levels;
+	}
+	PinRegister &operator=(uint8_t bits) {
+		port ^= bits;
+		return *this;
+	}
+	// All pins are HIGH by the pull-up resistors until setPin()
+	// changes them.
+	uint8_t levels = 0xFF;
+private:
+	volatile uint8_t &port;
+};
+
+PinRegister PINB(PORTB), PINC(PORTC), PIND(PORTD);
+
+// The simulated time in microseconds since the start.
+// Is only changed by advanceTime().
+unsigned long long simulatedMicros = 0;
+// Added to the results of millis() and micros(), to test what happens
+// when they overflow, see testWrap().
+unsigned long millisOffset = 0;
+unsigned long microsOffset = 0;
+
+unsigned long millis() {
+	return millisOffset + (unsigned long)(simulatedMicros / 1000);
+}
+
+// Like on the Arduino in steps of 4 microseconds.
+unsigned long micros() {
+	return (microsOffset + (unsigned long)simulatedMicros) & ~3UL;
+}
+
+// Returns the number of CPU cycles per count of Timer1, according to
+// TCCR1B, or 0 if it is stopped.
+unsigned long timer1Prescaler() {
+	static const unsigned int prescalers[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+	return prescalers[TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))];
+}
+
+// The CPU cycle at which TCNT1 was 0, and the number of overflows of
+// Timer1 since then for which advanceTime() has called the interrupt.
+unsigned long long timer1StartCycle = 0;
+unsigned long long timer1OverflowsDone = 0;
+
+unsigned long long currentCycle() {
+	return simulatedMicros * (F_CPU / 1000000);
+}
+
+// The TCNT1 register, i.e. the counter of Timer1, which counts with the
+// simulated time.
+class Timer1Counter {
+public:
+	operator unsigned int() const {
+		unsigned long prescaler = timer1Prescaler();
+		if(prescaler == 0)
+			return 0;
+		return (uint16_t)((currentCycle() - timer1StartCycle) / prescaler);
+	}
+	Timer1Counter &operator=(unsigned int value) {
+		timer1StartCycle = currentCycle() - value * timer1Prescaler();
+		timer1OverflowsDone = 0;
+		return *this;
+	}
+};
+
+Timer1Counter TCNT1;
+
+// Returns the number of CPU cycles per count of Timer2, according to
+// TCCR2B, or 0 if it is stopped.
+unsigned long timer2Prescaler() {
+	static const unsigned int prescalers[8]
+		= { 0, 1, 8, 32, 64, 128, 256, 1024 };
+	return prescalers[TCCR2B & (_BV(CS22) | _BV(CS21) | _BV(CS20))];
+}
+
+// The CPU cycle at which TCNT2 was 0, and the number of matches of
+// OCR2A since then for which advanceTime() has called the interrupt.
+// Only the matches while the interrupt is enabled are counted, which is
+// enough because the sketch sets TCNT2 before enabling it.
+unsigned long long timer2StartCycle = 0;
+unsigned long long timer2MatchesDone = 0;
+
+// The TCNT2 register, of which the sketch only sets the counter to
+// restart it.
+class Timer2Counter {
+public:
+	Timer2Counter &operator=(uint8_t value) {
+		timer2StartCycle = currentCycle() - value * timer2Prescaler();
+		timer2MatchesDone = 0;
+		return *this;
+	}
+};
+
+Timer2Counter TCNT2;
+
+// The serial port with OUTPUT_FORMAT_MODBUS, which sends and receives
+// bytes of 11 bits at the speed of UBRR0, to and from the master which
+// the tests simulate. Serial is separate from it, as the sketch only
+// uses one of both.
+// The byte which UDR0 returns, i.e. the last one received.
+byte usartReceived = 0;
+void usartTransmit(byte value);
+
+// The UDR0 register: Reading it returns the byte which has been
+// received, writing it sends a byte, see usartTransmit().
+class UsartData {
+public:
+	operator uint8_t() const {
+		return usartReceived;
+	}
+	UsartData &operator=(uint8_t value) {
+		usartTransmit(value);
+		return *this;
+	}
+};
+
+UsartData UDR0;
+
+// The interrupts are called by the harness directly, so ISR() just
+// defines a function. They are declared "weak" below so the harness can
+// check whether the sketch defined them.
+#define ISR(vector) extern "C" void vector()
+
+extern "C" {
+	void INT0_vect() __attribute__((weak));
+	void INT1_vect() __attribute__((weak));
+	void PCINT0_vect() __attribute__((weak));
+	void PCINT1_vect() __attribute__((weak));
+	void PCINT2_vect() __attribute__((weak));
+	void TIMER1_CAPT_vect() __attribute__((weak));
+	void TIMER1_OVF_vect() __attribute__((weak));
+	void TIMER2_COMPA_vect() __attribute__((weak));
+	void USART_RX_vect() __attribute__((weak));
+	void USART_UDRE_vect() __attribute__((weak));
+	void USART_TX_vect() __attribute__((weak));
+	void TWI_vect() __attribute__((weak));
+}
+
+// Interrupts never happen during the code of the sketch, see the top of
+// this file, so this only needs to run its code once.
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_BLOCK(type) \
+	for(bool atomicBlockOnce = true; atomicBlockOnce; atomicBlockOnce = false)
+
+// What avr-libc computes for the CRC-16/MODBUS, see sendFrame().
+uint16_t _crc16_update(uint16_t crc, uint8_t value) {
+	crc ^= value;
+	for(byte i = 0; i < 8; ++i)
+		crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	return crc;
+}
+
+// Sleeping is never needed because the harness calls loop() at the
+// simulated times anyway.
+#define SLEEP_MODE_IDLE 0
+void set_sleep_mode(byte) {}
+void sleep_mode() {}
+void power_adc_disable() {}
+void power_spi_disable() {}
+void power_twi_disable() {}
+void power_timer1_disable() {}
+void power_timer2_disable() {}
+
+// The watchdog, which only records what the sketch does with it: The
+// timeout it enabled, -1 while it is disabled, and the longest time
+// between two wdt_reset() while it was enabled.
+#define WDTO_4S 8
+int watchdogEnabledTimeout = -1;
+unsigned long long watchdogLastResetMicros = 0;
+unsigned long long watchdogLongestMicros = 0;
+void wdt_enable(byte timeout) {
+	watchdogEnabledTimeout = timeout;
+	watchdogLastResetMicros = simulatedMicros;
+}
+void wdt_disable() {
+	watchdogEnabledTimeout = -1;
+}
+void wdt_reset() {
+	if(simulatedMicros - watchdogLastResetMicros > watchdogLongestMicros)
+		watchdogLongestMicros = simulatedMicros - watchdogLastResetMicros;
+	watchdogLastResetMicros = simulatedMicros;
+}
+
+// The free RAM between the variables and the stack, see paintStack():
+// The stack pointer is at its end, as the stack of the sketch actually
+// is the one of the PC.
+byte freeRam[256];
+#define __heap_start freeRam[0]
+byte *__brkval = 0;
+uintptr_t SP = (uintptr_t)(freeRam + sizeof(freeRam));
+
+// The CRC-8 which avr-libc computes, see logRecordCheck().
+uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t value) {
+	crc ^= value;
+	for(byte i = 0; i < 8; ++i)
+		crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+	return crc;
+}
+
+// The EEPROM, which is ready for writing at any time. Starts empty, as
+// on a new Arduino, see main().
+#define E2END 1023
+byte eeprom[E2END + 1];
+
+void eeprom_read_block(void *destination, const void *source, size_t size) {
+	memcpy(destination, eeprom + (uintptr_t)source, size);
+}
+void eeprom_update_byte(byte *address, byte value) {
+	eeprom[(uintptr_t)address] = value;
+}
+void eeprom_update_block(const void *source, void *destination,
+		size_t size) {
+	memcpy(eeprom + (uintptr_t)destination, source, size);
+}
+int eeprom_is_ready() {
+	return 1;
+}
+
+// A PC has no separate flash memory, so the tables which the sketch
+// keeps there are normal variables. The values of windCalibration are
+// unsigned int, which has 32 bits on a PC, so they are read with their
+// own type instead of with 16 bits.
+#define PROGMEM
+#define pgm_read_word(address) (*(address))
+
+// Like the Print class of the Arduino software, which is the base of
+// Serial and OutputQueue, with the functions which the sketch uses.
+class Print {
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t value) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		size_t written = 0;
+		while(size-- > 0)
+			written += write(*buffer++);
+		return written;
+	}
+	size_t write(const char *text) {
+		return write((const uint8_t *)text, strlen(text));
+	}
+
+	size_t print(const char *text) {
+		return write(text);
+	}
+	size_t print(char c) {
+		return write((uint8_t)c);
+	}
+	size_t print(unsigned char number, int base = DEC) {
+		return printNumber(number, false, base);
+	}
+	size_t print(int number, int base = DEC) {
+		return printNumber(number < 0 ? -(long long)number : number,
+			number < 0, base);
+	}
+	size_t print(unsigned int number, int base = DEC) {
+		return printNumber(number, false, base);
+	}
+	size_t print(long number, int base = DEC) {
+		return printNumber(number < 0 ? -(long long)number : number,
+			number < 0, base);
+	}
+	size_t print(unsigned long number, int base = DEC) {
+		return printNumber(number, false, base);
+	}
+
+	size_t println() {
+		return write("\r\n");
+	}
+	template<typename Value>
+	size_t println(Value value) {
+		return print(value) + println();
+	}
+	template<typename Value>
+	size_t println(Value value, int base) {
+		return print(value, base) + println();
+	}
+
+private:
+	size_t printNumber(unsigned long long number, bool negative, int base) {
+		char text[32];
+		snprintf(text, sizeof(text), base == HEX ? "%s%llX" : "%s%llu",
+			negative ? "-" : "", number);
+		return write(text);
+	}
+};
+
+// Serial, which can always send immediately. What the sketch sends is
+// collected in serialOutput, and printed if printSerialOutput is true.
+class HardwareSerial : public Print {
+public:
+	void begin(unsigned long speed) {
+		baud = speed;
+	}
+	void flush() {}
+	int availableForWrite() {
+		return 63;
+	}
+	virtual size_t write(uint8_t value) {
+		return write(&value, 1);
+	}
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		serialOutput.append((const char *)buffer, size);
+		if(printSerialOutput)
+			fwrite(buffer, 1, size, stdout);
+		return size;
+	}
+	using Print::write;
+
+	// What the PC sends is taken from serialInput, starting at the
+	// simulated time serialInputMicros.
+	// Further lines from laterInput are added to it at their times.
+	int available() {
+		if(simulatedMicros < serialInputMicros)
+			return 0;
+		while(!laterInput.empty()
+				&& laterInput.front().first <= simulatedMicros) {
+			serialInput += laterInput.front().second;
+			laterInput.erase(laterInput.begin());
+		}
+		return serialInput.size();
+	}
+	int read() {
+		if(available() == 0)
+			return -1;
+		byte value = serialInput[0];
+		serialInput.erase(0, 1);
+		return value;
+	}
+
+	std::string serialOutput;
+	bool printSerialOutput = false;
+	unsigned long baud = 0;
+	std::string serialInput;
+	unsigned long long serialInputMicros = 0;
+	std::vector<std::pair<unsigned long long, std::string>> laterInput;
+};
+
+HardwareSerial Serial;
+
+// The sketch itself, which uses the above instead of the Arduino.
+#define HOST_HARNESS 1
+#include "../eltako-windsensor-ws.c"
+
+// The simulation.
+
+// A change of the level of a pin at the given simulated time.
+struct Edge {
+	unsigned long long micros;
+	byte pin;
+	bool high;
+};
+
+// Number of times that the interrupt of an edge had to be called, but
+// the sketch didn't define an ISR() for it. On the Arduino that would
+// restart it.
+unsigned long missingInterrupts = 0;
+
+void callInterrupt(void (*vector)()) {
+	if(vector)
+		vector();
+	else
+		++missingInterrupts;
+}
+
+// Sets the pin to the given level, and calls the ISR()s which the
+// hardware would call for that change, according to the registers.
+void setPin(byte pin, bool high) {
+	PinRegister &port = pin < 8 ? PIND : pin < 14 ? PINB : PINC;
+	byte portBit = pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14;
+	if((bool)(port.levels & _BV(portBit)) == high)
+		return;
+	if(high)
+		port.levels |= _BV(portBit);
+	else
+		port.levels &= ~_BV(portBit);
+
+	// External interrupts, see interruptSenseBits().
+	if(pin == 2 || pin == 3) {
+		byte number = pin - 2;
+		byte sense = (EICRA >> (2 * number)) & (_BV(ISC01) | _BV(ISC00));
+		if((EIMSK & _BV(number))
+				&& (sense == _BV(ISC00)
+					|| sense == (high ? _BV(ISC01) | _BV(ISC00) : _BV(ISC01))))
+			callInterrupt(number == 0 ? INT0_vect : INT1_vect);
+	}
+
+	// Input capture of Timer1, see setupPulseInput().
+	if(pin == 8 && (TIMSK1 & _BV(ICIE1))
+			&& high == (bool)(TCCR1B & _BV(ICES1))) {
+		ICR1 = TCNT1;
+		callInterrupt(TIMER1_CAPT_vect);
+	}
+
+	// Pin change interrupts, see setupChannels().
+	byte pinChangePort = pin < 8 ? 2 : pin < 14 ? 0 : 1;
+	volatile uint8_t &mask
+		= pinChangePort == 0 ? PCMSK0 : pinChangePort == 1 ? PCMSK1 : PCMSK2;
+	if((PCICR & _BV(PCIE0 + pinChangePort)) && (mask & _BV(portBit)))
+		callInterrupt(pinChangePort == 0 ? PCINT0_vect
+			: pinChangePort == 1 ? PCINT1_vect : PCINT2_vect);
+}
+
+// Returns true if the output pin is HIGH, according to its PORTx
+// register.
+bool outputLevel(byte pin) {
+	volatile uint8_t &port = pin < 8 ? PORTD : pin < 14 ? PORTB : PORTC;
+	return port & _BV(pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14);
+}
+
+// Returns the simulated time in microseconds at which the CPU cycle
+// happens, rounded up.
+unsigned long long cycleMicros(unsigned long long cycle) {
+	return (cycle + F_CPU / 1000000 - 1) / (F_CPU / 1000000);
+}
+
+// A byte which the master sends: The time at which its stop bit has
+// been received, and whether it arrives with a wrong parity bit. Sorted
+// by the time.
+struct UsartInput {
+	unsigned long long micros;
+	byte value;
+	bool parityError;
+};
+
+std::vector<UsartInput> usartInput;
+
+// A byte which the sketch sent: The times at which it started and at
+// which the stop bit has been sent, and the level of MODBUS_DE_PIN and
+// whether the receiver was enabled when it started.
+struct UsartOutput {
+	unsigned long long micros;
+	unsigned long long endMicros;
+	byte value;
+	bool dePinHigh;
+	bool receiverEnabled;
+};
+
+std::vector<UsartOutput> usartOutput;
+
+// Whether the "shift register" is sending a byte, and the CPU cycle at
+// which it will have sent it. And the byte which is waiting in UDR0
+// until it is done, if usartBuffered is true.
+bool usartShifting = false;
+unsigned long long usartShiftEndCycle = 0;
+bool usartBuffered = false;
+byte usartBuffer = 0;
+
+// Returns the number of CPU cycles which sending or receiving a byte of
+// 11 bits takes, according to UBRR0 and U2X0.
+unsigned long long usartByteCycles() {
+	return 11ULL * (UCSR0A & _BV(U2X0) ? 8 : 16) * (UBRR0 + 1);
+}
+
+// Starts sending the byte at the given CPU cycle.
+void usartStartByte(byte value, unsigned long long cycle) {
+	usartShifting = true;
+	usartShiftEndCycle = cycle + usartByteCycles();
+	usartOutput.push_back({ cycleMicros(cycle),
+		cycleMicros(usartShiftEndCycle), value,
+		MODBUS_DE_PIN == 0 || outputLevel(MODBUS_DE_PIN),
+		(bool)(UCSR0B & _BV(RXEN0)) });
+}
+
+// Called when the sketch writes to UDR0: The byte is sent right away if
+// the shift register is free, otherwise it waits in UDR0.
+void usartTransmit(byte value) {
+	if(!(UCSR0B & _BV(TXEN0)))
+		return;
+	if(!usartShifting)
+		usartStartByte(value, currentCycle());
+	else {
+		usartBuffered = true;
+		usartBuffer = value;
+	}
+}
+
+// Moves the simulated time forward to the given microseconds, and
+// calls the interrupts of the timers and the serial port at the times
+// at which they happen, in their order.
+void advanceTime(unsigned long long micros) {
+	// The kinds of the next event.
+	enum Event { none, timer1Overflow, timer2Match, usartReceive, usartSent };
+
+	for(;;) {
+		// As long as the interrupt is enabled it is called whenever UDR0
+		// is empty. After two bytes it is full.
+		for(byte i = 0; i < 2 && !usartBuffered
+				&& (UCSR0B & _BV(UDRIE0)) && (UCSR0B & _BV(TXEN0)); ++i)
+			callInterrupt(USART_UDRE_vect);
+
+		Event event = none;
+		unsigned long long eventMicros = micros;
+		unsigned long prescaler = timer1Prescaler();
+		if(prescaler != 0) {
+			unsigned long long time = cycleMicros(timer1StartCycle
+				+ (timer1OverflowsDone + 1) * 65536 * prescaler);
+			if(time <= eventMicros) {
+				event = timer1Overflow;
+				eventMicros = time;
+			}
+		}
+		prescaler = timer2Prescaler();
+		if(prescaler != 0 && (TIMSK2 & _BV(OCIE2A))) {
+			unsigned long long time = cycleMicros(timer2StartCycle
+				+ (timer2MatchesDone + 1) * (OCR2A + 1) * prescaler);
+			if(time <= micros && (event == none || time < eventMicros)) {
+				event = timer2Match;
+				eventMicros = time;
+			}
+		}
+		if(!usartInput.empty() && usartInput.front().micros <= micros
+				&& (event == none || usartInput.front().micros < eventMicros)) {
+			event = usartReceive;
+			eventMicros = usartInput.front().micros;
+		}
+		if(usartShifting) {
+			unsigned long long time = cycleMicros(usartShiftEndCycle);
+			if(time <= micros && (event == none || time < eventMicros)) {
+				event = usartSent;
+				eventMicros = time;
+			}
+		}
+		if(event == none)
+			break;
+
+		simulatedMicros = eventMicros;
+		if(event == timer1Overflow) {
+			++timer1OverflowsDone;
+			if(TIMSK1 & _BV(TOIE1))
+				callInterrupt(TIMER1_OVF_vect);
+		} else if(event == timer2Match) {
+			++timer2MatchesDone;
+			callInterrupt(TIMER2_COMPA_vect);
+		} else if(event == usartReceive) {
+			UsartInput input = usartInput.front();
+			usartInput.erase(usartInput.begin());
+			// Lost while the receiver is disabled.
+			if(!(UCSR0B & _BV(RXEN0)))
+				continue;
+			usartReceived = input.value;
+			if(input.parityError)
+				UCSR0A |= _BV(UPE0);
+			if(UCSR0B & _BV(RXCIE0))
+				callInterrupt(USART_RX_vect);
+			UCSR0A &= ~_BV(UPE0);
+		} else {
+			usartShifting = false;
+			if(usartBuffered) {
+				usartBuffered = false;
+				usartStartByte(usartBuffer, usartShiftEndCycle);
+			} else if(UCSR0B & _BV(TXCIE0))
+				callInterrupt(USART_TX_vect);
+		}
+	}
+
+	simulatedMicros = micros;
+}
+
+// A finished measurement, as printed by printReport().
+struct Report {
+	unsigned long pulses;
+	unsigned long milliPulsesPerSecond;
+	unsigned long measurementMillis;
+	StatisticsResult statistics;
+#if REPORT_INTERVAL_SECONDS
+	unsigned long currentMilliPulsesPerSecond;
+#endif
+#if TIME_SYNC
+	// The simulated time at which the measurement was finished, and the
+	// times of the PC which the sketch reported for it.
+	unsigned long long micros;
+	unsigned long long startUnixMillis;
+	unsigned long long endUnixMillis;
+#endif
+};
+
+std::vector<Report> reports;
+#if REPORT_INTERVAL_SECONDS
+// All reports, i.e. one per interval, while reports only has those of
+// whole measurements.
+std::vector<Report> intervalReports;
+#else
+std::vector<Report> &intervalReports = reports;
+#endif
+
+#if GUST_ALERT
+// A start or end of a gust alert: The simulated time of the pass of
+// loop() in which it happened, whether a measurement was finished in
+// the same pass, and how many reports there were before it. And the
+// level of GUST_ALERT_PIN afterwards.
+struct GustAlertChange {
+	unsigned long long micros;
+	bool active;
+	bool withReport;
+	size_t reportsBefore;
+	bool pinHigh;
+};
+
+std::vector<GustAlertChange> gustAlertChanges;
+#endif
+
+// Interval at which loop() is called. On the Arduino it runs much more
+// often, but nothing in it needs to be more precise than this.
+const unsigned long loopIntervalMicros = 100;
+
+// Calls setup(), and then loop() every loopIntervalMicros until the
+// given simulated time, while applying the edges at their times. Each
+// finished measurement is added to reports, and with
+// REPORT_INTERVAL_SECONDS each report to intervalReports.
+void run(const std::vector<Edge> &edges, unsigned long long endMicros) {
+	advanceTime(0);
+	setup();
+
+	unsigned int lastSequence = reportSequence;
+#if GUST_ALERT
+	bool lastGustAlert = gustAlertActive;
+#endif
+	size_t next = 0;
+	for(unsigned long long time = 0; time <= endMicros;
+			time += loopIntervalMicros) {
+		for(; next < edges.size() && edges[next].micros <= time; ++next) {
+			advanceTime(edges[next].micros);
+			setPin(edges[next].pin, edges[next].high);
+		}
+		advanceTime(time);
+		loop();
+
+#if GUST_ALERT
+		if(gustAlertActive != lastGustAlert) {
+			lastGustAlert = gustAlertActive;
+			byte pin = GUST_ALERT_PIN;
+			volatile uint8_t &port
+				= pin < 8 ? PORTD : pin < 14 ? PORTB : PORTC;
+			byte portBit = pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14;
+			gustAlertChanges.push_back({ time, gustAlertActive,
+				reportSequence != lastSequence, intervalReports.size(),
+				(bool)(port & _BV(portBit)) });
+		}
+#endif
+		if(reportSequence != lastSequence) {
+			lastSequence = reportSequence;
+			Report report;
+			report.pulses = reportPulseCounts[0];
+			report.milliPulsesPerSecond = milliPulsesPer(1);
+			report.measurementMillis = reportMeasurementMillis;
+			report.statistics = StatisticsResult();
+#if MOVING_STATISTICS
+			computeStatistics(report.statistics);
+#endif
+#if TIME_SYNC
+			report.micros = time;
+			report.startUnixMillis = reportStartUnixMillis;
+			report.endUnixMillis = reportEndUnixMillis;
+#endif
+#if REPORT_INTERVAL_SECONDS
+			report.currentMilliPulsesPerSecond
+				= currentMilliPulsesPerSecond();
+			intervalReports.push_back(report);
+#endif
+			// With REPORT_INTERVAL_SECONDS only those of the same
+			// measurements as without it, so the other tests apply.
+			if(reportIsWholeMeasurement())
+				reports.push_back(report);
+		}
+	}
+}
+
+// Length of a pulse, i.e. for how long the switch of the Sensor is
+// closed. Must be longer than the debounce delay of DEBOUNCE_STABLE.
+const unsigned long pulseMicros = 5000;
+// Time between the bounces of the switch at the start of a pulse.
+const unsigned long bounceMicros = 100;
+
+// The level of the Sensor pin at the start of its pulses.
+const bool sensorActiveHigh = Sensor::edge == RISING;
+// Number of pulses which the sketch counts for each pulse of the
+// switch: With CHANGE both of its edges are counted.
+const unsigned long countsPerPulse = Sensor::edge == CHANGE ? 2 : 1;
+
+// Adds pulses of the Sensor from startMicros until endMicros to the
+// edges, which are periodMicros apart, each with the given number of
+// bounces when the switch closes.
+void addPulses(std::vector<Edge> &edges, unsigned long long startMicros,
+		unsigned long long endMicros, unsigned long periodMicros,
+		byte bounces = 0) {
+	for(unsigned long long time = startMicros; time < endMicros;
+			time += periodMicros) {
+		edges.push_back({ time, Sensor::pin, sensorActiveHigh });
+		for(byte i = 0; i < bounces; ++i) {
+			edges.push_back({ time + (2 * i + 1) * bounceMicros, Sensor::pin,
+				!sensorActiveHigh });
+			edges.push_back({ time + (2 * i + 2) * bounceMicros, Sensor::pin,
+				sensorActiveHigh });
+		}
+		edges.push_back({ time + pulseMicros, Sensor::pin, !sensorActiveHigh });
+	}
+}
+
+const unsigned long long measurementMicros
+	= Sensor::measurementDelaySeconds * 1000000ULL;
+
+// The increase of reportSequence per measurement: With
+// REPORT_INTERVAL_SECONDS there is a report for each interval.
+#if REPORT_INTERVAL_SECONDS
+const unsigned int reportsPerMeasurement
+	= Sensor::measurementDelaySeconds / REPORT_INTERVAL_SECONDS;
+#else
+const unsigned int reportsPerMeasurement = 1;
+#endif
+
+// A length of the measurements other than the default for the tests of
+// the settings, or 0 if there is none: With REPORT_INTERVAL_SECONDS
+// only whole intervals up to the default are valid, see
+// measurementSecondsValid().
+#if REPORT_INTERVAL_SECONDS
+const unsigned int otherMeasurementSeconds
+	= REPORT_INTERVAL_SECONDS < Sensor::measurementDelaySeconds
+		? REPORT_INTERVAL_SECONDS : 0;
+#else
+const unsigned int otherMeasurementSeconds
+	= Sensor::measurementDelaySeconds == 1 ? 2 : 1;
+#endif
+
+// Returns the pulses per second as milli pulses per second, as they
+// appear in the reports.
+unsigned long expectedMilliPulsesPerSecond(unsigned long hertz) {
+	return hertz * 1000 * countsPerPulse;
+}
+
+// Tells whether the value is within the given percent of the expected
+// one.
+bool isClose(unsigned long value, unsigned long expected,
+		unsigned long percent) {
+	unsigned long difference
+		= value > expected ? value - expected : expected - value;
+	return difference * 100 <= expected * percent;
+}
+
+// Set to false by check().
+bool testPassed = true;
+
+// Prints the message, in the format of printf(), if the condition is
+// false, and marks the test as failed.
+void check(bool condition, const char *format, ...)
+	__attribute__((format(printf, 2, 3)));
+
+void check(bool condition, const char *format, ...) {
+	if(condition)
+		return;
+
+	testPassed = false;
+	va_list arguments;
+	va_start(arguments, format);
+	printf("    ");
+	vprintf(format, arguments);
+	printf("\n");
+	va_end(arguments);
+}
+
+// Checks that the reports are of a constant frequency.
+void checkSteadyReports(size_t count, unsigned long hertz) {
+	check(reports.size() == count, "%zu reports instead of %zu",
+		reports.size(), count);
+	for(size_t i = 0; i < reports.size(); ++i) {
+		const Report &report = reports[i];
+		check(report.pulses
+				== hertz * Sensor::measurementDelaySeconds * countsPerPulse,
+			"Report %zu: %lu pulses", i, report.pulses);
+		check(isClose(report.milliPulsesPerSecond,
+				expectedMilliPulsesPerSecond(hertz), 1),
+			"Report %zu: %lu milli pulses per second", i,
+			report.milliPulsesPerSecond);
+		check(report.measurementMillis
+				== Sensor::measurementDelaySeconds * 1000UL,
+			"Report %zu: measured for %lu milliseconds", i,
+			report.measurementMillis);
+	}
+}
+
+// Returns the contents of the frames of the given type in what the
+// sketch sent via Serial, see sendFrame() of the sketch. Other frames
+// and invalid bytes are skipped.
+std::vector<std::string> decodeFrames(const std::string &data, byte type) {
+	std::vector<std::string> contents;
+
+	for(size_t position = 0; position + 6 <= data.size(); ) {
+		const byte *frame = (const byte *)data.data() + position;
+		const byte length = frame[3];
+		if(frame[0] != 0xA5 || frame[1] != 0x5A
+				|| position + 6 + length > data.size()) {
+			++position;
+			continue;
+		}
+		uint16_t crc = 0xFFFF;
+		for(unsigned int i = 2; i < 4u + length; ++i)
+			crc = _crc16_update(crc, frame[i]);
+		if(crc != (frame[4 + length] | frame[5 + length] << 8)) {
+			++position;
+			continue;
+		}
+		position += 6 + length;
+		if(frame[2] == type)
+			contents.push_back(std::string((const char *)frame + 4, length));
+	}
+
+	return contents;
+}
+
+// Traces of PULSE_TRACE.
+
+// An edge of the Sensor in a trace: Its time in microseconds, and
+// whether the pin was at the level of the edge of the Sensor.
+struct TraceEdge {
+	unsigned long long micros;
+	bool active;
+};
+
+// See frameTypeTrace of the sketch. Is needed here as well because the
+// sketch which recorded the trace may have a different configuration
+// than this one.
+const byte traceFrameType = 4;
+
+// Takes the edges out of the frames of traceFrameType in what the sketch
+// sent via Serial, see TraceFrame of the sketch, and adds the number of
+// lost edges to edgesLost. Returns false if a trace frame is invalid.
+bool decodeTrace(const std::string &data, std::vector<TraceEdge> &edges,
+		unsigned long &edgesLost) {
+	// Time of the current edge in units of TraceFrame::tickShift,
+	// including the overflows of the ticks.
+	unsigned long long units = 0;
+	bool firstEdge = true;
+
+	for(const std::string &frame : decodeFrames(data, traceFrameType)) {
+		const byte length = frame.size();
+		if(length < 4)
+			return false;
+
+		const byte *content = (const byte *)frame.data();
+		const unsigned long tickNanoseconds = content[0] | content[1] << 8;
+		const byte tickShift = content[2];
+		edgesLost += content[3];
+		// The ticks overflow after 2 ^ 32, see timeSince().
+		const unsigned long long overflowUnits = 1ULL << (32 - tickShift);
+
+		bool firstOfFrame = true;
+		for(byte i = 4; i < length; ) {
+			unsigned long long number = 0;
+			for(byte shift = 0; ; shift += 7) {
+				if(i == length || shift > 28)
+					return false;
+				number |= (unsigned long long)(content[i] & 0x7F) << shift;
+				if(!(content[i++] & 0x80))
+					break;
+			}
+
+			if(!firstOfFrame)
+				units += number >> 1;
+			else if(firstEdge)
+				units = number >> 1;
+			else {
+				// The time since startup, which is later than the previous
+				// edge, so add the overflows which happened before.
+				unsigned long long time = units - units % overflowUnits
+					+ (number >> 1);
+				if(time < units)
+					time += overflowUnits;
+				units = time;
+			}
+			firstOfFrame = false;
+			firstEdge = false;
+
+			edges.push_back({
+				(units << tickShift) * tickNanoseconds / 1000, (bool)(number & 1) });
+		}
+	}
+
+	return true;
+}
+
+// Converts the edges of a trace to changes of the level of the Sensor
+// pin. If the interrupt only happened on the edge of the Sensor, e.g.
+// with DEBOUNCE_LOCKOUT, the trace doesn't tell when the pin went back,
+// so that happens halfway to the next edge then.
+std::vector<Edge> traceToPinEdges(const std::vector<TraceEdge> &trace) {
+	std::vector<Edge> edges;
+	bool high = !sensorActiveHigh;
+
+	for(size_t i = 0; i < trace.size(); ++i) {
+		if(Sensor::edge == CHANGE)
+			high = !high;
+		else if(trace[i].active && high == sensorActiveHigh) {
+			unsigned long long previous = i > 0 ? trace[i - 1].micros : 0;
+			edges.push_back({ previous + (trace[i].micros - previous) / 2,
+				Sensor::pin, !sensorActiveHigh });
+			high = sensorActiveHigh;
+		} else
+			high = trace[i].active ? sensorActiveHigh : !sensorActiveHigh;
+		edges.push_back({ trace[i].micros, Sensor::pin, high });
+	}
+
+	return edges;
+}
+
+// The tests. Each one reports its failures with check().
+
+// A constant 5 Hz.
+void testSteady() {
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 3 * measurementMicros, 200000);
+	run(edges, 3 * measurementMicros + 1000);
+	checkSteadyReports(3, 5);
+}
+
+// A constant 5 Hz, with the switch bouncing 4 times at the start of
+// every pulse.
+void testBounce() {
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 3 * measurementMicros, 200000, 4);
+	run(edges, 3 * measurementMicros + 1000);
+	checkSteadyReports(3, 5);
+}
+
+#if MOVING_STATISTICS
+// The statistics of a whole statisticsMeanMinutes of which half of the
+// samples had 0 pulses and half 1250, as with a debounce delay of 200
+// microseconds. The variance times milliSamplesPerSecond^2 is then
+// above 2^64, which must not make the standard deviation overflow.
+void testStddev() {
+	const unsigned long samples
+		= (unsigned long)statisticsBlocks * statisticsBlockSamples;
+	const unsigned long count = 1250;
+	statisticsBlocksFilled = statisticsBlocks;
+	statisticsSum = samples / 2 * count;
+	statisticsSumOfSquares = samples / 2 * count * count;
+	StatisticsResult result;
+	computeStatistics(result);
+
+	const unsigned long samplesPerSecond = 1000 / sampleIntervalMillis;
+	check(result.mean == count * 1000 * samplesPerSecond / 2,
+		"Mean %lu milli pulses per second", result.mean);
+	check(result.stddev == count * 1000 * samplesPerSecond / 2,
+		"Standard deviation %lu milli pulses per second instead of %lu",
+		result.stddev, count * 1000 * samplesPerSecond / 2);
+}
+#endif
+
+// 5 Hz with a gust of 20 Hz for 4 seconds, which starts in the second
+// measurement. Runs until the moving statistics have finished the
+// block of the gust.
+void testGust() {
+	const unsigned long long gustStart = measurementMicros + 10000;
+	const unsigned long long gustEnd = gustStart + 4000000;
+	const unsigned int measurements = 3
+#if MOVING_STATISTICS
+		+ (4 + statisticsBlockSeconds) / Sensor::measurementDelaySeconds
+#endif
+		;
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, gustStart, 200000);
+	addPulses(edges, gustStart, gustEnd, 50000);
+	addPulses(edges, gustEnd + 200000, measurements * measurementMicros,
+		200000);
+	run(edges, measurements * measurementMicros + 1000);
+
+	check(reports.size() == measurements, "%zu reports instead of %u",
+		reports.size(), measurements);
+	for(size_t i = 0; i < reports.size(); ++i) {
+		// As many pulses as there are edges into the active level in
+		// the measurement.
+		unsigned long pulses = 0;
+		for(const Edge &edge : edges) {
+			if(edge.high == sensorActiveHigh
+					&& edge.micros >= i * measurementMicros
+					&& edge.micros < (i + 1) * measurementMicros)
+				++pulses;
+		}
+		check(reports[i].pulses == pulses * countsPerPulse,
+			"Report %zu: %lu pulses instead of %lu", i, reports[i].pulses,
+			pulses * countsPerPulse);
+	}
+#if MOVING_STATISTICS
+	if(!reports.empty() && statisticsGustSeconds <= 4) {
+		check(isClose(reports.back().statistics.gust,
+				expectedMilliPulsesPerSecond(20), 2),
+			"Gust of %lu milli pulses per second",
+			reports.back().statistics.gust);
+	}
+#endif
+}
+
+// A constant 5 Hz while millis() and micros() overflow. They overflow at
+// different times, as on the Arduino, during the second measurement.
+void testWrap() {
+	millisOffset = 0UL - (unsigned long)(measurementMicros * 3 / 2000);
+	microsOffset = 0UL - (unsigned long)(measurementMicros * 5 / 4);
+
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 3 * measurementMicros, 200000);
+	run(edges, 3 * measurementMicros + 1000);
+	checkSteadyReports(3, 5);
+}
+
+// 5 Hz which stops after the first measurement: The pulses per second
+// must go to 0 after reciprocalModeMaxPeriodSeconds.
+void testStop() {
+	const unsigned int measurements
+		= 2 + reciprocalModeMaxPeriodSeconds / Sensor::measurementDelaySeconds;
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, measurementMicros, 200000);
+	run(edges, measurements * measurementMicros + 1000);
+
+	check(reports.size() == measurements, "%zu reports instead of %u",
+		reports.size(), measurements);
+	if(reports.empty())
+		return;
+	check(reports.front().pulses
+			== 5 * Sensor::measurementDelaySeconds * countsPerPulse,
+		"First report: %lu pulses", reports.front().pulses);
+	check(reports.back().pulses == 0 && reports.back().milliPulsesPerSecond == 0,
+		"Last report: %lu pulses, %lu milli pulses per second",
+		reports.back().pulses, reports.back().milliPulsesPerSecond);
+}
+
+// windMillimetersPerSecond() must hit the points of the windCalibration
+// exactly, and interpolate between and beyond them.
+void testWindSpeed() {
+	const unsigned long perRotation = Sensor::pulsesPerRotationCount;
+	check(windMillimetersPerSecond(0) == 0,
+		"%lu mm/s when standing still", windMillimetersPerSecond(0));
+
+	for(byte point = 0; point < windCalibrationPoints; ++point) {
+		const WindCalibrationPoint &calibration = windCalibration[point];
+		unsigned long speed = windMillimetersPerSecond(
+			calibration.milliRotationsPerSecond * perRotation);
+		check(speed == calibration.millimetersPerSecond,
+			"Point %u: %lu mm/s instead of %u", point, speed,
+			calibration.millimetersPerSecond);
+
+		if(point == 0)
+			continue;
+		const WindCalibrationPoint &previous = windCalibration[point - 1];
+		unsigned long middle = windMillimetersPerSecond(
+			(calibration.milliRotationsPerSecond
+				+ previous.milliRotationsPerSecond) * perRotation / 2);
+		unsigned long expected = (calibration.millimetersPerSecond
+			+ previous.millimetersPerSecond) / 2;
+		check(middle + 1 >= expected && middle <= expected + 1,
+			"Before point %u: %lu mm/s instead of %lu", point, middle,
+			expected);
+	}
+
+	// Twice the last point continues the line through the last two.
+	const WindCalibrationPoint &last
+		= windCalibration[windCalibrationPoints - 1];
+	const WindCalibrationPoint &beforeLast
+		= windCalibration[windCalibrationPoints - 2];
+	unsigned long beyond = windMillimetersPerSecond(
+		2UL * last.milliRotationsPerSecond * perRotation);
+	unsigned long expected = last.millimetersPerSecond
+		+ (unsigned long long)last.milliRotationsPerSecond
+			* (last.millimetersPerSecond - beforeLast.millimetersPerSecond)
+			/ (last.milliRotationsPerSecond
+				- beforeLast.milliRotationsPerSecond);
+	check(beyond == expected, "Beyond the last point: %lu mm/s instead of "
+		"%lu", beyond, expected);
+}
+
+#if EEPROM_LOG
+// A constant 5 Hz for 4 measurements, after which the PC asks for the
+// records from the second one on. They must be sent, and after a
+// restart the sequence must continue after the last one.
+void testLog() {
+	const unsigned int measurements = 4;
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, measurements * measurementMicros, 200000);
+	char input[20];
+	snprintf(input, sizeof(input), "dump %u\r\n", 2 * reportsPerMeasurement);
+	Serial.serialInput = input;
+	Serial.serialInputMicros = measurements * measurementMicros + 100000;
+	run(edges, measurements * measurementMicros + 500000);
+	checkSteadyReports(measurements, 5);
+
+	// Sequence and pulses of the records which were sent.
+	std::vector<std::pair<unsigned long, unsigned long>> records;
+	bool finished = false;
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	const std::string &text = Serial.serialOutput;
+	for(size_t line = text.find("Log: "); line != std::string::npos;
+			line = text.find("Log: ", line + 1)) {
+		unsigned long sequence, uptime, pulses;
+		if(sscanf(text.c_str() + line, "Log: %lu,%lu,%lu", &sequence, &uptime,
+				&pulses) == 3)
+			records.push_back({ sequence, pulses });
+	}
+	finished = text.find("Log dump finished, records: 3") != std::string::npos;
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	for(const std::string &frame
+			: decodeFrames(Serial.serialOutput, frameTypeLog)) {
+		LogRecord record;
+		memcpy(&record, frame.data(), sizeof(LogRecord) - 1);
+		records.push_back({ (unsigned long)record.sequence,
+			(unsigned long)record.pulseCount });
+	}
+	std::vector<std::string> ends
+		= decodeFrames(Serial.serialOutput, frameTypeLogEnd);
+	finished = ends.size() == 1 && (byte)ends[0][0] == 3;
+#endif
+
+	check(records.size() == 3, "%zu records sent instead of 3",
+		records.size());
+	for(size_t i = 0; i < records.size(); ++i) {
+		check(records[i].first == (i + 2) * reportsPerMeasurement
+				&& records[i].second
+					== 5 * Sensor::measurementDelaySeconds * countsPerPulse,
+			"Record %zu: sequence %lu, %lu pulses", i, records[i].first,
+			records[i].second);
+	}
+	check(finished, "No end of the dump");
+
+	// What setup() does after a restart, with the same EEPROM.
+	reportSequence = 0;
+	logNextSlot = 0;
+	setupLog();
+	check(reportSequence == measurements * reportsPerMeasurement
+			&& logNextSlot == measurements,
+		"After restart: sequence %u, next slot %u", reportSequence,
+		logNextSlot);
+}
+#endif
+
+#if SERIAL_COMMANDS && OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+// Commands which change the settings, some of them invalid, at the
+// start. The measurements must then be of the new length, and the
+// settings must be the same after a restart.
+void testSettings() {
+	const unsigned int seconds = otherMeasurementSeconds;
+	if(seconds == 0)
+		return;
+	const unsigned long debounce = Sensor::debounceDelayMicros / 2;
+	char input[200];
+	snprintf(input, sizeof(input), "set measurement %u\nset debounce %lu\r\n"
+		"set baud 115200\nset format 2\nset debounce 0\nhello\nget\n",
+		seconds, debounce);
+	Serial.serialInput = input;
+	Serial.serialInputMicros = 1000;
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 4 * seconds * 1000000ULL, 200000);
+	run(edges, 4 * seconds * 1000000ULL + 1000);
+
+	check(reports.size() == 4, "%zu reports instead of 4", reports.size());
+	for(size_t i = 0; i < reports.size(); ++i) {
+		check(reports[i].measurementMillis == seconds * 1000UL
+				&& reports[i].pulses == 5 * seconds * countsPerPulse,
+			"Report %zu: %lu pulses in %lu milliseconds", i,
+			reports[i].pulses, reports[i].measurementMillis);
+	}
+	check(Serial.baud == 115200, "Baud %lu instead of 115200", Serial.baud);
+
+	// The results of the answers to the commands.
+	const byte expected[] = {
+		commandResultOk, commandResultOk, commandResultOk,
+		commandResultReadOnly, commandResultInvalidValue,
+		commandResultUnknown, commandResultOk,
+	};
+	std::vector<byte> results;
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	const std::string &text = Serial.serialOutput;
+	for(size_t line = 0; line < text.size();
+			line = text.find('\n', line) + 1) {
+		if(text.compare(line, 4, "OK\r\n") == 0)
+			results.push_back(commandResultOk);
+		else if(text.compare(line, 22, "ERROR: Unknown command") == 0)
+			results.push_back(commandResultUnknown);
+		else if(text.compare(line, 20, "ERROR: Invalid value") == 0)
+			results.push_back(commandResultInvalidValue);
+		else if(text.compare(line, 20, "ERROR: Can only be c") == 0)
+			results.push_back(commandResultReadOnly);
+		if(text.find('\n', line) == std::string::npos)
+			break;
+	}
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	for(const std::string &frame
+			: decodeFrames(Serial.serialOutput, frameTypeSettings))
+		results.push_back(frame[0]);
+#endif
+	check(results == std::vector<byte>(expected, expected + sizeof(expected)),
+		"Wrong answers to the commands");
+
+	// What setup() does after a restart, with the same EEPROM.
+	applySettings(Sensor::measurementDelaySeconds,
+		Sensor::debounceDelayMicros);
+	serialBaud = SERIAL_BAUD;
+	setupSettings();
+	check(sensorMeasurementSeconds == seconds
+			&& sensorDebounceMicros == debounce && serialBaud == 115200,
+		"After restart: %u seconds, %lu microseconds debounce, baud %lu",
+		sensorMeasurementSeconds, sensorDebounceMicros, serialBaud);
+}
+#endif
+
+#if PULSE_HISTOGRAM
+// A constant 5 Hz with bounces, after which the PC asks for the
+// histogram twice, clearing it the first time. All times between the
+// pulses must be in the bin of 200 milliseconds, and all bounces must
+// be counted as rejected edges.
+void testHistogram() {
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 2 * measurementMicros, 200000, 4);
+	Serial.serialInput = "histogram clear\nhistogram\n";
+	Serial.serialInputMicros = 2 * measurementMicros + 100000;
+	run(edges, 2 * measurementMicros + 200000);
+
+	unsigned long pulses = 0;
+	for(const Report &report : reports)
+		pulses += report.pulses;
+	// The edges for which the interrupt happens but which don't count,
+	// see countPulse().
+	unsigned long rejected = 0;
+	for(const Edge &edge : edges) {
+		if(DEBOUNCE_STRATEGY == DEBOUNCE_STABLE
+				? edge.high != sensorActiveHigh
+				: interruptEdge(Sensor::edge) == CHANGE
+					|| edge.high == sensorActiveHigh)
+			++rejected;
+	}
+	rejected -= pulses;
+	byte expectedBin = 1;
+	while(expectedBin < histogramBins - 1
+			&& histogramFirstBinMicros << expectedBin <= 200000)
+		++expectedBin;
+
+	// The histogram as sent the first time, and whether the second one
+	// was empty.
+	std::vector<unsigned long> counts;
+	unsigned long rejectedEdges = 0;
+	bool cleared = false;
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	const std::string &text = Serial.serialOutput;
+	size_t first = text.find("Pulse intervals from ");
+	size_t second = text.find("Pulse intervals from ", first + 1);
+	if(first != std::string::npos && second != std::string::npos) {
+		const char *numbers = strstr(text.c_str() + first, ": ") + 2;
+		for(byte bin = 0; bin < histogramBins; ++bin) {
+			char *end;
+			counts.push_back(strtoul(numbers, &end, 10));
+			numbers = end + 1;
+		}
+		sscanf(text.c_str() + text.find("Edges rejected", first),
+			"Edges rejected by the debounce: %lu", &rejectedEdges);
+		cleared = text.find(": 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0\r\n"
+			"Edges rejected by the debounce: 0", second) != std::string::npos;
+	}
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	std::vector<std::string> frames
+		= decodeFrames(Serial.serialOutput, frameTypeHistogram);
+	if(frames.size() == 2) {
+		BinaryHistogram histogram;
+		memcpy(&histogram, frames[0].data(), sizeof(histogram));
+		for(byte bin = 0; bin < histogramBins; ++bin)
+			counts.push_back(histogram.counts[bin]);
+		rejectedEdges = histogram.rejectedEdges;
+		memcpy(&histogram, frames[1].data(), sizeof(histogram));
+		cleared = histogram.rejectedEdges == 0;
+		for(byte bin = 0; bin < histogramBins; ++bin)
+			cleared = cleared && histogram.counts[bin] == 0;
+	}
+#endif
+
+	check(counts.size() == histogramBins, "No histogram sent");
+	unsigned long total = 0;
+	for(size_t bin = 0; bin < counts.size(); ++bin) {
+		total += counts[bin];
+		// With CHANGE the times alternate between the pulse and the rest.
+		check(Sensor::edge == CHANGE || bin == expectedBin || counts[bin] == 0,
+			"Bin %zu: %lu times instead of 0", bin, counts[bin]);
+	}
+	check(total + 1 == pulses, "%lu times between %lu pulses", total, pulses);
+	check(rejectedEdges == rejected, "%lu rejected edges instead of %lu",
+		rejectedEdges, rejected);
+	check(cleared, "Histogram not cleared");
+}
+#endif
+
+#if TIME_SYNC
+// The time of a PC whose clock is 400 ppm faster than the one of the
+// Arduino, in milliseconds since 1970, at the given simulated time.
+unsigned long long pcMillis(unsigned long long micros) {
+	return 1760000000123ULL + micros / 1000 + micros * 400 / 1000000000;
+}
+
+// Returns the line of "time" which the PC sends at the given simulated
+// time. The line arrives at once in the simulation, so the time is
+// earlier by what the sketch adds for sending it, see synchronizeTime().
+std::string timeLine(unsigned long long micros) {
+	char line[40];
+	unsigned long long millis = pcMillis(micros)
+		- strlen("time 1760000000.123\n") * 10000 / SERIAL_BAUD;
+	snprintf(line, sizeof(line), "time %llu.%03llu\n", millis / 1000,
+		millis % 1000);
+	return line;
+}
+
+// A constant 5 Hz while the PC sends the time twice, 11 minutes apart.
+// After the first time the measurements must end at whole multiples of
+// their length, or of REPORT_INTERVAL_SECONDS, of the PC's time, and
+// after the second the sketch must have computed the drift and report
+// the PC's time precisely.
+void testTimeSync() {
+	const unsigned long long firstMicros = 1500000;
+	const unsigned long long secondMicros = 660000000;
+	const unsigned long long endMicros = secondMicros + 3 * measurementMicros;
+	const unsigned long measurementMillis = measurementMicros / 1000;
+	// Where the measurements end, see alignSample().
+#if REPORT_INTERVAL_SECONDS
+	const unsigned long boundaryMillis = REPORT_INTERVAL_SECONDS * 1000UL;
+#else
+	const unsigned long boundaryMillis = measurementMillis;
+#endif
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, endMicros, 200000);
+	Serial.serialInput = timeLine(firstMicros);
+	Serial.serialInputMicros = firstMicros;
+	Serial.laterInput.push_back(
+		std::make_pair(secondMicros, timeLine(secondMicros)));
+	run(edges, endMicros);
+
+	check(isClose(clockCorrectionPpb, 400000, 1),
+		"Clock correction %ld ppb instead of 400000", clockCorrectionPpb);
+
+	size_t synchronized = 0;
+	for(size_t i = 0; i < reports.size(); ++i) {
+		const Report &report = reports[i];
+		if(report.micros < firstMicros) {
+			check(report.endUnixMillis == 0, "Report %zu: Time without sync",
+				i);
+			continue;
+		}
+		// Up to a millisecond later because of the loop() of the
+		// simulation only running every loopIntervalMicros. The first
+		// one may end before the samples have been moved to the PC's
+		// time, see alignSample().
+		unsigned long offBoundary
+			= (report.endUnixMillis + 2) % boundaryMillis;
+		check(++synchronized == 1 || offBoundary <= 4,
+			"Report %zu: Ends %lu ms off the boundary", i, offBoundary - 2);
+		if(report.micros < secondMicros + measurementMicros)
+			continue;
+		long long error = report.endUnixMillis - pcMillis(report.micros);
+		check(error >= -3 && error <= 3, "Report %zu: End time off by %lld ms",
+			i, error);
+		check(report.endUnixMillis - report.startUnixMillis
+				>= measurementMillis - 2
+				&& report.endUnixMillis - report.startUnixMillis
+					<= measurementMillis + 2,
+			"Report %zu: %llu ms long", i,
+			report.endUnixMillis - report.startUnixMillis);
+	}
+	check(synchronized >= 10, "Only %zu reports with times", synchronized);
+	size_t timed = 0;
+	for(const Report &report : intervalReports)
+		timed += report.micros >= firstMicros;
+
+	// The answers to "time", and the times of the reports.
+	size_t answers = 0;
+	size_t times = 0;
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	const std::string &text = Serial.serialOutput;
+	for(size_t position = 0;
+			(position = text.find("Time synchronized", position))
+				!= std::string::npos; ++position)
+		++answers;
+	for(size_t position = 0;
+			(position = text.find("End time: ", position))
+				!= std::string::npos; ++position)
+		++times;
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	answers = decodeFrames(Serial.serialOutput, frameTypeTimeSync).size();
+	times = decodeFrames(Serial.serialOutput, frameTypeTime).size();
+#endif
+	check(answers == 2, "%zu answers to \"time\" instead of 2", answers);
+	check(times == timed, "%zu reports with times instead of %zu", times,
+		timed);
+}
+#endif
+
+#if GUST_ALERT
+// 2 Hz with a gust of 5 Hz, i.e. below and above the thresholds of the
+// gust alert, for 3 seconds. It starts shortly before the end of the
+// second measurement so the alert comes in the same pass of loop() as
+// the report, and must be sent before it. The alert must end once the
+// wind was slow again for gustAlertOffMillis.
+void testGustAlert() {
+	const unsigned long long gustStart = 2 * measurementMicros - 450000;
+	const unsigned long long gustEnd = gustStart + 3000000;
+	const unsigned long long offMicros = gustEnd + gustAlertOffMillis * 1000;
+	const unsigned long long endMicros
+		= std::max(3 * measurementMicros, offMicros + 2000000);
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, gustStart, 500000);
+	addPulses(edges, gustStart, gustEnd, 200000);
+	addPulses(edges, gustEnd + 200000, endMicros, 500000);
+	run(edges, endMicros);
+
+	check(gustAlertChanges.size() == 2, "%zu changes of the gust alert",
+		gustAlertChanges.size());
+	if(gustAlertChanges.size() != 2)
+		return;
+	const GustAlertChange &on = gustAlertChanges[0];
+	const GustAlertChange &off = gustAlertChanges[1];
+	check(on.active && !off.active, "Gust alert ended before it started");
+	// The window has to contain the faster pulses first.
+	check(on.micros > gustStart
+			&& on.micros <= gustStart + gustAlertWindowMillis * 1000
+				+ sampleIntervalMillis * 1000,
+		"Gust alert started %lld microseconds after the gust",
+		(long long)(on.micros - gustStart));
+	check(on.withReport, "Gust alert not together with a report");
+	check(off.micros > offMicros && off.micros <= offMicros
+			+ gustAlertWindowMillis * 1000 + sampleIntervalMillis * 1000,
+		"Gust alert ended %lld microseconds after the gust",
+		(long long)(off.micros - gustEnd));
+#if GUST_ALERT_PIN
+	check(on.pinHigh && !off.pinHigh, "GUST_ALERT_PIN not following it");
+#endif
+
+	// The active flags and the wind speeds of the alerts. With
+	// OUTPUT_FORMAT_MODBUS there are none, the master reads the flag of
+	// the input registers instead.
+#if OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	std::vector<bool> active;
+	std::vector<unsigned long> speeds;
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	const std::string &text = Serial.serialOutput;
+	for(size_t position = 0; (position = text.find("Gust alert ", position))
+			!= std::string::npos; ++position) {
+		active.push_back(text.compare(position, 14, "Gust alert on,") == 0);
+		double meters = 0;
+		sscanf(text.c_str() + position, "Gust alert %*s wind speed in m/s: %lf",
+			&meters);
+		speeds.push_back((unsigned long)(meters * 1000 + 0.5));
+	}
+	// Before the report which was finished in the same pass, and the
+	// report must still have fit into the output queue.
+	size_t reportsSent = 0;
+	for(size_t position = 0;
+			(position = text.find("Pulses measured: ", position))
+				!= std::string::npos; ++position, ++reportsSent) {
+		if(reportsSent == on.reportsBefore)
+			check(text.find("Gust alert on") < position,
+				"Gust alert sent after the report");
+	}
+	check(reportsSent == intervalReports.size(),
+		"Only %zu of %zu reports sent", reportsSent, intervalReports.size());
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	for(const std::string &frame
+			: decodeFrames(Serial.serialOutput, frameTypeGustAlert)) {
+		BinaryGustAlert alert;
+		memcpy(&alert, frame.data(), sizeof(alert));
+		active.push_back(alert.active);
+		speeds.push_back(alert.windMillimetersPerSecond);
+	}
+#endif
+
+	check(active.size() == 2 && active[0] && !active[1],
+		"%zu gust alerts instead of 2", active.size());
+	if(speeds.size() == 2) {
+		check(speeds[0] >= gustAlertOnMillimetersPerSecond,
+			"Gust alert started at %lu mm/s", speeds[0]);
+		check(speeds[1] < gustAlertOffMillimetersPerSecond,
+			"Gust alert ended at %lu mm/s", speeds[1]);
+	}
+#endif
+}
+#endif
+
+#if WATCHDOG
+// Two measurements after a reset by the watchdog: The watchdog must
+// have been switched off at the start of setup(), and enabled at its
+// end, and loop() must have reset it at every pass.
+void testWatchdog() {
+	MCUSR = _BV(WDRF);
+	watchdogEnabledTimeout = WDTO_4S;
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 2 * measurementMicros, 200000);
+	run(edges, 2 * measurementMicros + 1000);
+
+	checkSteadyReports(2, 5);
+	check(MCUSR == 0, "MCUSR not cleared");
+	check(watchdogEnabledTimeout == watchdogTimeout,
+		"Watchdog timeout %d instead of %d", watchdogEnabledTimeout,
+		watchdogTimeout);
+	check(watchdogLongestMicros <= loopIntervalMicros,
+		"Watchdog reset only after %llu microseconds", watchdogLongestMicros);
+}
+#endif
+
+#if HEALTH_REPORT && OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+// The health records after a reset by the watchdog: One at the start
+// and one after healthIntervalMillis, both with the reset flags. The
+// second comes together with a report, so it only fits into the output
+// queue healthRetryMillis later. Then loop() is stuck for a second, so
+// the next one must tell that a task was late, and the stack grows into
+// the free RAM.
+void testHealth() {
+	MCUSR = _BV(WDRF);
+	const unsigned long long endMicros
+		= (healthIntervalMillis + 2 * healthRetryMillis) * 1000ULL;
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, endMicros, 200000);
+	run(edges, endMicros);
+	advanceTime(simulatedMicros + 1000000);
+	loop();
+	memset(freeRam + sizeof(freeRam) - 40, 0, 40);
+	sendHealth();
+	for(int i = 0; i < 1000; ++i) {
+		advanceTime(simulatedMicros + loopIntervalMicros);
+		loop();
+	}
+
+	// Reset flags, never used RAM and tasks which were late of each
+	// record.
+	std::vector<unsigned long> flags, margins, late;
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	const std::string &text = Serial.serialOutput;
+	for(size_t position = 0; (position = text.find("Reset by: ", position))
+			!= std::string::npos; ++position) {
+		flags.push_back(text.compare(position, 18, "Reset by: Watchdog") == 0
+			? _BV(WDRF) : 0);
+		unsigned long margin = 0, tasks = 0;
+		sscanf(text.c_str() + position, "Reset by: %*s\r\n"
+			"Never used RAM in bytes: %lu\r\nTasks which were late: %lu",
+			&margin, &tasks);
+		margins.push_back(margin);
+		late.push_back(tasks);
+	}
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	for(const std::string &frame
+			: decodeFrames(Serial.serialOutput, frameTypeHealth)) {
+		BinaryHealth health;
+		memcpy(&health, frame.data(), sizeof(health));
+		flags.push_back(health.resetFlags);
+		margins.push_back(health.stackMarginBytes);
+		late.push_back(health.tasksLate);
+	}
+#endif
+
+	check(flags.size() == 3, "%zu health records instead of 3",
+		flags.size());
+	for(size_t i = 0; i < flags.size(); ++i) {
+		check(flags[i] == _BV(WDRF), "Record %zu: Reset flags %lu", i,
+			flags[i]);
+		unsigned long margin = sizeof(freeRam) - (i == 2 ? 40 : 0);
+		check(margins[i] == margin, "Record %zu: %lu bytes never used "
+			"instead of %lu", i, margins[i], margin);
+		check(late[i] == (i == 2 ? 1 : 0), "Record %zu: %lu tasks late", i,
+			late[i]);
+	}
+	check(MCUSR == 0, "MCUSR not cleared");
+}
+#endif
+
+#if INSTRUMENTATION
+// Adds the instrumentation statistics of the last report to the
+// vectors. With OUTPUT_FORMAT_MODBUS they are in the input registers,
+// so this must be called after each report then. Otherwise they are
+// taken from what the sketch sent via Serial, so this is only called
+// at the end. The text doesn't tell the count, it is 1 then if there
+// were measurements.
+void readInstrumentation(std::vector<CycleResult> &isr,
+		std::vector<CycleResult> &criticalSection) {
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+	const std::string &text = Serial.serialOutput;
+	const char *isrLine = "CPU cycles in interrupt (min / avg / max): ";
+	const char *criticalSectionLine = "CPU cycles with interrupts disabled: ";
+	for(size_t position = 0; (position = text.find(isrLine, position))
+			!= std::string::npos; ++position) {
+		CycleResult results[2] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 } };
+		const char *lines[2] = { isrLine, criticalSectionLine };
+		for(int i = 0; i < 2; ++i) {
+			size_t start = text.find(lines[i], position);
+			if(start == std::string::npos)
+				continue;
+			CycleResult &result = results[i];
+			if(sscanf(text.c_str() + start + strlen(lines[i]),
+					"%lu / %lu / %lu", &result.min, &result.average,
+					&result.max) == 3)
+				result.count = 1;
+		}
+		isr.push_back(results[0]);
+		criticalSection.push_back(results[1]);
+	}
+#elif OUTPUT_FORMAT == OUTPUT_FORMAT_BINARY
+	for(const std::string &frame
+			: decodeFrames(Serial.serialOutput, frameTypeInstrumentation)) {
+		BinaryInstrumentation instrumentation;
+		memcpy(&instrumentation, frame.data(), sizeof(instrumentation));
+		const BinaryCycles *cycles[2]
+			= { &instrumentation.isr, &instrumentation.criticalSection };
+		CycleResult results[2];
+		for(int i = 0; i < 2; ++i) {
+			results[i].min = cycles[i]->minCycles;
+			results[i].average = cycles[i]->averageCycles;
+			results[i].max = cycles[i]->maxCycles;
+			results[i].count = cycles[i]->count;
+		}
+		isr.push_back(results[0]);
+		criticalSection.push_back(results[1]);
+	}
+#else
+	unsigned long values[modbusInputValues];
+	readModbusInputValues(values);
+	const unsigned long *instrumentation
+		= values + 17 + 2 * (channelCount - 1);
+	isr.push_back({ instrumentation[0], instrumentation[1],
+		instrumentation[2], instrumentation[3] });
+	criticalSection.push_back({ instrumentation[8], instrumentation[9],
+		instrumentation[10], instrumentation[11] });
+#endif
+}
+
+// Two durations of the interrupt and one of takePulseSnapshot() before
+// the first report, besides the ones of the simulation, which take no
+// time. Without pulses the first report must have exactly these, and
+// the second none of the interrupt, because the statistics start again
+// with each report.
+void testInstrumentation() {
+	addCycles(isrCycles, 100);
+	addCycles(isrCycles, 300);
+	addCycles(criticalSectionCycles, 50);
+	const unsigned long long intervalMicros
+		= measurementMicros / reportsPerMeasurement;
+	std::vector<CycleResult> isr, criticalSection;
+	std::vector<Edge> edges;
+	run(edges, intervalMicros + 1000);
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+	readInstrumentation(isr, criticalSection);
+#endif
+	for(unsigned long long i = 0; i < intervalMicros / loopIntervalMicros;
+			++i) {
+		advanceTime(simulatedMicros + loopIntervalMicros);
+		loop();
+	}
+	readInstrumentation(isr, criticalSection);
+
+	check(isr.size() == 2 && criticalSection.size() == 2,
+		"%zu reports of the instrumentation instead of 2", isr.size());
+	if(isr.size() != 2 || criticalSection.size() != 2)
+		return;
+	const unsigned long cycles = cyclesPerTimer1Count;
+	check(isr[0].min == 100 * cycles && isr[0].average == 200 * cycles
+			&& isr[0].max == 300 * cycles
+			&& isr[0].count == (OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT ? 1 : 2),
+		"Report 0: Interrupt %lu / %lu / %lu cycles, %lu times", isr[0].min,
+		isr[0].average, isr[0].max, isr[0].count);
+	check(isr[1].count == 0 && isr[1].max == 0,
+		"Report 1: Interrupt %lu times", isr[1].count);
+	for(int i = 0; i < 2; ++i) {
+		const CycleResult &result = criticalSection[i];
+		unsigned long max = i == 0 ? 50 * cycles : 0;
+		check(result.count > 0 && result.min == 0 && result.max == max
+				&& result.average <= max,
+			"Report %d: Interrupts disabled %lu / %lu / %lu cycles", i,
+			result.min, result.average, result.max);
+	}
+}
+#endif
+
+#if PULSE_TRACE
+// A constant 5 Hz with bounces: The trace must contain every edge which
+// the interrupt saw.
+void testTrace() {
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 2 * measurementMicros, 200000, 4);
+	run(edges, 2 * measurementMicros + 1000);
+
+	// The edges for which the interrupt happens, see interruptEdge().
+	std::vector<Edge> expected;
+	for(const Edge &edge : edges) {
+		if(interruptEdge(Sensor::edge) == CHANGE
+				|| edge.high == sensorActiveHigh)
+			expected.push_back(edge);
+	}
+
+	std::vector<TraceEdge> trace;
+	unsigned long edgesLost = 0;
+	check(decodeTrace(Serial.serialOutput, trace, edgesLost),
+		"Invalid trace frame");
+	check(edgesLost == 0, "%lu edges lost", edgesLost);
+	// The last edges may still be waiting for their frame.
+	check(trace.size() <= expected.size()
+			&& trace.size() + sizeof(TraceFrame::edges) >= expected.size(),
+		"%zu edges in the trace instead of %zu", trace.size(),
+		expected.size());
+	for(size_t i = 0; i < trace.size() && i < expected.size(); ++i) {
+		// micros() is in steps of 4.
+		if(trace[i].micros > expected[i].micros
+				|| trace[i].micros + 4 <= expected[i].micros
+				|| trace[i].active
+					!= isActiveLevel(Sensor::edge, expected[i].high)) {
+			check(false, "Edge %zu: %llu microseconds, active %d instead of "
+				"%llu, %d", i, trace[i].micros, trace[i].active,
+				expected[i].micros,
+				isActiveLevel(Sensor::edge, expected[i].high));
+			break;
+		}
+	}
+}
+#endif
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+// The Modbus master.
+
+// Appends the 16 bits number to the frame, highest byte first, as
+// Modbus sends it.
+void appendModbusWord(std::string &frame, unsigned int value) {
+	frame += (char)(value >> 8);
+	frame += (char)(value & 0xFF);
+}
+
+// Returns the 16 bits number at the given position of the frame.
+unsigned int modbusWordAt(const std::string &frame, size_t position) {
+	return (byte)frame[position] << 8 | (byte)frame[position + 1];
+}
+
+uint16_t modbusCrc(const std::string &frame, size_t length) {
+	uint16_t crc = 0xFFFF;
+	for(size_t i = 0; i < length; ++i)
+		crc = _crc16_update(crc, frame[i]);
+	return crc;
+}
+
+// Returns a request with the address, function, first register and
+// count, or value of a single register, without the CRC.
+std::string modbusRequest(byte address, byte function, unsigned int first,
+		unsigned int count) {
+	std::string request;
+	request += (char)address;
+	request += (char)function;
+	appendModbusWord(request, first);
+	appendModbusWord(request, count);
+	return request;
+}
+
+// Returns a request for writing the 32 bits values to the registers
+// from the given one on, without the CRC.
+std::string modbusWriteRequest(byte address, unsigned int first,
+		const std::vector<unsigned long> &values) {
+	std::string request
+		= modbusRequest(address, 16, first, 2 * values.size());
+	request += (char)(4 * values.size());
+	for(unsigned long value : values) {
+		appendModbusWord(request, value >> 16);
+		appendModbusWord(request, value & 0xFFFF);
+	}
+	return request;
+}
+
+// Microseconds of a byte at the given speed, rounded up.
+unsigned long long modbusByteMicros(unsigned long baud) {
+	return (11000000 + baud - 1) / baud;
+}
+
+// Microseconds of silence after which the sketch must have taken a
+// request as complete, see setupModbus().
+unsigned long long modbusSilenceMicros(unsigned long baud) {
+	return baud > 19200 ? 1750 : 38500000 / baud;
+}
+
+// A request which the master sends at the given simulated time and
+// speed, without the CRC. If corrupt is true its CRC is wrong, and the
+// third byte arrives with a wrong parity bit if parityError is true.
+// answer is what the sketch sent after it, empty if nothing, and
+// answerDelay the time from the end of the request until the answer.
+struct ModbusExchange {
+	ModbusExchange(unsigned long long micros, const std::string &request,
+			unsigned long baud = 0, bool corrupt = false,
+			bool parityError = false)
+		: micros(micros), request(request), baud(baud), corrupt(corrupt),
+			parityError(parityError), answerDelay(0) {}
+
+	unsigned long long micros;
+	std::string request;
+	unsigned long baud;
+	bool corrupt;
+	bool parityError;
+	std::string answer;
+	unsigned long long answerDelay;
+};
+
+// Schedules the requests to be received by the sketch.
+void sendModbusRequests(const std::vector<ModbusExchange> &exchanges) {
+	for(const ModbusExchange &exchange : exchanges) {
+		std::string request = exchange.request;
+		uint16_t crc = modbusCrc(request, request.size())
+			^ (exchange.corrupt ? 1 : 0);
+		request += (char)(crc & 0xFF);
+		request += (char)(crc >> 8);
+		unsigned long long byteMicros = modbusByteMicros(exchange.baud);
+		for(size_t i = 0; i < request.size(); ++i) {
+			usartInput.push_back({ exchange.micros + (i + 1) * byteMicros,
+				(byte)request[i], exchange.parityError && i == 2 });
+		}
+	}
+}
+
+// Assigns what the sketch sent to the requests: The bytes after the end
+// of a request and before the next one. Checks that MODBUS_DE_PIN was
+// HIGH and the receiver disabled while sending, that each answer was
+// sent without gaps between its bytes, and that it has the right CRC.
+void receiveModbusAnswers(std::vector<ModbusExchange> &exchanges) {
+	size_t next = 0;
+	for(size_t i = 0; i < exchanges.size(); ++i) {
+		ModbusExchange &exchange = exchanges[i];
+		unsigned long long end = exchange.micros
+			+ (exchange.request.size() + 2) * modbusByteMicros(exchange.baud);
+		unsigned long long before = i + 1 < exchanges.size()
+			? exchanges[i + 1].micros : ULLONG_MAX;
+		for(; next < usartOutput.size() && usartOutput[next].micros < before;
+				++next) {
+			const UsartOutput &output = usartOutput[next];
+			check(output.micros >= end, "Request %zu: Sent during it", i);
+			check(output.dePinHigh && !output.receiverEnabled,
+				"Request %zu: Sent with DE pin %d, receiver %d", i,
+				output.dePinHigh, output.receiverEnabled);
+			if(exchange.answer.empty())
+				exchange.answerDelay = output.micros - end;
+			else {
+				check(output.micros == usartOutput[next - 1].endMicros,
+					"Request %zu: Gap in the answer", i);
+			}
+			exchange.answer += (char)output.value;
+		}
+		size_t length = exchange.answer.size();
+		check(length == 0 || (length >= 5
+				&& modbusCrc(exchange.answer, length - 2)
+					== ((byte)exchange.answer[length - 2]
+						| (byte)exchange.answer[length - 1] << 8)),
+			"Request %zu: Answer with a wrong CRC", i);
+	}
+}
+
+// Checks that the answer to the request is an exception with the code.
+void checkModbusException(const ModbusExchange &exchange, size_t index,
+		byte code) {
+	check(exchange.answer.size() == 5
+			&& exchange.answer[0] == exchange.request[0]
+			&& (byte)exchange.answer[1] == ((byte)exchange.request[1] | 0x80)
+			&& exchange.answer[2] == code,
+		"Request %zu: Not the exception %u", index, code);
+}
+
+// Returns the 32 bits value at the given position of the answer to a
+// request for reading registers from an even one on.
+unsigned long modbusAnswerValue(const std::string &answer, size_t value) {
+	return (unsigned long)modbusWordAt(answer, 3 + 4 * value) << 16
+		| modbusWordAt(answer, 5 + 4 * value);
+}
+
+// A constant 5 Hz, while the master reads the registers in the last
+// measurement, and sends requests which must be ignored or answered by
+// an exception. The answers must come after the silence at the end of
+// the request, and the values must be those of the reports.
+void testModbus() {
+	MCUSR = _BV(WDRF);
+	const byte address = MODBUS_ADDRESS;
+	const unsigned long long start = 2 * measurementMicros + 100000;
+	std::vector<ModbusExchange> exchanges = {
+		{ 0, modbusRequest(address, 4, 0, 2 * modbusInputValues) },
+		{ 0, modbusRequest(address, 3, 0, 2 * modbusHoldingValues) },
+		// The low 16 bits of the pulses.
+		{ 0, modbusRequest(address, 4, 3, 1) },
+		{ 0, modbusRequest(address % 247 + 1, 4, 0, 2) },
+		{ 0, modbusRequest(address, 4, 0, 2), 0, true },
+		{ 0, modbusRequest(address, 4, 0, 2), 0, false, true },
+		{ 0, modbusRequest(address, 43, 0, 2) },
+		{ 0, modbusRequest(address, 4, 2 * modbusInputValues - 1, 2) },
+		{ 0, modbusRequest(address, 3, 0, 0) },
+		// Without SERIAL_COMMANDS writing isn't known, with it this one
+		// is read-only.
+		{ 0, modbusRequest(address, 6, 2 * modbusHoldingValues - 1, 1) },
+		// Broadcast.
+		{ 0, modbusRequest(0, 4, 0, 2) },
+	};
+	// Enough for the longest answer, which is to the first request, and
+	// the silence before it.
+	const unsigned long long interval
+		= (20 + 4 * modbusInputValues) * modbusByteMicros(SERIAL_BAUD) + 10000;
+	for(size_t i = 0; i < exchanges.size(); ++i) {
+		exchanges[i].micros = start + i * interval;
+		exchanges[i].baud = SERIAL_BAUD;
+	}
+	sendModbusRequests(exchanges);
+	const unsigned int measurements = 3 + exchanges.size() * interval
+		/ measurementMicros;
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, measurements * measurementMicros, 200000);
+	run(edges, measurements * measurementMicros + 1000);
+	receiveModbusAnswers(exchanges);
+
+	checkSteadyReports(measurements, 5);
+	for(size_t i = 0; i < exchanges.size(); ++i) {
+		const ModbusExchange &exchange = exchanges[i];
+		bool answered = i <= 2 || (i >= 6 && i <= 9);
+		check(exchange.answer.empty() != answered, "Request %zu: %s", i,
+			answered ? "No answer" : "Answered");
+		if(exchange.answer.empty())
+			continue;
+		unsigned long long silence = modbusSilenceMicros(SERIAL_BAUD);
+		check(exchange.answerDelay >= silence
+				&& exchange.answerDelay <= silence + 300,
+			"Request %zu: Answer after %llu microseconds", i,
+			exchange.answerDelay);
+	}
+	checkModbusException(exchanges[6], 6, 1);
+	checkModbusException(exchanges[7], 7, 2);
+	checkModbusException(exchanges[8], 8, 3);
+	checkModbusException(exchanges[9], 9, SERIAL_COMMANDS ? 2 : 1);
+
+	const std::string &input = exchanges[0].answer;
+	if(input.size() == 5 + 4 * modbusInputValues && !reports.empty()) {
+		check((byte)input[2] == 4 * modbusInputValues,
+			"Input registers: %u bytes", (byte)input[2]);
+		unsigned long sequence = modbusAnswerValue(input, 0);
+		check(sequence == 2 * reportsPerMeasurement,
+			"Sequence %lu instead of %u", sequence, 2 * reportsPerMeasurement);
+		const Report &report = reports[1];
+		unsigned long pulses = modbusAnswerValue(input, 1);
+		unsigned long rate = modbusAnswerValue(input, 2);
+		check(pulses == report.pulses && rate == report.milliPulsesPerSecond
+				&& modbusAnswerValue(input, 3) == windMillimetersPerSecond(rate)
+				&& modbusAnswerValue(input, 4) == report.measurementMillis,
+			"Input registers: %lu pulses, %lu milli pulses per second",
+			pulses, rate);
+		// The samples since the end of the measurement.
+		unsigned long current = modbusAnswerValue(input, 11);
+		check(current <= countsPerPulse, "%lu current pulses", current);
+		unsigned long seconds = modbusAnswerValue(input, 12);
+		check(seconds == start / 1000000, "Uptime %lu seconds", seconds);
+#if HEALTH_REPORT
+		check(modbusAnswerValue(input, 13) == _BV(WDRF)
+				&& modbusAnswerValue(input, 14) == sizeof(freeRam)
+				&& modbusAnswerValue(input, 15) == 0,
+			"Wrong health values");
+#endif
+		for(byte channel = 1; channel < channelCount; ++channel) {
+			check(modbusAnswerValue(input, 15 + 2 * channel) == 0,
+				"Pulses of channel %u", channel);
+		}
+	} else
+		check(false, "Input registers: %zu bytes", input.size());
+
+	const std::string &holding = exchanges[1].answer;
+	check(holding.size() == 5 + 4 * modbusHoldingValues
+			&& modbusAnswerValue(holding, 0) == Sensor::measurementDelaySeconds
+			&& modbusAnswerValue(holding, 1) == Sensor::debounceDelayMicros
+			&& modbusAnswerValue(holding, 2) == SERIAL_BAUD
+			&& modbusAnswerValue(holding, 3) == MODBUS_ADDRESS,
+		"Wrong holding registers");
+	check(exchanges[2].answer.size() == 7 && !reports.empty()
+			&& modbusWordAt(exchanges[2].answer, 3)
+				== (reports[1].pulses & 0xFFFF),
+		"Wrong single input register");
+
+	check((MODBUS_DE_PIN == 0 || !outputLevel(MODBUS_DE_PIN))
+			&& (UCSR0B & _BV(RXEN0)),
+		"Not receiving after the answers");
+}
+
+#if SERIAL_COMMANDS
+// Writes of the settings at the start, some of them invalid, and a
+// broadcast which changes the speed. The measurements must then be of
+// the new length, the master must be able to read the settings at the
+// new speed, and they must be the same after a restart.
+void testModbusSettings() {
+	const byte address = MODBUS_ADDRESS;
+	const unsigned int seconds = otherMeasurementSeconds;
+	if(seconds == 0)
+		return;
+	const unsigned long debounce = Sensor::debounceDelayMicros / 2;
+	const unsigned long baud = 38400;
+	std::vector<ModbusExchange> exchanges = {
+		{ 0, modbusWriteRequest(address, 0, { seconds, debounce * 2 }) },
+		{ 0, modbusRequest(address, 6, 3, debounce) },
+		// Only the high 16 bits.
+		{ 0, modbusRequest(address, 6, 2, 0) },
+		{ 0, modbusWriteRequest(address, 2, { 0 }) },
+		{ 0, modbusWriteRequest(address, 4, { 1234567 }) },
+		{ 0, modbusWriteRequest(address, 4, { 2, baud }) },
+		{ 0, modbusWriteRequest(0, 4, { baud }) },
+		{ 0, modbusRequest(address, 3, 0, 2 * modbusHoldingValues), baud },
+	};
+	// Enough for the longest request and its answer, and the silence
+	// before it.
+	const unsigned long long interval
+		= 32 * modbusByteMicros(SERIAL_BAUD) + 10000;
+	for(size_t i = 0; i < exchanges.size(); ++i) {
+		exchanges[i].micros = 10000 + i * interval;
+		if(exchanges[i].baud == 0)
+			exchanges[i].baud = SERIAL_BAUD;
+	}
+	sendModbusRequests(exchanges);
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 4 * seconds * 1000000ULL, 200000);
+	run(edges, 4 * seconds * 1000000ULL + 1000);
+	receiveModbusAnswers(exchanges);
+
+	check(reports.size() == 4, "%zu reports instead of 4", reports.size());
+	for(size_t i = 0; i < reports.size(); ++i) {
+		check(reports[i].measurementMillis == seconds * 1000UL
+				&& reports[i].pulses == 5 * seconds * countsPerPulse,
+			"Report %zu: %lu pulses in %lu milliseconds", i,
+			reports[i].pulses, reports[i].measurementMillis);
+	}
+
+	// The answer to writing is the request up to the count.
+	for(size_t i = 0; i < 2; ++i) {
+		check(exchanges[i].answer.size() == 8
+				&& exchanges[i].answer.compare(0, 6, exchanges[i].request, 0, 6)
+					== 0,
+			"Request %zu: Wrong answer", i);
+	}
+	checkModbusException(exchanges[2], 2, 2);
+	checkModbusException(exchanges[3], 3, 3);
+	checkModbusException(exchanges[4], 4, 3);
+	checkModbusException(exchanges[5], 5, 2);
+	check(exchanges[6].answer.empty(), "Broadcast answered");
+	const std::string &holding = exchanges[7].answer;
+	check(holding.size() == 5 + 4 * modbusHoldingValues
+			&& modbusAnswerValue(holding, 0) == seconds
+			&& modbusAnswerValue(holding, 1) == debounce
+			&& modbusAnswerValue(holding, 2) == baud,
+		"Wrong holding registers after writing");
+	check(UBRR0 == (F_CPU / 4 / baud - 1) / 2, "UBRR0 %u", UBRR0);
+
+	// What setup() does after a restart, with the same EEPROM.
+	applySettings(Sensor::measurementDelaySeconds,
+		Sensor::debounceDelayMicros);
+	serialBaud = SERIAL_BAUD;
+	setupSettings();
+	check(sensorMeasurementSeconds == seconds
+			&& sensorDebounceMicros == debounce && serialBaud == baud,
+		"After restart: %u seconds, %lu microseconds debounce, baud %lu",
+		sensorMeasurementSeconds, sensorDebounceMicros, serialBaud);
+}
+#endif
+#endif
+
+#if I2C_ADDRESS
+// The I2C master, which tells the sketch each state of the bus in
+// TWSR, as the hardware would, and checks that the interrupt lets the
+// bus continue.
+void i2cStep(byte status) {
+	TWSR = status;
+	TWCR = 0;
+	callInterrupt(TWI_vect);
+	check((TWCR & (_BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE)
+			| _BV(TWSTO))) == (_BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE)),
+		"TWCR 0x%02X after status 0x%02X", TWCR, status);
+}
+
+// Writes the position at which the next reads start, see I2cSnapshot.
+void i2cWritePosition(byte position) {
+	i2cStep(0x60);
+	TWDR = position;
+	i2cStep(0x80);
+	// Stop.
+	i2cStep(0xA0);
+}
+
+// Reads the given number of bytes, from the start of a read on if
+// start is true, or continues the read otherwise.
+std::string i2cReadBytes(size_t count, bool start) {
+	std::string data;
+	for(size_t i = 0; i < count; ++i) {
+		i2cStep(start && i == 0 ? 0xA8 : 0xB8);
+		data += (char)TWDR;
+	}
+	return data;
+}
+
+// Ends reading, by not acknowledging the last byte.
+void i2cStopReading() {
+	TWSR = 0xC0;
+	callInterrupt(TWI_vect);
+}
+
+std::string i2cRead(size_t count) {
+	std::string data = i2cReadBytes(count, true);
+	i2cStopReading();
+	return data;
+}
+
+// Returns the I2cSnapshot in the data, and checks its CRC.
+I2cSnapshot i2cSnapshotOf(const std::string &data) {
+	I2cSnapshot snapshot = {};
+	if(data.size() != sizeof(snapshot)) {
+		check(false, "%zu bytes read", data.size());
+		return snapshot;
+	}
+	memcpy(&snapshot, data.data(), sizeof(snapshot));
+	uint16_t crc = 0xFFFF;
+	for(size_t i = 0; i + 2 < data.size(); ++i)
+		crc = _crc16_update(crc, data[i]);
+	check(snapshot.crc == crc, "Sequence %u: Wrong CRC", snapshot.sequence);
+	return snapshot;
+}
+
+// A constant 5 Hz, after which the master reads the snapshot, parts of
+// it, and beyond its end. Then it starts reading, and two measurements
+// finish before it is done: It must still get all of the snapshot it
+// started with, and the newest one afterwards.
+void testI2c() {
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, 2 * measurementMicros, 200000);
+	run(edges, 2 * measurementMicros + 1000);
+	checkSteadyReports(2, 5);
+
+	i2cWritePosition(0);
+	std::string data = i2cRead(sizeof(I2cSnapshot));
+	I2cSnapshot snapshot = i2cSnapshotOf(data);
+	if(!reports.empty()) {
+		const Report &report = reports[1];
+		check(snapshot.sequence == 2 * reportsPerMeasurement
+				&& snapshot.pulseCount == report.pulses
+				&& snapshot.milliPulsesPerSecond == report.milliPulsesPerSecond
+				&& snapshot.measurementMillis == report.measurementMillis
+				&& snapshot.windMillimetersPerSecond
+					== windMillimetersPerSecond(report.milliPulsesPerSecond)
+				&& snapshot.meanMilliPulsesPerSecond == report.statistics.mean
+				&& snapshot.gustMilliPulsesPerSecond == report.statistics.gust,
+			"Sequence %u: %u pulses, %u milli pulses per second",
+			snapshot.sequence, snapshot.pulseCount,
+			snapshot.milliPulsesPerSecond);
+	}
+	check(snapshot.endUptimeSeconds == 2 * Sensor::measurementDelaySeconds,
+		"Uptime %u seconds", snapshot.endUptimeSeconds);
+	check(snapshot.numberOfChannels == channelCount
+			&& snapshot.channels[0].pulseCount == snapshot.pulseCount,
+		"%u channels", snapshot.numberOfChannels);
+	for(byte channel = 1; channel < channelCount; ++channel) {
+		check(snapshot.channels[channel].pulseCount == 0,
+			"Pulses of channel %u", channel);
+	}
+
+	// Reading again starts at the same position.
+	const byte position = offsetof(I2cSnapshot, pulseCount);
+	i2cWritePosition(position);
+	for(int i = 0; i < 2; ++i) {
+		check(i2cRead(4) == data.substr(position, 4),
+			"Read %d: Wrong pulses", i);
+	}
+	i2cWritePosition(sizeof(I2cSnapshot) - 2);
+	check(i2cRead(4) == data.substr(sizeof(I2cSnapshot) - 2) + "\xFF\xFF",
+		"Wrong bytes beyond the end");
+
+	i2cWritePosition(0);
+	std::string torn = i2cReadBytes(10, true);
+	for(unsigned long long time = simulatedMicros + loopIntervalMicros;
+			time <= 4 * measurementMicros + 1000; time += loopIntervalMicros) {
+		advanceTime(time);
+		loop();
+	}
+	check(reportSequence == 4 * reportsPerMeasurement,
+		"Sequence %u instead of %u", reportSequence, 4 * reportsPerMeasurement);
+	torn += i2cReadBytes(sizeof(I2cSnapshot) - 10, false);
+	i2cStopReading();
+	check(torn == data, "The snapshot changed while reading");
+
+	loop();
+	snapshot = i2cSnapshotOf(i2cRead(sizeof(I2cSnapshot)));
+	check(snapshot.sequence == 4 * reportsPerMeasurement
+			&& snapshot.pulseCount == reportPulseCounts[0],
+		"Sequence %u instead of %u", snapshot.sequence,
+		4 * reportsPerMeasurement);
+}
+#endif
+
+#if REPORT_INTERVAL_SECONDS
+// 5 Hz for two measurements, then 10 Hz for one. There must be a report
+// at the end of each interval, over the measurement before it, or since
+// the start while there was less. The rate of the last interval must be
+// the one of the pulses in it.
+void testSlidingWindow() {
+	const unsigned long long switchMicros = 2 * measurementMicros;
+	const unsigned long long endMicros = 3 * measurementMicros;
+	const unsigned long long intervalMicros
+		= REPORT_INTERVAL_SECONDS * 1000000ULL;
+	std::vector<Edge> edges;
+	addPulses(edges, 100000, switchMicros, 200000);
+	// Not on a boundary of the intervals either.
+	addPulses(edges, switchMicros + 50000, endMicros, 100000);
+	run(edges, endMicros + 1000);
+
+	size_t count = endMicros / intervalMicros;
+	check(intervalReports.size() == count, "%zu reports instead of %zu",
+		intervalReports.size(), count);
+	check(reports.size() == 3, "%zu whole measurements instead of 3",
+		reports.size());
+	unsigned long lastRate = 0;
+	for(size_t i = 0; i < intervalReports.size(); ++i) {
+		const Report &report = intervalReports[i];
+		unsigned long long end = (i + 1) * intervalMicros;
+		unsigned long long start
+			= end > measurementMicros ? end - measurementMicros : 0;
+		unsigned long pulses = 0;
+		for(const Edge &edge : edges)
+			pulses += edge.high == sensorActiveHigh && edge.micros > start
+				&& edge.micros <= end;
+		pulses *= countsPerPulse;
+		check(report.pulses == pulses
+				&& report.measurementMillis == (end - start) / 1000,
+			"Report %zu: %lu pulses in %lu milliseconds instead of %lu in "
+			"%llu", i, report.pulses, report.measurementMillis, pulses,
+			(end - start) / 1000);
+		
+		// Between 5 and 10 Hz while the window has both, and rising. The
+		// one which starts at the change is measured from the last pulse
+		// of 5 Hz, so it has both too.
+		unsigned long rate = report.milliPulsesPerSecond;
+		if(end <= switchMicros || start > switchMicros) {
+			unsigned long expected
+				= expectedMilliPulsesPerSecond(end <= switchMicros ? 5 : 10);
+			check(isClose(rate, expected, 1),
+				"Report %zu: %lu milli pulses per second instead of %lu",
+				i, rate, expected);
+		} else
+			check(rate >= lastRate
+					&& rate <= expectedMilliPulsesPerSecond(10),
+				"Report %zu: %lu milli pulses per second after %lu", i, rate,
+				lastRate);
+		lastRate = rate;
+		
+		// The first interval of 10 Hz is measured from the last pulse of
+		// 5 Hz, so it has neither rate.
+		if(end - intervalMicros <= switchMicros && end > switchMicros)
+			continue;
+		unsigned long current = expectedMilliPulsesPerSecond(
+			end <= switchMicros ? 5 : 10);
+		check(isClose(report.currentMilliPulsesPerSecond, current, 1),
+			"Report %zu: Current %lu milli pulses per second instead of %lu",
+			i, report.currentMilliPulsesPerSecond, current);
+	}
+}
+#endif
+
+struct Test {
+	const char *name;
+	void (*run)();
+};
+
+const Test tests[] = {
+	{ "steady", testSteady },
+	{ "bounce", testBounce },
+	{ "gust", testGust },
+#if MOVING_STATISTICS
+	{ "stddev", testStddev },
+#endif
+	{ "wrap", testWrap },
+	{ "stop", testStop },
+	{ "windspeed", testWindSpeed },
+#if EEPROM_LOG
+	{ "log", testLog },
+#endif
+#if SERIAL_COMMANDS && OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	{ "settings", testSettings },
+#endif
+#if PULSE_HISTOGRAM
+	{ "histogram", testHistogram },
+#endif
+#if PULSE_TRACE
+	{ "trace", testTrace },
+#endif
+#if TIME_SYNC
+	{ "timesync", testTimeSync },
+#endif
+#if WATCHDOG
+	{ "watchdog", testWatchdog },
+#endif
+#if HEALTH_REPORT && OUTPUT_FORMAT != OUTPUT_FORMAT_MODBUS
+	{ "health", testHealth },
+#endif
+#if GUST_ALERT
+	{ "gustalert", testGustAlert },
+#endif
+#if INSTRUMENTATION
+	{ "instrumentation", testInstrumentation },
+#endif
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_MODBUS
+	{ "modbus", testModbus },
+#if SERIAL_COMMANDS
+	{ "modbussettings", testModbusSettings },
+#endif
+#endif
+#if I2C_ADDRESS
+	{ "i2c", testI2c },
+#endif
+#if REPORT_INTERVAL_SECONDS
+	{ "slidingwindow", testSlidingWindow },
+#endif
+};
+
+// Runs each test in its own process, see the top of this file, and
+// returns the number of tests which failed.
+int runTests(bool verbose) {
+	int failed = 0;
+
+	for(const Test &test : tests) {
+		printf("%s:\n", test.name);
+		fflush(stdout);
+
+		pid_t child = fork();
+		if(child == 0) {
+			Serial.printSerialOutput = verbose;
+			test.run();
+			check(missingInterrupts == 0, "%lu interrupts without ISR()",
+				missingInterrupts);
+			fflush(stdout);
+			_exit(testPassed ? 0 : 1);
+		}
+
+		int status = 1;
+		waitpid(child, &status, 0);
+		bool passed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		printf("    %s\n", passed ? "passed" : "FAILED");
+		if(!passed)
+			++failed;
+	}
+
+	printf("%d of %zu tests failed\n", failed, sizeof(tests) / sizeof(tests[0]));
+	return failed;
+}
+
+// Feeds the pulse train in the given file to the Sensor pin and prints
+// what the sketch sends via Serial.
+// Each line of the file is an edge: The time in microseconds since the
+// start and the level of the pin after it, 0 or 1, separated by a space.
+// The times must not decrease. Lines starting with # are ignored.
+// The simulation runs until one measurement after the last edge.
+int replay(const char *fileName) {
+	FILE *file = fopen(fileName, "r");
+	if(!file) {
+		perror(fileName);
+		return 1;
+	}
+
+	std::vector<Edge> edges;
+	char line[128];
+	unsigned long lineNumber = 0;
+	while(fgets(line, sizeof(line), file)) {
+		++lineNumber;
+		if(line[0] == '#' || line[0] == '\n')
+			continue;
+
+		unsigned long long time;
+		unsigned int level;
+		if(sscanf(line, "%llu %u", &time, &level) != 2 || level > 1
+				|| (!edges.empty() && time < edges.back().micros)) {
+			fprintf(stderr, "%s:%lu: Invalid edge\n", fileName, lineNumber);
+			fclose(file);
+			return 1;
+		}
+		edges.push_back({ time, Sensor::pin, level == 1 });
+	}
+	fclose(file);
+
+	Serial.printSerialOutput = true;
+	run(edges, (edges.empty() ? 0 : edges.back().micros) + measurementMicros);
+	return 0;
+}
+
+// Feeds the edges of a trace to the Sensor pin and prints what the
+// sketch sends via Serial. The file must contain what a sketch with
+// PULSE_TRACE sent via Serial, e.g. as recorded by
+//     cat /dev/ttyACM0 > trace.bin
+// on Linux. The frames which are not of the trace, e.g. the reports,
+// are skipped. The sketch of the harness can have another configuration
+// than the recorded one, e.g. to find out whether another debounce
+// strategy would have helped.
+// The first edge is replayed 1 second after the start, and the
+// simulation runs until one measurement after the last edge.
+int replayTrace(const char *fileName) {
+	FILE *file = fopen(fileName, "rb");
+	if(!file) {
+		perror(fileName);
+		return 1;
+	}
+	std::string data;
+	char buffer[4096];
+	size_t length;
+	while((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.append(buffer, length);
+	fclose(file);
+
+	std::vector<TraceEdge> trace;
+	unsigned long edgesLost = 0;
+	if(!decodeTrace(data, trace, edgesLost)) {
+		fprintf(stderr, "%s: Invalid trace frame\n", fileName);
+		return 1;
+	}
+	if(trace.empty()) {
+		fprintf(stderr, "%s: No edges found\n", fileName);
+		return 1;
+	}
+	if(edgesLost > 0)
+		fprintf(stderr, "%s: WARNING: %lu edges were lost\n", fileName,
+			edgesLost);
+
+	unsigned long long offset = trace.front().micros - 1000000;
+	for(TraceEdge &edge : trace)
+		edge.micros -= offset;
+
+	Serial.printSerialOutput = true;
+	run(traceToPinEdges(trace), trace.back().micros + measurementMicros);
+	return 0;
+}
+
+// Measures the time in nanoseconds per call of the given function,
+// which is called count times with its number as parameter.
+template<typename Function>
+double nanosecondsPerCall(unsigned long count, Function function) {
+	std::chrono::steady_clock::time_point start
+		= std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < count; ++i)
+		function(i);
+	std::chrono::duration<double, std::nano> duration
+		= std::chrono::steady_clock::now() - start;
+	return duration.count() / count;
+}
+
+// Prints how long the sketch needs on the PC for processing a pulse,
+// in the interrupts and in loop(), and for a bounce which the debounce
+// code throws away. The times of the interrupts include setPin().
+int benchmark() {
+	const unsigned long count = 1000000;
+	// Time between the pulses, so that every pulse is accepted.
+	const unsigned long periodMicros = 2 * Sensor::debounceDelayMicros
+		+ pulseMicros;
+
+	advanceTime(0);
+	setup();
+
+	// Pulses which fit into the pulseTimestamps buffer.
+	const unsigned long batch = PULSE_TIMESTAMP_BUFFER_SIZE > 0
+		&& PULSE_TIMESTAMP_BUFFER_SIZE < 16 ? PULSE_TIMESTAMP_BUFFER_SIZE : 16;
+
+	double pulse = nanosecondsPerCall(count, [&](unsigned long i) {
+		advanceTime(simulatedMicros + periodMicros);
+		setPin(Sensor::pin, sensorActiveHigh);
+		advanceTime(simulatedMicros + pulseMicros);
+		setPin(Sensor::pin, !sensorActiveHigh);
+		// Keep the buffer from overflowing, which would make the
+		// interrupt take another way.
+		if(i % batch == batch - 1)
+			processPulseTimestamps();
+	});
+
+	// processPulseTimestamps() alone, each time with a full batch of
+	// pulses in the buffer.
+	std::chrono::duration<double, std::nano> processingDuration(0);
+	for(unsigned long i = 0; i < count / batch; ++i) {
+		for(byte pulse = 0; pulse < batch; ++pulse) {
+			advanceTime(simulatedMicros + periodMicros);
+			setPin(Sensor::pin, sensorActiveHigh);
+			advanceTime(simulatedMicros + pulseMicros);
+			setPin(Sensor::pin, !sensorActiveHigh);
+		}
+		std::chrono::steady_clock::time_point start
+			= std::chrono::steady_clock::now();
+		processPulseTimestamps();
+		processingDuration += std::chrono::steady_clock::now() - start;
+	}
+	double processing = processingDuration.count() / (count / batch * batch);
+
+	double bounce = nanosecondsPerCall(count, [&](unsigned long i) {
+		advanceTime(simulatedMicros + bounceMicros);
+		setPin(Sensor::pin, i % 2 ? sensorActiveHigh : !sensorActiveHigh);
+	});
+	double loopPass = nanosecondsPerCall(count, [&](unsigned long) {
+		advanceTime(simulatedMicros + loopIntervalMicros);
+		loop();
+	});
+
+	printf("Nanoseconds on this PC per\n");
+	printf("- %-36s %8.1f\n", "pulse in the interrupts:", pulse);
+	printf("- %-36s %8.1f\n", "pulse in processPulseTimestamps():",
+		processing);
+	printf("- %-36s %8.1f\n", "edge of a bounce:", bounce);
+	printf("- %-36s %8.1f\n", "pass of loop():", loopPass);
+	return 0;
+}
+
+// Prints the terms of ramBuffersBytes of the sketch, i.e. the RAM of the
+// buffers of each feature in bytes, and how much the sketch allows.
+// These are the sizes on this PC, not on the Arduino: int, unsigned
+// long and pointers are larger here, so most terms are too, e.g. the
+// moving statistics by twice. Only the output queue and the other
+// buffers of bytes have nearly the same size. Compiling for the Arduino
+// checks the real sizes.
+int budget() {
+	struct Term {
+		const char *name;
+		unsigned int bytes;
+	};
+	const Term terms[] = {
+		{ "Output queue", ramOutputQueueBytes },
+		{ "Channels", ramChannelsBytes },
+		{ "Timestamps of pulses", ramTimestampsBytes },
+		{ "PULSE_HISTOGRAM", ramHistogramBytes },
+		{ "PULSE_TRACE", ramTraceBytes },
+		{ "MOVING_STATISTICS", ramStatisticsBytes },
+		{ "GUST_ALERT", ramGustAlertBytes },
+		{ "REPORT_INTERVAL_SECONDS", ramReportWindowBytes },
+		{ "TIME_SYNC", ramTimeSyncBytes },
+		{ "EEPROM_LOG", ramLogBytes },
+		{ "Command lines", ramCommandsBytes },
+		{ "INSTRUMENTATION", ramInstrumentationBytes },
+		{ "OUTPUT_FORMAT_MODBUS", ramModbusBytes },
+		{ "I2C_ADDRESS", ramI2cBytes },
+	};
+
+	printf("RAM of the buffers in bytes, with the sizes of this PC, which "
+		"are larger than\non the Arduino:\n");
+	for(const Term &term : terms)
+		printf("  %-24s %5u\n", term.name, term.bytes);
+	printf("  %-24s %5u\n", "All buffers", ramBuffersBytes);
+	printf("On the Arduino Uno the sketch only compiles if they need at most "
+		"%u bytes\nthere, which leaves %u for the rest and %u for the "
+		"stack.\n", 2048 - ramOtherBytes - ramStackReserveBytes,
+		ramOtherBytes, ramStackReserveBytes);
+	return 0;
+}
+
+int main(int argumentCount, char **arguments) {
+	memset(eeprom, 0xFF, sizeof(eeprom));
+
+	if(argumentCount == 3 && strcmp(arguments[1], "replay") == 0)
+		return replay(arguments[2]);
+	if(argumentCount == 3 && strcmp(arguments[1], "replay-trace") == 0)
+		return replayTrace(arguments[2]);
+	if(argumentCount == 2 && strcmp(arguments[1], "benchmark") == 0)
+		return benchmark();
+	if(argumentCount == 2 && strcmp(arguments[1], "budget") == 0)
+		return budget();
+	if(argumentCount == 1
+			|| (argumentCount == 2 && strcmp(arguments[1], "-v") == 0))
+		return runTests(argumentCount == 2) > 0 ? 1 : 0;
+
+	fprintf(stderr,
+		"Usage: %s [-v | replay FILE | replay-trace FILE | benchmark "
+		"| budget]\n", arguments[0]);
+	return 2;
+}